@@ -0,0 +1,28 @@
+#include "gl_util.hpp"
+
+#include <unordered_map>
+
+
+
+bool has_gl_extension(const std::string& name)
+{
+    static std::unordered_map<std::string, bool> cache;
+
+    auto it = cache.find(name);
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    bool found = false;
+
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+
+    for (GLint i = 0; i < extension_count && !found; i++) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        found = extension != nullptr && name == extension;
+    }
+
+    cache[name] = found;
+    return found;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "program.hpp"
+
+#include <string>
+
+
+
+// checks extension string list of current context (result is cached per extension name)
+bool has_gl_extension(const std::string& name);
@@ -0,0 +1,125 @@
+#include "gpu_resources.hpp"
+
+#include "imgui.h"
+
+#include <algorithm>
+
+
+
+//  ===============================================  GpuResourceRegistry  ===============================================
+
+GpuResourceRegistry& GpuResourceRegistry::get()
+{
+    static GpuResourceRegistry registry;
+    return registry;
+}
+
+const char* GpuResourceRegistry::get_type_name(GpuResourceType type)
+{
+    return type == GpuResourceType::BUFFER ? "buffer" : "texture";
+}
+
+void GpuResourceRegistry::add_buffer(GLuint buffer, const std::string& label)
+{
+    GLint64 size = 0;
+    glGetNamedBufferParameteri64v(buffer, GL_BUFFER_SIZE, &size);
+
+    glObjectLabel(GL_BUFFER, buffer, -1, label.c_str());
+    resources[{ GpuResourceType::BUFFER, buffer }] = { GpuResourceType::BUFFER, buffer, label, static_cast<size_t>(size) };
+}
+
+void GpuResourceRegistry::add_texture(GLuint texture, const std::string& label)
+{
+    glObjectLabel(GL_TEXTURE, texture, -1, label.c_str());
+    resources[{ GpuResourceType::TEXTURE, texture }] = { GpuResourceType::TEXTURE, texture, label, query_texture_size(texture) };
+}
+
+void GpuResourceRegistry::remove_buffer(GLuint buffer)
+{
+    resources.erase({ GpuResourceType::BUFFER, buffer });
+}
+
+void GpuResourceRegistry::remove_texture(GLuint texture)
+{
+    resources.erase({ GpuResourceType::TEXTURE, texture });
+}
+
+size_t GpuResourceRegistry::get_total_size(GpuResourceType type) const
+{
+    size_t size = 0;
+    for (const auto& [key, resource] : resources) {
+        if (resource.type == type) {
+            size += resource.size;
+        }
+    }
+    return size;
+}
+
+std::vector<GpuResourceGroup> GpuResourceRegistry::get_groups() const
+{
+    std::map<std::pair<GpuResourceType, std::string>, GpuResourceGroup> groups;
+    for (const auto& [key, resource] : resources) {
+        GpuResourceGroup& group = groups.try_emplace({ resource.type, resource.label }, GpuResourceGroup{ resource.type, resource.label, 0, 0 }).first->second;
+        group.count++;
+        group.size += resource.size;
+    }
+
+    std::vector<GpuResourceGroup> result;
+    for (const auto& [key, group] : groups) {
+        result.push_back(group);
+    }
+    std::sort(result.begin(), result.end(), [](const GpuResourceGroup& a, const GpuResourceGroup& b) { return a.size > b.size; });
+
+    return result;
+}
+
+void GpuResourceRegistry::render_ui() const
+{
+    const double mib = 1.0 / (1024.0 * 1024.0);
+
+    ImGui::Text("buffers: %.2f MiB", get_total_size(GpuResourceType::BUFFER) * mib);
+    ImGui::Text("textures: %.2f MiB", get_total_size(GpuResourceType::TEXTURE) * mib);
+
+    for (const GpuResourceGroup& group : get_groups()) {
+        ImGui::Text("  %s %s (%zu): %.2f MiB", get_type_name(group.type), group.label.c_str(), group.count, group.size * mib);
+    }
+}
+
+size_t GpuResourceRegistry::query_texture_size(GLuint texture)
+{
+    // sizes as reported by driver, internal padding / alignment isn't included
+    size_t size = 0;
+    for (GLint level = 0; level < 16; level++) {
+        GLint width = 0;
+        GLint height = 0;
+        GLint depth = 0;
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &width);
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &height);
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_DEPTH, &depth);
+        if (width == 0) {
+            break;
+        }
+
+        GLint compressed = GL_FALSE;
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed) {
+            GLint compressed_size = 0;
+            glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressed_size);
+            size += compressed_size;
+            continue;
+        }
+
+        GLint bits = 0;
+        for (GLenum pname : { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE }) {
+            GLint component_bits = 0;
+            glGetTextureLevelParameteriv(texture, level, pname, &component_bits);
+            bits += component_bits;
+        }
+
+        GLint samples = 0;
+        glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_SAMPLES, &samples);
+
+        size += static_cast<size_t>(width) * std::max(height, 1) * std::max(depth, 1) * std::max(samples, 1) * bits / 8;
+    }
+    return size;
+}
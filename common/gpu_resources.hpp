@@ -0,0 +1,73 @@
+#pragma once
+
+#include "program.hpp"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+enum class GpuResourceType : int {
+    BUFFER = 0,
+    TEXTURE = 1,
+};
+
+
+struct GpuResource
+{
+    GpuResourceType type;
+    GLuint name;
+    std::string label;
+    size_t size; // bytes
+};
+
+
+// resources with the same label (e.g. buffers of all fireworks)
+struct GpuResourceGroup
+{
+    GpuResourceType type;
+    std::string label;
+    size_t count;
+    size_t size; // bytes
+};
+
+
+// registry of gl buffers and textures created by the projects (framework geometry is not tracked)
+// resources are added after their storage is allocated (size is queried from gl) and removed before deletion
+// added objects are also labeled through KHR_debug, so debuggers show the same names
+class GpuResourceRegistry
+{
+public:
+    static GpuResourceRegistry& get();
+
+    static const char* get_type_name(GpuResourceType type);
+
+    void add_buffer(GLuint buffer, const std::string& label);
+    void add_texture(GLuint texture, const std::string& label);
+
+    void remove_buffer(GLuint buffer);
+    void remove_texture(GLuint texture);
+
+    size_t get_total_size(GpuResourceType type) const;
+
+    // largest first
+    std::vector<GpuResourceGroup> get_groups() const;
+
+    // totals + table of groups, call inside ImGui window
+    void render_ui() const;
+
+private:
+    std::map<std::pair<GpuResourceType, GLuint>, GpuResource> resources;
+
+    GpuResourceRegistry() = default;
+
+    static size_t query_texture_size(GLuint texture);
+};
+
+
+inline GpuResourceRegistry& gpu_resources()
+{
+    return GpuResourceRegistry::get();
+}
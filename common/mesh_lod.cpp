@@ -0,0 +1,579 @@
+#include "mesh_lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+
+
+namespace {
+    struct Vec3
+    {
+        double x, y, z;
+    };
+
+    inline Vec3 operator+(const Vec3& a, const Vec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+    inline Vec3 operator-(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    inline Vec3 operator*(const Vec3& a, double s) { return { a.x * s, a.y * s, a.z * s }; }
+    inline double dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Vec3 cross(const Vec3& a, const Vec3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+    inline double length(const Vec3& a) { return std::sqrt(dot(a, a)); }
+
+
+    // symmetric 4x4 matrix of plane equations (sum of squared distances to planes)
+    struct Quadric
+    {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        // plane n.p + d = 0, n normalized
+        void add_plane(const Vec3& n, double d, double weight)
+        {
+            a2 += weight * n.x * n.x;
+            ab += weight * n.x * n.y;
+            ac += weight * n.x * n.z;
+            ad += weight * n.x * d;
+            b2 += weight * n.y * n.y;
+            bc += weight * n.y * n.z;
+            bd += weight * n.y * d;
+            c2 += weight * n.z * n.z;
+            cd += weight * n.z * d;
+            d2 += weight * d * d;
+        }
+
+        void add(const Quadric& q)
+        {
+            a2 += q.a2, ab += q.ab, ac += q.ac, ad += q.ad, b2 += q.b2;
+            bc += q.bc, bd += q.bd, c2 += q.c2, cd += q.cd, d2 += q.d2;
+        }
+
+        double evaluate(const Vec3& p) const
+        {
+            return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+                   + c2 * p.z * p.z + 2 * cd * p.z + d2;
+        }
+    };
+
+    const double BORDER_WEIGHT = 10.0;
+    const double MIN_NORMAL_DOT = 0.2; // normals of moved triangles (cos), below = flip
+
+
+    struct Candidate
+    {
+        double cost;
+        uint32_t a;
+        uint32_t b;
+        uint32_t version_a;
+        uint32_t version_b;
+        Vec3 target;
+
+        bool operator>(const Candidate& other) const { return cost > other.cost; }
+    };
+
+
+    class Simplifier
+    {
+    public:
+        explicit Simplifier(const ObjMesh& mesh) : mesh(mesh)
+        {
+            weld();
+            build_quadrics();
+        }
+
+        std::vector<MeshLod> run(const std::vector<float>& ratios)
+        {
+            std::vector<MeshLod> lods;
+
+            for (uint32_t a = 0; a < positions.size(); a++) {
+                for (uint32_t b : get_neighbors(a)) {
+                    if (a < b) {
+                        push_candidate(a, b);
+                    }
+                }
+            }
+
+            double max_error = 0.0;
+            for (float ratio : ratios) {
+                size_t target = static_cast<size_t>(static_cast<double>(triangles.size()) * std::clamp(ratio, 0.0f, 1.0f));
+
+                while (alive_count > target && !heap.empty()) {
+                    Candidate candidate = heap.top();
+                    heap.pop();
+
+                    if (removed_positions[candidate.a] || removed_positions[candidate.b] || versions[candidate.a] != candidate.version_a
+                        || versions[candidate.b] != candidate.version_b) {
+                        continue; // stale
+                    }
+                    if (!can_collapse(candidate)) {
+                        continue;
+                    }
+
+                    collapse(candidate);
+                    max_error = std::max(max_error, std::sqrt(std::max(candidate.cost, 0.0)));
+                }
+
+                lods.push_back({ snapshot(), static_cast<float>(max_error), {}, {} });
+            }
+            return lods;
+        }
+
+    private:
+        const ObjMesh& mesh;
+
+        // welded positions
+        std::vector<Vec3> positions;
+        std::vector<Quadric> quadrics;
+        std::vector<uint32_t> versions;
+        std::vector<uint8_t> removed_positions;
+        std::vector<std::vector<uint32_t>> position_triangles;
+        std::vector<std::vector<uint32_t>> position_vertices; // original vertices (attribute seams) at the position
+
+        // triangles of welded positions, corners = original vertex of each triangle corner (attributes)
+        struct Triangle
+        {
+            uint32_t p[3];
+        };
+        std::vector<Triangle> triangles;
+        std::vector<uint32_t> corners;
+        std::vector<uint8_t> removed_triangles;
+        size_t alive_count = 0;
+
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+
+        void weld()
+        {
+            struct Key
+            {
+                float x, y, z;
+                bool operator==(const Key& other) const { return x == other.x && y == other.y && z == other.z; }
+            };
+            struct KeyHash
+            {
+                size_t operator()(const Key& key) const
+                {
+                    uint32_t bits[3];
+                    std::memcpy(bits, &key, sizeof(bits));
+                    uint64_t h = bits[0];
+                    h = h * 0x9E3779B97F4A7C15ull + bits[1];
+                    h = h * 0x9E3779B97F4A7C15ull + bits[2];
+                    return static_cast<size_t>(h ^ (h >> 29));
+                }
+            };
+
+            size_t vertex_count = mesh.positions.size() / 3;
+            std::unordered_map<Key, uint32_t, KeyHash> ids;
+            ids.reserve(vertex_count);
+
+            std::vector<uint32_t> vertex_positions(vertex_count);
+            for (size_t v = 0; v < vertex_count; v++) {
+                const float* p = &mesh.positions[3 * v];
+                auto it = ids.emplace(Key{ p[0], p[1], p[2] }, static_cast<uint32_t>(positions.size()));
+                if (it.second) {
+                    positions.push_back({ p[0], p[1], p[2] });
+                }
+                vertex_positions[v] = it.first->second;
+            }
+
+            quadrics.assign(positions.size(), Quadric());
+            versions.assign(positions.size(), 0);
+            removed_positions.assign(positions.size(), 0);
+            position_triangles.assign(positions.size(), {});
+            position_vertices.assign(positions.size(), {});
+            for (size_t v = 0; v < vertex_count; v++) {
+                position_vertices[vertex_positions[v]].push_back(static_cast<uint32_t>(v));
+            }
+            corners = mesh.indices;
+
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+                Triangle triangle;
+                for (int c = 0; c < 3; c++) {
+                    triangle.p[c] = vertex_positions[mesh.indices[i + c]];
+                }
+                bool degenerate = triangle.p[0] == triangle.p[1] || triangle.p[1] == triangle.p[2] || triangle.p[0] == triangle.p[2];
+                triangles.push_back(triangle);
+                removed_triangles.push_back(degenerate ? 1 : 0);
+                if (!degenerate) {
+                    alive_count++;
+                    for (uint32_t p : triangle.p) {
+                        position_triangles[p].push_back(static_cast<uint32_t>(triangles.size() - 1));
+                    }
+                }
+            }
+        }
+
+        void build_quadrics()
+        {
+            // edge -> number of triangles (1 = open border)
+            std::unordered_map<uint64_t, uint32_t> edge_counts;
+            auto edge_key = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b); };
+
+            for (size_t t = 0; t < triangles.size(); t++) {
+                if (removed_triangles[t]) {
+                    continue;
+                }
+                const Triangle& triangle = triangles[t];
+                Vec3 normal = get_normal(triangle.p[0], triangle.p[1], triangle.p[2]);
+                if (length(normal) == 0.0) {
+                    continue;
+                }
+                normal = normal * (1.0 / length(normal));
+                double d = -dot(normal, positions[triangle.p[0]]);
+                for (uint32_t p : triangle.p) {
+                    quadrics[p].add_plane(normal, d, 1.0);
+                }
+                for (int c = 0; c < 3; c++) {
+                    edge_counts[edge_key(triangle.p[c], triangle.p[(c + 1) % 3])]++;
+                }
+            }
+
+            for (size_t t = 0; t < triangles.size(); t++) {
+                if (removed_triangles[t]) {
+                    continue;
+                }
+                const Triangle& triangle = triangles[t];
+                Vec3 normal = get_normal(triangle.p[0], triangle.p[1], triangle.p[2]);
+                for (int c = 0; c < 3; c++) {
+                    uint32_t a = triangle.p[c];
+                    uint32_t b = triangle.p[(c + 1) % 3];
+                    if (edge_counts[edge_key(a, b)] != 1) {
+                        continue;
+                    }
+
+                    // plane through the border edge, perpendicular to the triangle
+                    Vec3 border_normal = cross(positions[b] - positions[a], normal);
+                    double border_length = length(border_normal);
+                    if (border_length == 0.0) {
+                        continue;
+                    }
+                    border_normal = border_normal * (1.0 / border_length);
+                    double d = -dot(border_normal, positions[a]);
+                    quadrics[a].add_plane(border_normal, d, BORDER_WEIGHT);
+                    quadrics[b].add_plane(border_normal, d, BORDER_WEIGHT);
+                }
+            }
+        }
+
+        Vec3 get_normal(uint32_t a, uint32_t b, uint32_t c) const
+        {
+            return cross(positions[b] - positions[a], positions[c] - positions[a]);
+        }
+
+        std::vector<uint32_t> get_neighbors(uint32_t p) const
+        {
+            std::vector<uint32_t> neighbors;
+            for (uint32_t t : position_triangles[p]) {
+                if (removed_triangles[t]) {
+                    continue;
+                }
+                for (uint32_t q : triangles[t].p) {
+                    if (q != p) {
+                        neighbors.push_back(q);
+                    }
+                }
+            }
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+            return neighbors;
+        }
+
+        // target = best of both ends and midpoint (no matrix inversion, stays on the original surface for flat regions)
+        void push_candidate(uint32_t a, uint32_t b)
+        {
+            Quadric quadric = quadrics[a];
+            quadric.add(quadrics[b]);
+
+            Vec3 options[3] = { positions[a], positions[b], (positions[a] + positions[b]) * 0.5 };
+            Candidate candidate{ quadric.evaluate(options[0]), a, b, versions[a], versions[b], options[0] };
+            for (int i = 1; i < 3; i++) {
+                double cost = quadric.evaluate(options[i]);
+                if (cost < candidate.cost) {
+                    candidate.cost = cost;
+                    candidate.target = options[i];
+                }
+            }
+            heap.push(candidate);
+        }
+
+        bool can_collapse(const Candidate& candidate) const
+        {
+            // link condition, more common neighbors than the two opposite corners would pinch the surface
+            std::vector<uint32_t> neighbors_a = get_neighbors(candidate.a);
+            std::vector<uint32_t> neighbors_b = get_neighbors(candidate.b);
+            std::vector<uint32_t> common;
+            std::set_intersection(neighbors_a.begin(), neighbors_a.end(), neighbors_b.begin(), neighbors_b.end(), std::back_inserter(common));
+            if (common.size() > 2) {
+                return false;
+            }
+
+            // moved triangles must not flip
+            for (uint32_t p : { candidate.a, candidate.b }) {
+                for (uint32_t t : position_triangles[p]) {
+                    if (removed_triangles[t]) {
+                        continue;
+                    }
+                    const Triangle& triangle = triangles[t];
+                    bool has_a = triangle.p[0] == candidate.a || triangle.p[1] == candidate.a || triangle.p[2] == candidate.a;
+                    bool has_b = triangle.p[0] == candidate.b || triangle.p[1] == candidate.b || triangle.p[2] == candidate.b;
+                    if (has_a && has_b) {
+                        continue; // removed by collapse
+                    }
+
+                    Vec3 corners[3];
+                    for (int c = 0; c < 3; c++) {
+                        corners[c] = triangle.p[c] == p ? candidate.target : positions[triangle.p[c]];
+                    }
+                    Vec3 before = get_normal(triangle.p[0], triangle.p[1], triangle.p[2]);
+                    Vec3 after = cross(corners[1] - corners[0], corners[2] - corners[0]);
+                    double before_length = length(before);
+                    double after_length = length(after);
+                    if (after_length == 0.0 || (before_length > 0.0 && dot(before, after) < MIN_NORMAL_DOT * before_length * after_length)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // b is merged into a
+        void collapse(const Candidate& candidate)
+        {
+            uint32_t a = candidate.a;
+            uint32_t b = candidate.b;
+
+            positions[a] = candidate.target;
+            quadrics[a].add(quadrics[b]);
+            versions[a]++;
+            removed_positions[b] = 1;
+
+            for (uint32_t t : position_triangles[b]) {
+                if (removed_triangles[t]) {
+                    continue;
+                }
+                Triangle& triangle = triangles[t];
+                bool has_a = triangle.p[0] == a || triangle.p[1] == a || triangle.p[2] == a;
+                if (has_a) {
+                    removed_triangles[t] = 1;
+                    alive_count--;
+                    continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                    if (triangle.p[c] == b) {
+                        triangle.p[c] = a;
+                        corners[3 * t + c] = get_closest_vertex(a, corners[3 * t + c]);
+                    }
+                }
+                position_triangles[a].push_back(t);
+            }
+            position_triangles[b].clear();
+
+            // compaction of removed triangles
+            std::vector<uint32_t>& list = position_triangles[a];
+            list.erase(std::remove_if(list.begin(), list.end(), [this](uint32_t t) { return removed_triangles[t] != 0; }), list.end());
+
+            for (uint32_t n : get_neighbors(a)) {
+                push_candidate(std::min(a, n), std::max(a, n));
+            }
+        }
+
+        // vertex of position p with attributes closest to the vertex, keeps uv / normal seams on the same side
+        uint32_t get_closest_vertex(uint32_t p, uint32_t vertex) const
+        {
+            uint32_t closest = position_vertices[p][0];
+            float closest_distance = std::numeric_limits<float>::max();
+            for (uint32_t candidate : position_vertices[p]) {
+                float distance = get_attribute_distance(candidate, vertex);
+                if (distance < closest_distance) {
+                    closest_distance = distance;
+                    closest = candidate;
+                }
+            }
+            return closest;
+        }
+
+        float get_attribute_distance(uint32_t a, uint32_t b) const
+        {
+            float distance = 0.0f;
+            if (3 * std::max(a, b) + 2 < mesh.normals.size()) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    float d = mesh.normals[3 * a + c] - mesh.normals[3 * b + c];
+                    distance += d * d;
+                }
+            }
+            if (2 * std::max(a, b) + 1 < mesh.tex_coords.size()) {
+                for (uint32_t c = 0; c < 2; c++) {
+                    float d = mesh.tex_coords[2 * a + c] - mesh.tex_coords[2 * b + c];
+                    distance += d * d;
+                }
+            }
+            return distance;
+        }
+
+        // alive triangles, vertices = used original vertices at their moved positions
+        ObjMesh snapshot() const
+        {
+            ObjMesh result;
+            std::unordered_map<uint32_t, uint32_t> vertices;
+
+            for (size_t t = 0; t < triangles.size(); t++) {
+                if (removed_triangles[t]) {
+                    continue;
+                }
+                for (int c = 0; c < 3; c++) {
+                    uint32_t p = triangles[t].p[c];
+                    uint32_t original = corners[3 * t + c];
+
+                    auto it = vertices.emplace(original, static_cast<uint32_t>(result.positions.size() / 3));
+                    if (it.second) {
+                        result.positions.insert(result.positions.end(), { static_cast<float>(positions[p].x), static_cast<float>(positions[p].y),
+                                                                          static_cast<float>(positions[p].z) });
+                        if (3 * original + 2 < mesh.normals.size()) {
+                            result.normals.insert(result.normals.end(), &mesh.normals[3 * original], &mesh.normals[3 * original] + 3);
+                        }
+                        if (2 * original + 1 < mesh.tex_coords.size()) {
+                            result.tex_coords.insert(result.tex_coords.end(), &mesh.tex_coords[2 * original], &mesh.tex_coords[2 * original] + 2);
+                        }
+                    }
+                    result.indices.push_back(it.first->second);
+                }
+            }
+            return result;
+        }
+    };
+
+
+    //  ===============================================  cache  ===============================================
+
+    const uint32_t CACHE_MAGIC = 0x32444F4C; // "LOD2"
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t lod_count;
+        uint64_t source_size;
+        int64_t source_time;
+    };
+
+    void write_vector(std::ofstream& file, const void* data, size_t count, size_t element_size)
+    {
+        uint64_t size = count;
+        file.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * element_size));
+    }
+
+    template <typename T> bool read_vector(std::ifstream& file, std::vector<T>& vector)
+    {
+        uint64_t size = 0;
+        if (!file.read(reinterpret_cast<char*>(&size), sizeof(uint64_t)) || size > (1ull << 32)) {
+            return false;
+        }
+        vector.resize(size);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(vector.data()), static_cast<std::streamsize>(size * sizeof(T))));
+    }
+
+    bool read_cache(const std::filesystem::path& cache, const CacheHeader& expected, const std::vector<float>& ratios, std::vector<MeshLod>& lods)
+    {
+        std::ifstream file(cache, std::ios::binary);
+        CacheHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(CacheHeader))) {
+            return false;
+        }
+        if (header.magic != expected.magic || header.lod_count != expected.lod_count || header.source_size != expected.source_size
+            || header.source_time != expected.source_time) {
+            return false;
+        }
+
+        std::vector<float> cached_ratios;
+        if (!read_vector(file, cached_ratios) || cached_ratios != ratios) {
+            return false;
+        }
+
+        lods.resize(header.lod_count);
+        for (MeshLod& lod : lods) {
+            if (!file.read(reinterpret_cast<char*>(&lod.error), sizeof(float))
+                || !file.read(reinterpret_cast<char*>(&lod.cache_before), sizeof(VertexCacheStatistics))
+                || !file.read(reinterpret_cast<char*>(&lod.cache_after), sizeof(VertexCacheStatistics)) || !read_vector(file, lod.mesh.positions)
+                || !read_vector(file, lod.mesh.normals) || !read_vector(file, lod.mesh.tex_coords) || !read_vector(file, lod.mesh.indices)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void write_cache(const std::filesystem::path& cache, const CacheHeader& header, const std::vector<float>& ratios, const std::vector<MeshLod>& lods)
+    {
+        std::ofstream file(cache, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+        write_vector(file, ratios.data(), ratios.size(), sizeof(float));
+        for (const MeshLod& lod : lods) {
+            file.write(reinterpret_cast<const char*>(&lod.error), sizeof(float));
+            file.write(reinterpret_cast<const char*>(&lod.cache_before), sizeof(VertexCacheStatistics));
+            file.write(reinterpret_cast<const char*>(&lod.cache_after), sizeof(VertexCacheStatistics));
+            write_vector(file, lod.mesh.positions.data(), lod.mesh.positions.size(), sizeof(float));
+            write_vector(file, lod.mesh.normals.data(), lod.mesh.normals.size(), sizeof(float));
+            write_vector(file, lod.mesh.tex_coords.data(), lod.mesh.tex_coords.size(), sizeof(float));
+            write_vector(file, lod.mesh.indices.data(), lod.mesh.indices.size(), sizeof(uint32_t));
+        }
+    }
+} // namespace
+
+
+
+std::vector<MeshLod> simplify_mesh(const ObjMesh& mesh, const std::vector<float>& ratios)
+{
+    Simplifier simplifier(mesh);
+    return simplifier.run(ratios);
+}
+
+std::vector<MeshLod> load_mesh_lods(const std::filesystem::path& path, const std::vector<float>& ratios, const std::filesystem::path& cache_folder)
+{
+    std::vector<MeshLod> lods;
+
+    std::error_code error;
+    CacheHeader header{ CACHE_MAGIC, static_cast<uint32_t>(ratios.size() + 1), std::filesystem::file_size(path, error), 0 };
+    if (!error) {
+        header.source_time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+    }
+    bool cacheable = !error && !cache_folder.empty();
+
+    std::filesystem::path cache = cache_folder / (path.filename().string() + ".lod");
+    if (cacheable && read_cache(cache, header, ratios, lods)) {
+        return lods;
+    }
+
+    ObjMesh mesh;
+    if (!load_obj(path, mesh)) {
+        return {};
+    }
+
+    std::vector<MeshLod> simplified = simplify_mesh(mesh, ratios);
+    lods.clear();
+    lods.push_back({ std::move(mesh), 0.0f, {}, {} });
+    for (MeshLod& lod : simplified) {
+        lods.push_back(std::move(lod));
+    }
+
+    // obj (and simplifier) order is poor for post-transform cache and overdraw
+    for (MeshLod& lod : lods) {
+        optimize_mesh(lod.mesh, &lod.cache_before, &lod.cache_after);
+    }
+
+    if (cacheable) {
+        std::filesystem::create_directories(cache_folder, error);
+        write_cache(cache, header, ratios, lods);
+    }
+    return lods;
+}
+
+size_t select_mesh_lod(const std::vector<float>& errors, float scale, float distance, float pixels_per_unit, float max_pixels)
+{
+    distance = std::max(distance, 1e-3f);
+    for (size_t i = errors.size(); i-- > 1;) {
+        if (errors[i] * scale * pixels_per_unit / distance <= max_pixels) {
+            return i;
+        }
+    }
+    return 0;
+}
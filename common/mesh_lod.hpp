@@ -0,0 +1,36 @@
+#pragma once
+
+#include "mesh_optimizer.hpp"
+#include "obj_loader.hpp"
+
+#include <filesystem>
+#include <vector>
+
+
+
+// one level of detail of a mesh
+struct MeshLod
+{
+    ObjMesh mesh;
+    float error; // approximate distance of simplified surface from the original (model space), 0 for the original
+
+    // index order of the level before and after optimize_mesh (load_mesh_lods only)
+    VertexCacheStatistics cache_before;
+    VertexCacheStatistics cache_after;
+};
+
+
+// quadric error metric edge collapse (Garland-Heckbert), one lod per ratio of triangle count (e.g. 0.5, 0.25, 0.1)
+// vertices are welded by position first, so collapses are not blocked by normal / uv seams; moved corners take the
+// attributes of the closest original vertex at the kept position; open borders are preserved by perpendicular constraint planes, collapses that flip
+// a triangle or pinch the surface (more than two common neighbors) are rejected
+// lods are snapshots of one collapse sequence, a lod may keep more triangles when no valid collapse is left
+std::vector<MeshLod> simplify_mesh(const ObjMesh& mesh, const std::vector<float>& ratios);
+
+// original obj (level 0) + simplify_mesh lods, each reordered by optimize_mesh, stored in cache_folder ("<file name>.lod", keyed by source size,
+// write time and ratios), so later runs only read them; empty result when obj can't be loaded
+std::vector<MeshLod> load_mesh_lods(const std::filesystem::path& path, const std::vector<float>& ratios, const std::filesystem::path& cache_folder);
+
+// coarsest lod whose error projected to the screen is at most max_pixels
+// scale - of model matrix, distance - from eye, pixels_per_unit - size of one unit at distance 1 (viewport_height / 2 * projection[1][1])
+size_t select_mesh_lod(const std::vector<float>& errors, float scale, float distance, float pixels_per_unit, float max_pixels);
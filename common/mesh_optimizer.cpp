@@ -0,0 +1,386 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+
+
+namespace {
+    //  ===============================================  Forsyth  ===============================================
+
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    // cache position -1 = not in cache
+    float get_vertex_score(int cache_position, uint32_t live_triangles)
+    {
+        if (live_triangles == 0) {
+            return -1.0f; // no triangle needs it
+        }
+
+        float score = 0.0f;
+        if (cache_position >= 0) {
+            if (cache_position < 3) {
+                // vertices of last triangle, fixed score so that strips are not preferred over fans
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                float scale = 1.0f / (CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cache_position - 3) * scale, CACHE_DECAY_POWER);
+            }
+        }
+
+        // vertices with few triangles left are finished first
+        score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(live_triangles), -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+
+    //  ===============================================  overdraw  ===============================================
+
+    // fifo cache simulation of triangles [first, last), returns misses
+    size_t count_cache_misses(const uint32_t* indices, size_t first, size_t last, std::vector<uint32_t>& timestamps, uint32_t& time,
+                              size_t cache_size)
+    {
+        size_t misses = 0;
+        for (size_t i = 3 * first; i < 3 * last; i++) {
+            uint32_t vertex = indices[i];
+            if (time - timestamps[vertex] > cache_size) {
+                timestamps[vertex] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    const size_t OVERDRAW_CACHE_SIZE = 16;
+} // namespace
+
+
+
+VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size)
+{
+    VertexCacheStatistics statistics;
+    if (indices.size() < 3 || vertex_count == 0) {
+        return statistics;
+    }
+
+    // fifo of cache_size entries by timestamps (vertex is in cache while it was pushed less than cache_size misses ago)
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    std::vector<uint8_t> referenced(vertex_count, 0);
+    uint32_t time = static_cast<uint32_t>(cache_size) + 1;
+
+    size_t misses = 0;
+    size_t referenced_count = 0;
+    for (uint32_t vertex : indices) {
+        if (time - timestamps[vertex] > cache_size) {
+            timestamps[vertex] = time++;
+            misses++;
+        }
+        if (!referenced[vertex]) {
+            referenced[vertex] = 1;
+            referenced_count++;
+        }
+    }
+
+    statistics.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    statistics.atvr = static_cast<float>(misses) / static_cast<float>(referenced_count);
+    return statistics;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count)
+{
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // vertex -> triangles (compressed rows), live triangles are kept at the front of each row
+    std::vector<uint32_t> live_triangles(vertex_count, 0);
+    for (size_t i = 0; i < 3 * triangle_count; i++) {
+        live_triangles[indices[i]]++;
+    }
+
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] = offsets[v] + live_triangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(offsets[vertex_count]);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangle_count; t++) {
+        for (int c = 0; c < 3; c++) {
+            adjacency[fill[indices[3 * t + c]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> vertex_scores(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        vertex_scores[v] = get_vertex_score(-1, live_triangles[v]);
+    }
+
+    std::vector<float> triangle_scores(triangle_count);
+    for (size_t t = 0; t < triangle_count; t++) {
+        triangle_scores[t] = vertex_scores[indices[3 * t]] + vertex_scores[indices[3 * t + 1]] + vertex_scores[indices[3 * t + 2]];
+    }
+
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> result;
+    result.reserve(3 * triangle_count);
+
+    // lru cache (front = most recent), +3 for vertices pushed out by the last triangle
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    cache.reserve(CACHE_SIZE + 3);
+    new_cache.reserve(CACHE_SIZE + 3);
+
+    size_t next_unemitted = 0;
+    size_t best_triangle = 0;
+    float best_score = triangle_scores[0];
+    for (size_t t = 1; t < triangle_count; t++) {
+        if (triangle_scores[t] > best_score) {
+            best_score = triangle_scores[t];
+            best_triangle = t;
+        }
+    }
+
+    for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++) {
+        if (best_score < 0.0f) {
+            // nothing in cache, continue with next triangle in input order
+            while (emitted[next_unemitted]) {
+                next_unemitted++;
+            }
+            best_triangle = next_unemitted;
+        }
+
+        emitted[best_triangle] = 1;
+        const uint32_t* triangle = &indices[3 * best_triangle];
+        result.insert(result.end(), triangle, triangle + 3);
+
+        // triangle vertices go to the front of cache, then the rest in previous order
+        new_cache.clear();
+        for (int c = 0; c < 3; c++) {
+            uint32_t vertex = triangle[c];
+            new_cache.push_back(vertex);
+
+            // emitted triangle is moved behind live ones
+            uint32_t* row = &adjacency[offsets[vertex]];
+            uint32_t live = live_triangles[vertex];
+            for (uint32_t i = 0; i < live; i++) {
+                if (row[i] == best_triangle) {
+                    std::swap(row[i], row[live - 1]);
+                    break;
+                }
+            }
+            live_triangles[vertex]--;
+        }
+        for (uint32_t vertex : cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                new_cache.push_back(vertex);
+            }
+        }
+        std::swap(cache, new_cache);
+
+        // scores of vertices in (or just pushed out of) cache, their live triangles are candidates for the next one
+        best_score = -1.0f;
+        for (size_t i = 0; i < cache.size(); i++) {
+            uint32_t vertex = cache[i];
+            cache_positions[vertex] = i < CACHE_SIZE ? static_cast<int>(i) : -1;
+
+            float score = get_vertex_score(cache_positions[vertex], live_triangles[vertex]);
+            float delta = score - vertex_scores[vertex];
+            vertex_scores[vertex] = score;
+
+            const uint32_t* row = &adjacency[offsets[vertex]];
+            for (uint32_t j = 0; j < live_triangles[vertex]; j++) {
+                uint32_t t = row[j];
+                triangle_scores[t] += delta;
+                if (triangle_scores[t] > best_score) {
+                    best_score = triangle_scores[t];
+                    best_triangle = t;
+                }
+            }
+        }
+        if (cache.size() > CACHE_SIZE) {
+            cache.resize(CACHE_SIZE);
+        }
+    }
+
+    indices.swap(result);
+}
+
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, float threshold)
+{
+    size_t triangle_count = indices.size() / 3;
+    size_t vertex_count = positions.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // hard boundaries - triangles missing in cache with all 3 vertices (cache optimizer started a new area there)
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t time = OVERDRAW_CACHE_SIZE + 1;
+
+    // first triangle always starts a cluster (it may hit the cache, e.g. degenerate or repeated index)
+    std::vector<size_t> hard_clusters = { 0 };
+    for (size_t t = 0; t < triangle_count; t++) {
+        bool cold = count_cache_misses(indices.data(), t, t + 1, timestamps, time, OVERDRAW_CACHE_SIZE) == 3;
+        if (cold && t > 0) {
+            hard_clusters.push_back(t);
+        }
+    }
+    hard_clusters.push_back(triangle_count);
+
+    // soft boundaries - cluster is closed once its acmr (cache cold at its start) gets within threshold of hard cluster acmr
+    std::vector<size_t> clusters;
+    for (size_t h = 0; h + 1 < hard_clusters.size(); h++) {
+        size_t start = hard_clusters[h];
+        size_t end = hard_clusters[h + 1];
+
+        time += OVERDRAW_CACHE_SIZE + 1; // cold cache
+        float hard_acmr = static_cast<float>(count_cache_misses(indices.data(), start, end, timestamps, time, OVERDRAW_CACHE_SIZE))
+                          / static_cast<float>(end - start);
+
+        time += OVERDRAW_CACHE_SIZE + 1;
+        size_t cluster_start = start;
+        size_t cluster_misses = 0;
+        for (size_t t = start; t < end; t++) {
+            cluster_misses += count_cache_misses(indices.data(), t, t + 1, timestamps, time, OVERDRAW_CACHE_SIZE);
+            float acmr = static_cast<float>(cluster_misses) / static_cast<float>(t + 1 - cluster_start);
+
+            if (t + 1 < end && acmr <= hard_acmr * threshold) {
+                clusters.push_back(cluster_start);
+                cluster_start = t + 1;
+                cluster_misses = 0;
+                time += OVERDRAW_CACHE_SIZE + 1;
+            }
+        }
+        clusters.push_back(cluster_start);
+    }
+    clusters.push_back(triangle_count);
+
+    // mesh center (area weighted)
+    auto get_triangle = [&](size_t t, float (&corners)[3][3], float (&normal)[3], float& area) {
+        for (int c = 0; c < 3; c++) {
+            const float* p = &positions[3 * indices[3 * t + c]];
+            corners[c][0] = p[0], corners[c][1] = p[1], corners[c][2] = p[2];
+        }
+        float e1[3] = { corners[1][0] - corners[0][0], corners[1][1] - corners[0][1], corners[1][2] - corners[0][2] };
+        float e2[3] = { corners[2][0] - corners[0][0], corners[2][1] - corners[0][1], corners[2][2] - corners[0][2] };
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    };
+
+    double mesh_center[3] = { 0.0, 0.0, 0.0 };
+    double mesh_area = 0.0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        float corners[3][3], normal[3], area;
+        get_triangle(t, corners, normal, area);
+        for (int k = 0; k < 3; k++) {
+            mesh_center[k] += area * (corners[0][k] + corners[1][k] + corners[2][k]) / 3.0;
+        }
+        mesh_area += area;
+    }
+    for (int k = 0; k < 3; k++) {
+        mesh_center[k] /= std::max(mesh_area, 1e-20);
+    }
+
+    // cluster key - distance of cluster center from mesh center along cluster normal (outward facing first)
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<float> keys(cluster_count);
+    for (size_t i = 0; i < cluster_count; i++) {
+        double center[3] = { 0.0, 0.0, 0.0 };
+        double cluster_normal[3] = { 0.0, 0.0, 0.0 };
+        double cluster_area = 0.0;
+        for (size_t t = clusters[i]; t < clusters[i + 1]; t++) {
+            float corners[3][3], normal[3], area;
+            get_triangle(t, corners, normal, area);
+            for (int k = 0; k < 3; k++) {
+                center[k] += area * (corners[0][k] + corners[1][k] + corners[2][k]) / 3.0;
+                cluster_normal[k] += normal[k];
+            }
+            cluster_area += area;
+        }
+
+        double normal_length = std::sqrt(cluster_normal[0] * cluster_normal[0] + cluster_normal[1] * cluster_normal[1] + cluster_normal[2] * cluster_normal[2]);
+        double key = 0.0;
+        for (int k = 0; k < 3; k++) {
+            key += (center[k] / std::max(cluster_area, 1e-20) - mesh_center[k]) * cluster_normal[k] / std::max(normal_length, 1e-20);
+        }
+        keys[i] = static_cast<float>(key);
+    }
+
+    std::vector<size_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (size_t i : order) {
+        result.insert(result.end(), indices.begin() + 3 * clusters[i], indices.begin() + 3 * clusters[i + 1]);
+    }
+    assert(result.size() == 3 * triangle_count); // clusters cover all triangles
+    indices.swap(result);
+}
+
+void optimize_vertex_fetch(ObjMesh& mesh)
+{
+    size_t vertex_count = mesh.positions.size() / 3;
+    bool has_normals = mesh.normals.size() == 3 * vertex_count;
+    bool has_tex_coords = mesh.tex_coords.size() == 2 * vertex_count;
+
+    const uint32_t unused = ~0u;
+    std::vector<uint32_t> remap(vertex_count, unused);
+    uint32_t next = 0;
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+
+    ObjMesh result;
+    result.positions.resize(3 * next);
+    result.normals.resize(has_normals ? 3 * next : 0);
+    result.tex_coords.resize(has_tex_coords ? 2 * next : 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        uint32_t target = remap[v];
+        if (target == unused) {
+            continue;
+        }
+        std::copy_n(&mesh.positions[3 * v], 3, &result.positions[3 * target]);
+        if (has_normals) {
+            std::copy_n(&mesh.normals[3 * v], 3, &result.normals[3 * target]);
+        }
+        if (has_tex_coords) {
+            std::copy_n(&mesh.tex_coords[2 * v], 2, &result.tex_coords[2 * target]);
+        }
+    }
+
+    mesh.positions.swap(result.positions);
+    mesh.normals.swap(result.normals);
+    mesh.tex_coords.swap(result.tex_coords);
+}
+
+void optimize_mesh(ObjMesh& mesh, VertexCacheStatistics* before, VertexCacheStatistics* after)
+{
+    size_t vertex_count = mesh.positions.size() / 3;
+    if (before) {
+        *before = analyze_vertex_cache(mesh.indices, vertex_count);
+    }
+
+    optimize_vertex_cache(mesh.indices, vertex_count);
+    optimize_overdraw(mesh.indices, mesh.positions);
+    optimize_vertex_fetch(mesh);
+
+    if (after) {
+        *after = analyze_vertex_cache(mesh.indices, mesh.positions.size() / 3);
+    }
+}
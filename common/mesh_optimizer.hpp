@@ -0,0 +1,35 @@
+#pragma once
+
+#include "obj_loader.hpp"
+
+#include <cstdint>
+#include <vector>
+
+
+
+// post-transform cache efficiency of an index order (fifo cache simulation)
+struct VertexCacheStatistics
+{
+    float acmr = 0.0f; // average cache miss ratio, transformed vertices per triangle (0.5 - 3)
+    float atvr = 0.0f; // average transform to vertex ratio, transformed vertices per referenced vertex (1 = optimal)
+};
+
+VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, size_t cache_size = 16);
+
+
+// Forsyth's linear speed vertex cache optimization (lru cache model of 32 entries), greedily emits the triangle
+// with the highest score of its vertices (recently used, few remaining triangles)
+void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count);
+
+// Tipsify-like overdraw ordering (Sander et al.), expects cache optimized indices
+// the order is split into clusters where the cache restarts (hard boundaries) and where the cluster acmr stays
+// within threshold times the acmr of its hard cluster (soft boundaries), clusters are then sorted by how much they
+// face away from the mesh center, outer surfaces are drawn first and occlude the inner ones
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, float threshold = 1.05f);
+
+// vertices are reordered by first use in indices (sequential fetches), unreferenced vertices are dropped
+void optimize_vertex_fetch(ObjMesh& mesh);
+
+
+// all three passes above, statistics of the order before and after (cache of 16 entries)
+void optimize_mesh(ObjMesh& mesh, VertexCacheStatistics* before = nullptr, VertexCacheStatistics* after = nullptr);
@@ -0,0 +1,687 @@
+#include "obj_loader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double get_elapsed_ms(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+
+    //  ===============================================  MappedFile  ===============================================
+
+    // read only view of whole file
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::filesystem::path& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool is_valid() const { return view != nullptr; }
+        const char* data() const { return view; }
+        size_t size() const { return length; }
+
+    private:
+        const char* view = nullptr;
+        size_t length = 0;
+
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int descriptor = -1;
+#endif
+    };
+
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::filesystem::path& path)
+    {
+        file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            return;
+        }
+
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            return;
+        }
+
+        view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        length = view != nullptr ? static_cast<size_t>(file_size.QuadPart) : 0;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (view != nullptr) {
+            UnmapViewOfFile(view);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+    }
+#else
+    MappedFile::MappedFile(const std::filesystem::path& path)
+    {
+        descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            return;
+        }
+
+        struct stat file_stat;
+        if (fstat(descriptor, &file_stat) != 0 || file_stat.st_size == 0) {
+            return;
+        }
+
+        void* address = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address == MAP_FAILED) {
+            return;
+        }
+        madvise(address, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+
+        view = static_cast<const char*>(address);
+        length = static_cast<size_t>(file_stat.st_size);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (view != nullptr) {
+            munmap(const_cast<char*>(view), length);
+        }
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+    }
+#endif
+
+
+    //  ===============================================  tokenization  ===============================================
+
+    const double POWERS_OF_10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    // spaces inside line ('\r' of crlf files included)
+    inline const char* skip_spaces(const char* p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            p++;
+        }
+        return p;
+    }
+
+    inline const char* skip_line(const char* p, const char* end)
+    {
+        while (p < end && *p != '\n') {
+            p++;
+        }
+        return p < end ? p + 1 : end;
+    }
+
+    // decimal float with optional exponent, 19 significant digits at most (enough for float)
+    // returns p if there is no number
+    const char* parse_float(const char* p, const char* end, float& value)
+    {
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        bool any = false;
+        for (; p < end && is_digit(*p); p++) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                digits += mantissa != 0 ? 1 : 0;
+            } else {
+                exponent++;
+            }
+        }
+        if (p < end && *p == '.') {
+            for (p++; p < end && is_digit(*p); p++) {
+                any = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    digits += mantissa != 0 ? 1 : 0;
+                    exponent--;
+                }
+            }
+        }
+        if (!any) {
+            return start;
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            const char* exponent_start = p++;
+            bool exponent_negative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                exponent_negative = *p == '-';
+                p++;
+            }
+            if (p < end && is_digit(*p)) {
+                int e = 0;
+                for (; p < end && is_digit(*p); p++) {
+                    e = std::min(e * 10 + (*p - '0'), 1000);
+                }
+                exponent += exponent_negative ? -e : e;
+            } else {
+                p = exponent_start; // 'e' is not part of the number
+            }
+        }
+
+        double result = static_cast<double>(mantissa);
+        if (exponent < 0) {
+            result = -exponent <= 22 ? result / POWERS_OF_10[-exponent] : result * std::pow(10.0, exponent);
+        } else if (exponent > 0) {
+            result = exponent <= 22 ? result * POWERS_OF_10[exponent] : result * std::pow(10.0, exponent);
+        }
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    // returns p if there is no number
+    const char* parse_int(const char* p, const char* end, int32_t& value)
+    {
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+        if (p >= end || !is_digit(*p)) {
+            return start;
+        }
+
+        int64_t result = 0;
+        for (; p < end && is_digit(*p); p++) {
+            result = std::min<int64_t>(result * 10 + (*p - '0'), std::numeric_limits<int32_t>::max());
+        }
+        value = static_cast<int32_t>(negative ? -result : result);
+        return p;
+    }
+
+
+    //  ===============================================  chunks  ===============================================
+
+    // face corner, indices into merged attribute arrays (-1 = missing)
+    // relative (negative) obj indices are stored relative to start of their chunk until merge, flagged in relative bits
+    struct Corner
+    {
+        int32_t position;
+        int32_t tex_coord;
+        int32_t normal;
+        uint32_t relative; // bit 0 = position, 1 = tex coord, 2 = normal
+    };
+
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+
+        std::vector<float> positions;
+        std::vector<float> tex_coords;
+        std::vector<float> normals;
+        std::vector<Corner> corners; // triangles
+
+        // offsets of chunk attributes in merged arrays (counts of previous chunks)
+        int32_t position_offset = 0;
+        int32_t tex_coord_offset = 0;
+        int32_t normal_offset = 0;
+    };
+
+    inline void set_index(int32_t raw, size_t local_count, uint32_t bit, int32_t& index, uint32_t& relative)
+    {
+        if (raw > 0) {
+            index = raw - 1;
+        } else if (raw < 0) {
+            index = static_cast<int32_t>(local_count) + raw;
+            relative |= bit;
+        } else {
+            index = -1;
+        }
+    }
+
+    void parse_chunk(Chunk& chunk)
+    {
+        const char* p = chunk.begin;
+        const char* end = chunk.end;
+
+        std::vector<Corner> polygon;
+        float values[3];
+
+        while (p < end) {
+            p = skip_spaces(p, end);
+            if (p + 1 >= end) {
+                break;
+            }
+
+            if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+                p += 2;
+                for (float& value : values) {
+                    value = 0.0f;
+                    p = parse_float(skip_spaces(p, end), end, value);
+                }
+                chunk.positions.insert(chunk.positions.end(), values, values + 3);
+            } else if (p[0] == 'v' && p[1] == 't') {
+                p += 2;
+                for (int i = 0; i < 2; i++) {
+                    values[i] = 0.0f;
+                    p = parse_float(skip_spaces(p, end), end, values[i]);
+                }
+                chunk.tex_coords.insert(chunk.tex_coords.end(), values, values + 2);
+            } else if (p[0] == 'v' && p[1] == 'n') {
+                p += 2;
+                for (float& value : values) {
+                    value = 0.0f;
+                    p = parse_float(skip_spaces(p, end), end, value);
+                }
+                chunk.normals.insert(chunk.normals.end(), values, values + 3);
+            } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+                p += 2;
+                polygon.clear();
+                while (true) {
+                    p = skip_spaces(p, end);
+                    int32_t raw = 0;
+                    const char* next = parse_int(p, end, raw);
+                    if (next == p) {
+                        break; // end of line (or unexpected token)
+                    }
+                    p = next;
+
+                    Corner corner{ -1, -1, -1, 0 };
+                    set_index(raw, chunk.positions.size() / 3, 1, corner.position, corner.relative);
+                    if (p < end && *p == '/') {
+                        p++;
+                        if (p < end && *p != '/') {
+                            raw = 0;
+                            p = parse_int(p, end, raw);
+                            set_index(raw, chunk.tex_coords.size() / 2, 2, corner.tex_coord, corner.relative);
+                        }
+                        if (p < end && *p == '/') {
+                            raw = 0;
+                            p = parse_int(p + 1, end, raw);
+                            set_index(raw, chunk.normals.size() / 3, 4, corner.normal, corner.relative);
+                        }
+                    }
+                    polygon.push_back(corner);
+                }
+
+                // fan triangulation
+                for (size_t i = 2; i < polygon.size(); i++) {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            }
+
+            p = skip_line(p, end);
+        }
+    }
+
+    // chunks start after a line break
+    std::vector<Chunk> split_chunks(const char* data, size_t size, size_t count)
+    {
+        std::vector<Chunk> chunks(count);
+
+        const char* end = data + size;
+        const char* begin = data;
+        for (size_t i = 0; i < count; i++) {
+            const char* chunk_end = i + 1 == count ? end : std::max(begin, data + size * (i + 1) / count);
+            if (chunk_end < end) {
+                chunk_end = skip_line(chunk_end, end);
+            }
+            chunks[i].begin = begin;
+            chunks[i].end = chunk_end;
+            begin = chunk_end;
+        }
+        return chunks;
+    }
+
+
+    //  ===============================================  deduplication  ===============================================
+
+    // open addressing (linear probing), key = resolved corner
+    class VertexTable
+    {
+    public:
+        explicit VertexTable(size_t expected_count)
+        {
+            size_t capacity = 1024;
+            while (capacity < expected_count * 2) {
+                capacity *= 2;
+            }
+            resize(capacity);
+        }
+
+        // returns index of vertex, inserts it with index count if it's new (inserted = true)
+        uint32_t find_or_insert(const Corner& corner, uint32_t count, bool& inserted)
+        {
+            if ((size + 1) * 2 > entries.size()) {
+                resize(entries.size() * 2);
+            }
+
+            size_t mask = entries.size() - 1;
+            for (size_t slot = hash(corner) & mask;; slot = (slot + 1) & mask) {
+                Entry& entry = entries[slot];
+                if (entry.vertex == EMPTY) {
+                    entry = { corner.position, corner.tex_coord, corner.normal, count };
+                    size++;
+                    inserted = true;
+                    return count;
+                }
+                if (entry.position == corner.position && entry.tex_coord == corner.tex_coord && entry.normal == corner.normal) {
+                    inserted = false;
+                    return entry.vertex;
+                }
+            }
+        }
+
+    private:
+        static const uint32_t EMPTY = 0xFFFFFFFFu;
+
+        struct Entry
+        {
+            int32_t position;
+            int32_t tex_coord;
+            int32_t normal;
+            uint32_t vertex;
+        };
+
+        std::vector<Entry> entries;
+        size_t size = 0;
+
+        static size_t hash(const Corner& corner)
+        {
+            uint64_t h = static_cast<uint32_t>(corner.position);
+            h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(corner.tex_coord);
+            h = h * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(corner.normal);
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+
+        void resize(size_t capacity)
+        {
+            std::vector<Entry> old;
+            old.swap(entries);
+            entries.assign(capacity, { 0, 0, 0, EMPTY });
+
+            size_t mask = capacity - 1;
+            for (const Entry& entry : old) {
+                if (entry.vertex == EMPTY) {
+                    continue;
+                }
+                size_t slot = hash({ entry.position, entry.tex_coord, entry.normal, 0 }) & mask;
+                while (entries[slot].vertex != EMPTY) {
+                    slot = (slot + 1) & mask;
+                }
+                entries[slot] = entry;
+            }
+        }
+    };
+
+    inline int32_t resolve(int32_t index, uint32_t relative, uint32_t bit, int32_t offset, size_t count)
+    {
+        if (index < 0 && !(relative & bit)) {
+            return -1;
+        }
+        index += (relative & bit) ? offset : 0;
+        return index >= 0 && static_cast<size_t>(index) < count ? index : -2; // -2 = out of range
+    }
+} // namespace
+
+
+
+//  ===============================================  load_obj  ===============================================
+
+bool load_obj(const std::filesystem::path& path, ObjMesh& mesh, size_t thread_count, ObjLoadStatistics* statistics)
+{
+    ObjLoadStatistics stats;
+    Clock::time_point start = Clock::now();
+
+    mesh = ObjMesh();
+
+    MappedFile file(path);
+    if (!file.is_valid()) {
+        return false;
+    }
+    stats.bytes = file.size();
+    stats.map_ms = get_elapsed_ms(start);
+
+    // parallel tokenization, small files are not split (chunks of 1 MB at least)
+    Clock::time_point parse_start = Clock::now();
+    if (thread_count == 0) {
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    size_t chunk_count = std::max<size_t>(1, std::min(thread_count, file.size() >> 20));
+    stats.threads = chunk_count;
+
+    std::vector<Chunk> chunks = split_chunks(file.data(), file.size(), chunk_count);
+    if (chunk_count == 1) {
+        parse_chunk(chunks[0]);
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < chunk_count; i++) {
+            workers.emplace_back(parse_chunk, std::ref(chunks[i]));
+        }
+        parse_chunk(chunks[0]);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // merged attributes, prefix sums of chunk counts
+    std::vector<float> positions;
+    std::vector<float> tex_coords;
+    std::vector<float> normals;
+    size_t corner_count = 0;
+    for (Chunk& chunk : chunks) {
+        chunk.position_offset = static_cast<int32_t>(positions.size() / 3);
+        chunk.tex_coord_offset = static_cast<int32_t>(tex_coords.size() / 2);
+        chunk.normal_offset = static_cast<int32_t>(normals.size() / 3);
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        tex_coords.insert(tex_coords.end(), chunk.tex_coords.begin(), chunk.tex_coords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        corner_count += chunk.corners.size();
+
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.tex_coords);
+        std::vector<float>().swap(chunk.normals);
+    }
+    stats.parse_ms = get_elapsed_ms(parse_start);
+
+    // deduplication in file order (vertex order follows first use, good locality of index buffer)
+    Clock::time_point dedup_start = Clock::now();
+    size_t position_count = positions.size() / 3;
+    size_t tex_coord_count = tex_coords.size() / 2;
+    size_t normal_count = normals.size() / 3;
+
+    VertexTable table(std::max(position_count, tex_coord_count));
+    mesh.indices.reserve(corner_count);
+    mesh.positions.reserve(position_count * 3);
+    mesh.normals.reserve(position_count * 3);
+    mesh.tex_coords.reserve(position_count * 2);
+
+    std::vector<uint8_t> missing_normal;
+    bool any_missing_normal = false;
+
+    for (const Chunk& chunk : chunks) {
+        for (size_t i = 0; i + 2 < chunk.corners.size(); i += 3) {
+            Corner triangle[3];
+            bool valid = true;
+            for (int c = 0; c < 3; c++) {
+                const Corner& corner = chunk.corners[i + c];
+                triangle[c].position = resolve(corner.position, corner.relative, 1, chunk.position_offset, position_count);
+                triangle[c].tex_coord = std::max(resolve(corner.tex_coord, corner.relative, 2, chunk.tex_coord_offset, tex_coord_count), -1);
+                triangle[c].normal = std::max(resolve(corner.normal, corner.relative, 4, chunk.normal_offset, normal_count), -1);
+                valid = valid && triangle[c].position >= 0;
+            }
+            if (!valid) {
+                continue; // triangles with missing positions are dropped
+            }
+
+            for (const Corner& corner : triangle) {
+                bool inserted;
+                uint32_t vertex = table.find_or_insert(corner, static_cast<uint32_t>(mesh.positions.size() / 3), inserted);
+                if (inserted) {
+                    const float* position = &positions[3 * static_cast<size_t>(corner.position)];
+                    mesh.positions.insert(mesh.positions.end(), position, position + 3);
+
+                    if (corner.tex_coord >= 0) {
+                        const float* tex_coord = &tex_coords[2 * static_cast<size_t>(corner.tex_coord)];
+                        mesh.tex_coords.insert(mesh.tex_coords.end(), tex_coord, tex_coord + 2);
+                    } else {
+                        mesh.tex_coords.insert(mesh.tex_coords.end(), { 0.0f, 0.0f });
+                    }
+
+                    if (corner.normal >= 0) {
+                        const float* normal = &normals[3 * static_cast<size_t>(corner.normal)];
+                        mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+                    } else {
+                        mesh.normals.insert(mesh.normals.end(), { 0.0f, 0.0f, 0.0f });
+                    }
+                    missing_normal.push_back(corner.normal < 0 ? 1 : 0);
+                    any_missing_normal = any_missing_normal || corner.normal < 0;
+                }
+                mesh.indices.push_back(vertex);
+            }
+        }
+    }
+
+    // area weighted face normals for vertices without normal
+    if (any_missing_normal) {
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const uint32_t* triangle = &mesh.indices[i];
+            const float* p0 = &mesh.positions[3 * static_cast<size_t>(triangle[0])];
+            const float* p1 = &mesh.positions[3 * static_cast<size_t>(triangle[1])];
+            const float* p2 = &mesh.positions[3 * static_cast<size_t>(triangle[2])];
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float face_normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            for (int c = 0; c < 3; c++) {
+                if (missing_normal[triangle[c]]) {
+                    for (int k = 0; k < 3; k++) {
+                        mesh.normals[3 * static_cast<size_t>(triangle[c]) + k] += face_normal[k];
+                    }
+                }
+            }
+        }
+        for (size_t v = 0; v < missing_normal.size(); v++) {
+            if (missing_normal[v]) {
+                float* normal = &mesh.normals[3 * v];
+                float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                if (length > 0.0f) {
+                    normal[0] /= length;
+                    normal[1] /= length;
+                    normal[2] /= length;
+                } else {
+                    normal[1] = 1.0f;
+                }
+            }
+        }
+    }
+    stats.dedup_ms = get_elapsed_ms(dedup_start);
+
+    stats.corners = mesh.indices.size();
+    stats.vertices = mesh.positions.size() / 3;
+    stats.total_ms = get_elapsed_ms(start);
+    if (statistics != nullptr) {
+        *statistics = stats;
+    }
+
+    return !mesh.indices.empty();
+}
+
+Geometry make_geometry(const ObjMesh& mesh)
+{
+    return Geometry(GL_TRIANGLES, mesh.positions, mesh.indices, mesh.normals, {}, mesh.tex_coords);
+}
+
+Geometry load_obj_geometry(const std::filesystem::path& path, size_t thread_count)
+{
+    ObjMesh mesh;
+    if (!load_obj(path, mesh, thread_count)) {
+        return Geometry::from_file(path);
+    }
+    return make_geometry(mesh);
+}
+
+void benchmark_obj(const std::filesystem::path& path, int repeat_count)
+{
+    repeat_count = std::max(repeat_count, 1);
+    std::printf("obj benchmark: %s (best of %d)\n", path.string().c_str(), repeat_count);
+
+    // Geometry::from_file includes upload, so the importer is measured with make_geometry as well
+    double from_file_ms = std::numeric_limits<double>::max();
+    size_t from_file_vertices = 0;
+    for (int r = 0; r < repeat_count; r++) {
+        Clock::time_point start = Clock::now();
+        Geometry geometry = Geometry::from_file(path);
+        from_file_ms = std::min(from_file_ms, get_elapsed_ms(start));
+        from_file_vertices = geometry.positions.size() / 3;
+    }
+    std::printf("  %-28s %9.2f ms  %zu vertices\n", "Geometry::from_file", from_file_ms, from_file_vertices);
+
+    size_t thread_counts[2] = { 1, std::max(std::thread::hardware_concurrency(), 1u) };
+    for (size_t thread_count : thread_counts) {
+        ObjLoadStatistics best;
+        best.total_ms = std::numeric_limits<double>::max();
+        double geometry_ms = std::numeric_limits<double>::max();
+        for (int r = 0; r < repeat_count; r++) {
+            ObjMesh mesh;
+            ObjLoadStatistics stats;
+            if (!load_obj(path, mesh, thread_count, &stats)) {
+                std::printf("  load_obj failed\n");
+                return;
+            }
+            if (stats.total_ms < best.total_ms) {
+                best = stats;
+            }
+
+            Clock::time_point start = Clock::now();
+            Geometry geometry = make_geometry(mesh);
+            geometry_ms = std::min(geometry_ms, stats.total_ms + get_elapsed_ms(start));
+        }
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "load_obj (%zu threads)", best.threads);
+        std::printf("  %-28s %9.2f ms  %zu vertices, %zu indices (map %.2f, parse %.2f, dedup %.2f ms), with geometry %.2f ms, %.1fx\n", name,
+                    best.total_ms, best.vertices, best.corners, best.map_ms, best.parse_ms, best.dedup_ms, geometry_ms, from_file_ms / geometry_ms);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "scene_object.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+
+
+// triangle mesh of obj file in the layout of Geometry: 3 floats per position and normal, 2 per tex coord, 32-bit indices
+// vertices are unique (position, tex coord, normal) triples of face corners; missing normals are computed from faces,
+// missing tex coords are zero
+struct ObjMesh
+{
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> tex_coords;
+    std::vector<uint32_t> indices;
+};
+
+
+struct ObjLoadStatistics
+{
+    size_t bytes = 0;
+    size_t threads = 0;
+    size_t corners = 0; // face corners after triangulation (= index count)
+    size_t vertices = 0; // unique
+
+    double map_ms = 0.0;
+    double parse_ms = 0.0; // tokenization of chunks (parallel) + merge
+    double dedup_ms = 0.0;
+    double total_ms = 0.0;
+};
+
+
+// obj importer for large models (venue models of millions of faces)
+// file is memory mapped and split into chunks at line boundaries, chunks are tokenized in parallel (own float/int parser),
+// chunk results are merged by prefix sums of their attribute counts (relative indices are resolved per chunk)
+// corners are deduplicated through an open addressing hash table, polygons are triangulated as fans
+// supported: v, vt, vn, f (v, v/t, v//n, v/t/n, negative indices), everything else (groups, materials) is ignored
+// thread_count 0 = hardware concurrency, returns false if file can't be read or has no faces
+bool load_obj(const std::filesystem::path& path, ObjMesh& mesh, size_t thread_count = 0, ObjLoadStatistics* statistics = nullptr);
+
+// indexed triangles for SceneObject
+Geometry make_geometry(const ObjMesh& mesh);
+
+// load_obj + make_geometry, falls back to Geometry::from_file when loading fails
+Geometry load_obj_geometry(const std::filesystem::path& path, size_t thread_count = 0);
+
+// times Geometry::from_file against load_obj (single thread and all threads) on the same file, prints a table to stdout
+void benchmark_obj(const std::filesystem::path& path, int repeat_count);
@@ -0,0 +1,472 @@
+#include "profiler.hpp"
+
+#include "gl_util.hpp"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+
+
+
+//  ===============================================  PipelineStatistics  ===============================================
+
+const GLenum PipelineStatistics::TARGETS[COUNT] = {
+    GL_VERTICES_SUBMITTED,
+    GL_PRIMITIVES_SUBMITTED,
+    GL_VERTEX_SHADER_INVOCATIONS,
+    GL_TESS_CONTROL_SHADER_PATCHES,
+    GL_TESS_EVALUATION_SHADER_INVOCATIONS,
+    GL_GEOMETRY_SHADER_INVOCATIONS,
+    GL_GEOMETRY_SHADER_PRIMITIVES_EMITTED,
+    GL_CLIPPING_INPUT_PRIMITIVES,
+    GL_CLIPPING_OUTPUT_PRIMITIVES,
+    GL_FRAGMENT_SHADER_INVOCATIONS,
+    GL_COMPUTE_SHADER_INVOCATIONS,
+};
+
+const char* const PipelineStatistics::NAMES[COUNT] = {
+    "vertices_submitted",
+    "primitives_submitted",
+    "vs_invocations",
+    "tcs_patches",
+    "tes_invocations",
+    "gs_invocations",
+    "gs_primitives",
+    "clipping_input",
+    "clipping_output",
+    "fs_invocations",
+    "cs_invocations",
+};
+
+
+//  ===============================================  Profiler - frames  ===============================================
+
+Profiler::Profiler() : start_time(std::chrono::steady_clock::now()) {}
+
+Profiler::~Profiler()
+{
+    if (queries_created) {
+        for (FrameSlot& slot : slots) {
+            glDeleteQueries(2 * MAX_ZONES, slot.queries);
+            if (statistics_supported) {
+                glDeleteQueries(MAX_STATISTICS_ZONES * PipelineStatistics::COUNT, slot.statistics_queries);
+            }
+        }
+    }
+}
+
+void Profiler::begin_frame()
+{
+    if (!enabled) {
+        return;
+    }
+
+    // created lazily, profiler can be a member constructed before the context
+    if (!queries_created) {
+        statistics_supported = has_gl_extension("GL_ARB_pipeline_statistics_query");
+        for (FrameSlot& slot : slots) {
+            glCreateQueries(GL_TIMESTAMP, 2 * MAX_ZONES, slot.queries);
+            if (statistics_supported) {
+                for (size_t zone = 0; zone < MAX_STATISTICS_ZONES; zone++) {
+                    for (size_t i = 0; i < PipelineStatistics::COUNT; i++) {
+                        glCreateQueries(PipelineStatistics::TARGETS[i], 1, &slot.statistics_queries[zone * PipelineStatistics::COUNT + i]);
+                    }
+                }
+            }
+        }
+        queries_created = true;
+    }
+
+    // oldest frame in flight - its queries are long finished
+    FrameSlot& slot = current_slot();
+    if (slot.pending) {
+        resolve(slot);
+    }
+
+    GLint64 gpu_time = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+
+    slot.frame.index = frame_index;
+    slot.frame.cpu_start = get_cpu_time();
+    slot.frame.cpu_end = slot.frame.cpu_start;
+    slot.frame.gpu_offset = slot.frame.cpu_start - static_cast<double>(gpu_time) * 1e-6;
+    slot.frame.zones.clear();
+    slot.statistics_zone_count = 0;
+
+    open_zones.clear();
+    statistics_open = false;
+    in_frame = true;
+}
+
+void Profiler::end_frame()
+{
+    if (!in_frame) {
+        return;
+    }
+
+    // unbalanced zones are closed at frame end
+    while (!open_zones.empty()) {
+        end_zone(open_zones.back());
+    }
+
+    FrameSlot& slot = current_slot();
+    slot.frame.cpu_end = get_cpu_time();
+    slot.pending = true;
+
+    frame_index++;
+    in_frame = false;
+}
+
+int Profiler::begin_zone(const char* name, bool gpu, bool statistics)
+{
+    FrameSlot& slot = current_slot();
+    if (!in_frame || slot.frame.zones.size() >= MAX_ZONES) {
+        return -1;
+    }
+
+    int zone = static_cast<int>(slot.frame.zones.size());
+
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, zone, -1, name);
+    if (gpu) {
+        glQueryCounter(slot.queries[2 * zone], GL_TIMESTAMP);
+    }
+
+    // one statistics query of each target can be active, collecting zones don't nest
+    bool has_statistics = statistics && collect_statistics && statistics_supported && !statistics_open && slot.statistics_zone_count < MAX_STATISTICS_ZONES;
+    if (has_statistics) {
+        const GLuint* queries = &slot.statistics_queries[slot.statistics_zone_count * PipelineStatistics::COUNT];
+        for (size_t i = 0; i < PipelineStatistics::COUNT; i++) {
+            glBeginQuery(PipelineStatistics::TARGETS[i], queries[i]);
+        }
+        slot.statistics_zone_count++;
+        statistics_open = true;
+    }
+
+    slot.frame.zones.push_back({ name, static_cast<int>(open_zones.size()), get_cpu_time(), 0.0, gpu, 0.0, 0.0, has_statistics, {} });
+    open_zones.push_back(zone);
+
+    return zone;
+}
+
+void Profiler::end_zone(int zone)
+{
+    if (!in_frame || zone < 0 || open_zones.empty() || open_zones.back() != zone) {
+        return;
+    }
+
+    FrameSlot& slot = current_slot();
+    ProfilerZone& z = slot.frame.zones[zone];
+
+    if (z.has_statistics) {
+        for (size_t i = 0; i < PipelineStatistics::COUNT; i++) {
+            glEndQuery(PipelineStatistics::TARGETS[i]);
+        }
+        statistics_open = false;
+    }
+    if (z.has_gpu) {
+        glQueryCounter(slot.queries[2 * zone + 1], GL_TIMESTAMP);
+    }
+    glPopDebugGroup();
+
+    z.cpu_end = get_cpu_time();
+    open_zones.pop_back();
+}
+
+const ProfilerFrame* Profiler::get_last_frame() const
+{
+    return history.empty() ? nullptr : &history.back();
+}
+
+std::vector<ProfilerZoneAverage> Profiler::get_averages() const
+{
+    std::vector<ProfilerZoneAverage> averages;
+    const ProfilerFrame* last_frame = get_last_frame();
+    if (last_frame == nullptr) {
+        return averages;
+    }
+
+    std::map<std::string, size_t> indices;
+    for (const ProfilerZone& zone : last_frame->zones) {
+        if (indices.try_emplace(zone.name, averages.size()).second) {
+            averages.push_back({ zone.name, zone.depth, 0.0, 0.0, 0.0, 0, {} });
+        }
+    }
+
+    // sums over history, frames_with_zone counts frames in which zone was recorded
+    std::vector<size_t> frames_with_zone(averages.size(), 0);
+    std::vector<size_t> last_counted_frame(averages.size(), SIZE_MAX);
+    std::vector<size_t> last_statistics_frame(averages.size(), SIZE_MAX);
+
+    for (const ProfilerFrame& frame : history) {
+        for (const ProfilerZone& zone : frame.zones) {
+            auto it = indices.find(zone.name);
+            if (it == indices.end()) {
+                continue;
+            }
+            size_t i = it->second;
+            ProfilerZoneAverage& average = averages[i];
+
+            if (last_counted_frame[i] != frame.index) {
+                last_counted_frame[i] = frame.index;
+                frames_with_zone[i]++;
+            }
+
+            average.calls += 1.0;
+            average.cpu_time += zone.cpu_end - zone.cpu_start;
+            if (zone.has_gpu) {
+                average.gpu_time += zone.gpu_end - zone.gpu_start;
+            }
+            if (zone.has_statistics) {
+                if (last_statistics_frame[i] != frame.index) {
+                    last_statistics_frame[i] = frame.index;
+                    average.statistics_frames++;
+                }
+                for (size_t s = 0; s < PipelineStatistics::COUNT; s++) {
+                    average.statistics[s] += static_cast<double>(zone.statistics.values[s]);
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < averages.size(); i++) {
+        ProfilerZoneAverage& average = averages[i];
+        double frames = static_cast<double>(std::max(frames_with_zone[i], size_t(1)));
+        average.calls /= frames;
+        average.cpu_time /= frames;
+        average.gpu_time /= frames;
+        for (size_t s = 0; s < PipelineStatistics::COUNT; s++) {
+            average.statistics[s] /= static_cast<double>(std::max(average.statistics_frames, size_t(1)));
+        }
+    }
+
+    return averages;
+}
+
+bool Profiler::is_statistics_supported() const
+{
+    return statistics_supported;
+}
+
+double Profiler::get_cpu_time() const
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+Profiler::FrameSlot& Profiler::current_slot()
+{
+    return slots[frame_index % FRAMES_IN_FLIGHT];
+}
+
+void Profiler::resolve(FrameSlot& slot)
+{
+    size_t statistics_zone = 0;
+    for (size_t i = 0; i < slot.frame.zones.size(); i++) {
+        ProfilerZone& zone = slot.frame.zones[i];
+
+        // statistics zones took queries in order of opening
+        if (zone.has_statistics) {
+            const GLuint* queries = &slot.statistics_queries[statistics_zone * PipelineStatistics::COUNT];
+            for (size_t s = 0; s < PipelineStatistics::COUNT; s++) {
+                glGetQueryObjectui64v(queries[s], GL_QUERY_RESULT, &zone.statistics.values[s]);
+            }
+            statistics_zone++;
+        }
+
+        if (!zone.has_gpu) {
+            continue;
+        }
+
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(slot.queries[2 * i], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(slot.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+
+        zone.gpu_start = static_cast<double>(start) * 1e-6 + slot.frame.gpu_offset;
+        zone.gpu_end = static_cast<double>(end) * 1e-6 + slot.frame.gpu_offset;
+    }
+
+    history.push_back(slot.frame);
+    if (history.size() > HISTORY_LENGTH) {
+        history.pop_front();
+    }
+
+    slot.pending = false;
+}
+
+
+//  ===============================================  Profiler - export  ===============================================
+
+static std::string escape_json(const std::string& s)
+{
+    std::string result;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+bool Profiler::export_chrome_trace(const std::filesystem::path& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Trace " << path << " can't be written." << std::endl;
+        return false;
+    }
+
+    // complete events ("X"), times in microseconds
+    auto write_event = [&](const std::string& name, const char* category, int tid, double start, double end, size_t frame) {
+        file << ",\n    {\"name\": \"" << escape_json(name) << "\", \"cat\": \"" << category << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+             << ", \"ts\": " << start * 1e3 << ", \"dur\": " << (end - start) * 1e3 << ", \"args\": {\"frame\": " << frame << "}}";
+    };
+
+    file << std::fixed;
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    file << "    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"cpu\"}},\n";
+    file << "    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"gpu\"}}";
+
+    for (const ProfilerFrame& frame : history) {
+        write_event("frame", "cpu", 1, frame.cpu_start, frame.cpu_end, frame.index);
+        for (const ProfilerZone& zone : frame.zones) {
+            write_event(zone.name, "cpu", 1, zone.cpu_start, zone.cpu_end, frame.index);
+            if (zone.has_gpu) {
+                write_event(zone.name, "gpu", 2, zone.gpu_start, zone.gpu_end, frame.index);
+            }
+        }
+    }
+
+    file << "\n]}\n";
+
+    return true;
+}
+
+bool Profiler::export_csv(const std::filesystem::path& path, const GpuResourceRegistry& resources) const
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Benchmark " << path << " can't be written." << std::endl;
+        return false;
+    }
+
+    file << "kind,name,count,cpu_ms,gpu_ms";
+    for (const char* name : PipelineStatistics::NAMES) {
+        file << "," << name;
+    }
+    file << ",bytes\n";
+
+    // zones - count is calls per frame, statistics are empty if they weren't collected
+    for (const ProfilerZoneAverage& average : get_averages()) {
+        file << "zone,\"" << average.name << "\"," << average.calls << "," << average.cpu_time << "," << average.gpu_time;
+        for (double value : average.statistics) {
+            file << ",";
+            if (average.statistics_frames > 0) {
+                file << static_cast<GLuint64>(value);
+            }
+        }
+        file << ",\n";
+    }
+
+    // memory - count is number of resources (empty for totals), separators up to bytes skip cpu_ms, gpu_ms and statistics
+    std::string empty_columns(PipelineStatistics::COUNT + 3, ',');
+    for (const GpuResourceGroup& group : resources.get_groups()) {
+        file << "memory,\"" << GpuResourceRegistry::get_type_name(group.type) << " " << group.label << "\"," << group.count << empty_columns << group.size << "\n";
+    }
+    for (GpuResourceType type : { GpuResourceType::BUFFER, GpuResourceType::TEXTURE }) {
+        file << "memory_total," << GpuResourceRegistry::get_type_name(type) << "," << empty_columns << resources.get_total_size(type) << "\n";
+    }
+
+    return true;
+}
+
+
+//  ===============================================  Profiler - ui  ===============================================
+
+void Profiler::render_ui()
+{
+    const ProfilerFrame* frame = get_last_frame();
+    if (frame == nullptr) {
+        ImGui::TextUnformatted("no profiled frames");
+        return;
+    }
+
+    double start = frame->cpu_start;
+    double end = frame->cpu_end;
+    int max_depth = 0;
+    for (const ProfilerZone& zone : frame->zones) {
+        if (zone.has_gpu) {
+            start = std::min(start, zone.gpu_start);
+            end = std::max(end, zone.gpu_end);
+        }
+        max_depth = std::max(max_depth, zone.depth);
+    }
+
+    ImGui::Text("frame %zu: cpu %.3f ms, span %.3f ms", frame->index, frame->cpu_end - frame->cpu_start, end - start);
+
+    // flame view - one row per nesting level, cpu and gpu lanes share the time axis
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    float row_height = ImGui::GetTextLineHeightWithSpacing();
+    double scale = width / std::max(end - start, 1e-6);
+
+    for (int lane = 0; lane < 2; lane++) {
+        bool gpu = lane == 1;
+        ImGui::TextUnformatted(gpu ? "gpu" : "cpu");
+
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        for (const ProfilerZone& zone : frame->zones) {
+            if (gpu && !zone.has_gpu) {
+                continue;
+            }
+
+            double zone_start = gpu ? zone.gpu_start : zone.cpu_start;
+            double zone_end = gpu ? zone.gpu_end : zone.cpu_end;
+
+            ImVec2 min(origin.x + static_cast<float>((zone_start - start) * scale), origin.y + zone.depth * row_height);
+            ImVec2 max(std::max(origin.x + static_cast<float>((zone_end - start) * scale), min.x + 1.0f), min.y + row_height - 1.0f);
+
+            float hue = static_cast<float>(std::hash<std::string>{}(zone.name) % 360) / 360.0f;
+            draw_list->AddRectFilled(min, max, ImColor::HSV(hue, 0.5f, 0.7f));
+            draw_list->PushClipRect(min, max, true);
+            draw_list->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32_WHITE, zone.name.c_str());
+            draw_list->PopClipRect();
+
+            if (ImGui::IsMouseHoveringRect(min, max)) {
+                ImGui::SetTooltip("%s (%s): %.3f ms", zone.name.c_str(), gpu ? "gpu" : "cpu", zone_end - zone_start);
+            }
+        }
+
+        ImGui::Dummy(ImVec2(width, (max_depth + 1) * row_height));
+    }
+
+    // averages over history
+    for (const ProfilerZoneAverage& average : get_averages()) {
+        ImGui::Text("%*s%s: cpu %.3f ms, gpu %.3f ms", 2 * average.depth, "", average.name.c_str(), average.cpu_time, average.gpu_time);
+
+        if (average.statistics_frames > 0) {
+            for (size_t s = 0; s < PipelineStatistics::COUNT; s++) {
+                if (average.statistics[s] > 0.0) {
+                    ImGui::Text("%*s  %s: %.0f", 2 * average.depth, "", PipelineStatistics::NAMES[s], average.statistics[s]);
+                }
+            }
+        }
+    }
+}
+
+
+//  ===============================================  ProfilerScope  ===============================================
+
+ProfilerScope::ProfilerScope(Profiler& profiler, const char* name, bool gpu, bool statistics)
+    : profiler(profiler), zone(profiler.begin_zone(name, gpu, statistics))
+{
+}
+
+ProfilerScope::~ProfilerScope()
+{
+    profiler.end_zone(zone);
+}
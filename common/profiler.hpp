@@ -0,0 +1,165 @@
+#pragma once
+
+#include "program.hpp"
+
+#include "gpu_resources.hpp"
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+
+// counters of ARB_pipeline_statistics_query (core since 4.6)
+struct PipelineStatistics
+{
+    static const size_t COUNT = 11;
+    static const GLenum TARGETS[COUNT];
+    static const char* const NAMES[COUNT];
+
+    GLuint64 values[COUNT];
+};
+
+
+// one measured zone of a frame, times are in ms from profiler start
+struct ProfilerZone
+{
+    std::string name;
+    int depth; // nesting level (0 = top level)
+
+    double cpu_start;
+    double cpu_end;
+
+    bool has_gpu;
+    double gpu_start; // gpu clock mapped onto cpu clock (see ProfilerFrame::gpu_offset)
+    double gpu_end;
+
+    bool has_statistics;
+    PipelineStatistics statistics;
+};
+
+
+// zone of last frame averaged over profiler history (zones with the same name are merged)
+struct ProfilerZoneAverage
+{
+    std::string name;
+    int depth;
+
+    // per frame (sum of all calls), over frames in which zone was recorded
+    double calls;
+    double cpu_time;
+    double gpu_time;
+
+    size_t statistics_frames; // frames with statistics, 0 if none
+    double statistics[PipelineStatistics::COUNT];
+};
+
+
+struct ProfilerFrame
+{
+    size_t index;
+    double cpu_start;
+    double cpu_end;
+
+    // cpu time - gpu time sampled at frame start, aligns both timelines
+    double gpu_offset;
+
+    std::vector<ProfilerZone> zones; // in order of opening
+};
+
+
+// hierarchical cpu + gpu frame profiler
+// gpu zones write two GL_TIMESTAMP queries, each frame uses own query pool from a ring of FRAMES_IN_FLIGHT pools,
+// results are read when the pool is reused, so reading never stalls the pipeline (results lag FRAMES_IN_FLIGHT - 1 frames)
+// every zone is also pushed as debug group (KHR_debug), captures in RenderDoc / Nsight show the same hierarchy
+// zones can also collect pipeline statistics (primitives, shader invocations), statistics queries can't be nested,
+// so zones opened inside a collecting zone don't collect
+// finished frames are kept in history, which can be exported as chrome trace (chrome://tracing, Perfetto) or benchmark csv
+class Profiler
+{
+public:
+    static const size_t FRAMES_IN_FLIGHT = 3;
+    static const size_t MAX_ZONES = 128; // per frame, further zones are ignored
+    static const size_t MAX_STATISTICS_ZONES = 16; // per frame
+    static const size_t HISTORY_LENGTH = 240;
+
+    bool enabled = true;
+    bool collect_statistics = false; // statistics queries aren't free, off by default
+
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void begin_frame();
+    void end_frame();
+
+    // returns zone id for end_zone, -1 when zone is not recorded
+    int begin_zone(const char* name, bool gpu = true, bool statistics = false);
+    void end_zone(int zone);
+
+    // last frame with resolved gpu times, nullptr if there is none yet
+    const ProfilerFrame* get_last_frame() const;
+
+    // zones of last frame (in its order), averaged over history
+    std::vector<ProfilerZoneAverage> get_averages() const;
+
+    bool is_statistics_supported() const;
+
+    // chrome trace event format (json), cpu and gpu are separate threads
+    bool export_chrome_trace(const std::filesystem::path& path) const;
+
+    // averaged zones (times + statistics) and gpu memory of resources, one table:
+    // kind,name,count,cpu_ms,gpu_ms,<statistics>,bytes
+    bool export_csv(const std::filesystem::path& path, const GpuResourceRegistry& resources) const;
+
+    // timeline (flame view) of last frame + table of zones, call inside ImGui window
+    void render_ui();
+
+private:
+    struct FrameSlot
+    {
+        GLuint queries[2 * MAX_ZONES];
+        GLuint statistics_queries[MAX_STATISTICS_ZONES * PipelineStatistics::COUNT];
+        size_t statistics_zone_count = 0;
+        bool pending = false;
+        ProfilerFrame frame;
+    };
+
+    FrameSlot slots[FRAMES_IN_FLIGHT];
+    bool queries_created = false;
+    bool statistics_supported = false;
+
+    size_t frame_index = 0;
+    bool in_frame = false;
+    std::vector<int> open_zones;
+    bool statistics_open = false;
+
+    std::deque<ProfilerFrame> history;
+
+    std::chrono::steady_clock::time_point start_time;
+
+    double get_cpu_time() const;
+    FrameSlot& current_slot();
+    void resolve(FrameSlot& slot);
+};
+
+
+// scoped zone - opens zone in constructor, closes in destructor
+class ProfilerScope
+{
+public:
+    ProfilerScope(Profiler& profiler, const char* name, bool gpu = true, bool statistics = false);
+    ~ProfilerScope();
+
+    ProfilerScope(const ProfilerScope&) = delete;
+    ProfilerScope& operator=(const ProfilerScope&) = delete;
+
+private:
+    Profiler& profiler;
+    int zone;
+};
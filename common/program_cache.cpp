@@ -0,0 +1,466 @@
+#include "program_cache.hpp"
+
+#include "gl_util.hpp"
+
+#include <GLFW/glfw3.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace {
+    typedef void(APIENTRY* MaxShaderCompilerThreadsFunction)(GLuint count);
+
+    // FNV-1a
+    uint64_t hash_append(uint64_t hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool read_file(const std::filesystem::path& path, std::string& content)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        content = stream.str();
+        return true;
+    }
+
+    const char* get_gl_string(GLenum name)
+    {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        return value != nullptr ? value : "";
+    }
+} // namespace
+
+
+
+//  ===============================================  Program  ===============================================
+
+Program::~Program()
+{
+    replace(0);
+}
+
+GLuint Program::get_id() const
+{
+    return id;
+}
+
+bool Program::is_valid() const
+{
+    return id != 0;
+}
+
+void Program::use() const
+{
+    glUseProgram(id);
+}
+
+void Program::uniform(GLint location, bool value) const
+{
+    glProgramUniform1i(id, location, value ? 1 : 0);
+}
+
+void Program::uniform(GLint location, int value) const
+{
+    glProgramUniform1i(id, location, value);
+}
+
+void Program::uniform(GLint location, unsigned int value) const
+{
+    glProgramUniform1ui(id, location, value);
+}
+
+void Program::uniform(GLint location, float value) const
+{
+    glProgramUniform1f(id, location, value);
+}
+
+void Program::uniform(GLint location, const glm::vec2& value) const
+{
+    glProgramUniform2fv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::vec3& value) const
+{
+    glProgramUniform3fv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::vec4& value) const
+{
+    glProgramUniform4fv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::ivec2& value) const
+{
+    glProgramUniform2iv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::ivec3& value) const
+{
+    glProgramUniform3iv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::ivec4& value) const
+{
+    glProgramUniform4iv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::uvec2& value) const
+{
+    glProgramUniform2uiv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::uvec3& value) const
+{
+    glProgramUniform3uiv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::uvec4& value) const
+{
+    glProgramUniform4uiv(id, location, 1, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::mat3& value) const
+{
+    glProgramUniformMatrix3fv(id, location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Program::uniform(GLint location, const glm::mat4& value) const
+{
+    glProgramUniformMatrix4fv(id, location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Program::replace(GLuint program)
+{
+    if (id != 0) {
+        glDeleteProgram(id);
+    }
+    id = program;
+}
+
+//  ===============================================  ProgramCache  ===============================================
+
+ProgramCache::~ProgramCache()
+{
+    for (Pending& entry : pending) {
+        discard(entry);
+    }
+}
+
+void ProgramCache::set_folder(const std::filesystem::path& folder)
+{
+    this->folder = folder;
+}
+
+void ProgramCache::add(Program& program, const std::vector<ProgramStage>& stages)
+{
+    init();
+    open_batch();
+
+    // newer request replaces pending one (repeated reload)
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->target == &program) {
+            discard(*it);
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    Pending entry{ &program, "", 14695981039346656037ull, {}, 0 };
+    entry.hash = hash_append(entry.hash, driver.data(), driver.size());
+
+    std::vector<std::string> sources;
+    for (const ProgramStage& stage : stages) {
+        std::string source;
+        if (!read_file(stage.path, source)) {
+            std::cerr << "shader file not found: " << stage.path.string() << "\n";
+            batch_failed++;
+            return;
+        }
+
+        entry.name += (entry.name.empty() ? "" : " + ") + stage.path.filename().string();
+        entry.hash = hash_append(entry.hash, &stage.type, sizeof(stage.type));
+        entry.hash = hash_append(entry.hash, source.data(), source.size());
+        sources.push_back(std::move(source));
+    }
+
+    // hit
+    if (use_binaries) {
+        GLuint binary_program = load_binary(entry.hash);
+        if (binary_program != 0) {
+            program.replace(binary_program);
+            batch_hits++;
+            return;
+        }
+    }
+
+    // miss - compile + link without querying any status (driver can compile in parallel)
+    entry.program = glCreateProgram();
+    glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    for (size_t i = 0; i < stages.size(); i++) {
+        GLuint shader = glCreateShader(stages[i].type);
+        const char* source = sources[i].c_str();
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        glAttachShader(entry.program, shader);
+        entry.shaders.push_back(shader);
+    }
+    glLinkProgram(entry.program);
+
+    pending.push_back(entry);
+}
+
+void ProgramCache::add(Program& program, const std::filesystem::path& vertex, const std::filesystem::path& fragment)
+{
+    add(program, { { GL_VERTEX_SHADER, vertex }, { GL_FRAGMENT_SHADER, fragment } });
+}
+
+void ProgramCache::add_compute(Program& program, const std::filesystem::path& compute)
+{
+    add(program, { { GL_COMPUTE_SHADER, compute } });
+}
+
+bool ProgramCache::finish(bool wait)
+{
+    for (auto it = pending.begin(); it != pending.end();) {
+        GLint done = GL_TRUE;
+        if (!wait && parallel_supported) {
+            glGetProgramiv(it->program, GL_COMPLETION_STATUS_KHR, &done);
+        }
+
+        if (done == GL_TRUE) {
+            complete(*it);
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (pending.empty()) {
+        close_batch();
+    }
+    return pending.empty();
+}
+
+bool ProgramCache::is_pending() const
+{
+    return !pending.empty();
+}
+
+bool ProgramCache::is_parallel_supported()
+{
+    init();
+    return parallel_supported;
+}
+
+void ProgramCache::clear()
+{
+    if (folder.empty() || !std::filesystem::exists(folder)) {
+        return;
+    }
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(folder, error)) {
+        if (entry.path().extension() == ".bin") {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
+
+void ProgramCache::init()
+{
+    if (initialized) {
+        return;
+    }
+    initialized = true;
+
+    driver = std::string(get_gl_string(GL_VENDOR)) + "|" + get_gl_string(GL_RENDERER) + "|" + get_gl_string(GL_VERSION);
+
+    // loaded through glfw, gl loader of the framework may not include extension functions
+    const char* names[2] = { "glMaxShaderCompilerThreadsKHR", "glMaxShaderCompilerThreadsARB" };
+    const char* extensions[2] = { "GL_KHR_parallel_shader_compile", "GL_ARB_parallel_shader_compile" };
+    for (int i = 0; i < 2 && !parallel_supported; i++) {
+        if (!has_gl_extension(extensions[i])) {
+            continue;
+        }
+        auto max_threads = reinterpret_cast<MaxShaderCompilerThreadsFunction>(glfwGetProcAddress(names[i]));
+        if (max_threads != nullptr) {
+            max_threads(0xFFFFFFFFu); // implementation maximum
+            parallel_supported = true;
+        }
+    }
+
+    if (!folder.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(folder, error);
+    }
+}
+
+void ProgramCache::open_batch()
+{
+    if (batch_open) {
+        return;
+    }
+    batch_open = true;
+    batch_start = std::chrono::steady_clock::now();
+    batch_hits = 0;
+    batch_compiled = 0;
+    batch_failed = 0;
+}
+
+void ProgramCache::close_batch()
+{
+    if (!batch_open) {
+        return;
+    }
+    batch_open = false;
+
+    statistics.hits = batch_hits;
+    statistics.compiled = batch_compiled;
+    statistics.failed = batch_failed;
+    statistics.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batch_start).count();
+
+    std::cout << "programs: " << batch_hits << " cached, " << batch_compiled << " compiled" << (parallel_supported ? " (parallel)" : "") << ", "
+              << batch_failed << " failed, " << statistics.time_ms << " ms\n";
+}
+
+std::filesystem::path ProgramCache::get_binary_path(uint64_t hash) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return folder / name;
+}
+
+GLuint ProgramCache::load_binary(uint64_t hash) const
+{
+    if (folder.empty()) {
+        return 0;
+    }
+
+    std::string content;
+    if (!read_file(get_binary_path(hash), content) || content.size() <= sizeof(GLenum)) {
+        return 0;
+    }
+
+    // format (GLenum) + binary
+    GLenum format;
+    std::memcpy(&format, content.data(), sizeof(GLenum));
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, content.data() + sizeof(GLenum), static_cast<GLsizei>(content.size() - sizeof(GLenum)));
+
+    // driver may reject binary (e.g. after update with the same version string), source is compiled then
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::store_binary(GLuint program, uint64_t hash) const
+{
+    if (folder.empty()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::ofstream file(get_binary_path(hash), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&format), sizeof(GLenum));
+    file.write(binary.data(), length);
+}
+
+void ProgramCache::complete(Pending& entry)
+{
+    bool success = true;
+    for (GLuint shader : entry.shaders) {
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE) {
+            GLint length = 0;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+            std::string log(std::max(length, 1), '\0');
+            glGetShaderInfoLog(shader, length, nullptr, &log[0]);
+            std::cerr << "shader compilation failed (" << entry.name << "):\n" << log << "\n";
+            success = false;
+        }
+    }
+
+    if (success) {
+        GLint status = GL_FALSE;
+        glGetProgramiv(entry.program, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE) {
+            GLint length = 0;
+            glGetProgramiv(entry.program, GL_INFO_LOG_LENGTH, &length);
+            std::string log(std::max(length, 1), '\0');
+            glGetProgramInfoLog(entry.program, length, nullptr, &log[0]);
+            std::cerr << "program linking failed (" << entry.name << "):\n" << log << "\n";
+            success = false;
+        }
+    }
+
+    if (!success) {
+        batch_failed++;
+        discard(entry);
+        return;
+    }
+
+    for (GLuint shader : entry.shaders) {
+        glDetachShader(entry.program, shader);
+        glDeleteShader(shader);
+    }
+    entry.shaders.clear();
+
+    if (use_binaries) {
+        store_binary(entry.program, entry.hash);
+    }
+
+    entry.target->replace(entry.program);
+    entry.program = 0;
+    batch_compiled++;
+}
+
+void ProgramCache::discard(Pending& entry)
+{
+    for (GLuint shader : entry.shaders) {
+        glDeleteShader(shader);
+    }
+    entry.shaders.clear();
+
+    if (entry.program != 0) {
+        glDeleteProgram(entry.program);
+        entry.program = 0;
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "program.hpp"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+
+// gl program built by ProgramCache, same interface as ShaderProgram of the framework (use + uniforms by location)
+// uniforms are set by glProgramUniform*, program doesn't have to be in use
+// the object owns the gl program, the program can be replaced (reload) while the object stays at the same address
+class Program
+{
+public:
+    Program() = default;
+    ~Program();
+
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+
+    GLuint get_id() const;
+    bool is_valid() const;
+
+    void use() const;
+
+    void uniform(GLint location, bool value) const;
+    void uniform(GLint location, int value) const;
+    void uniform(GLint location, unsigned int value) const;
+    void uniform(GLint location, float value) const;
+    void uniform(GLint location, const glm::vec2& value) const;
+    void uniform(GLint location, const glm::vec3& value) const;
+    void uniform(GLint location, const glm::vec4& value) const;
+    void uniform(GLint location, const glm::ivec2& value) const;
+    void uniform(GLint location, const glm::ivec3& value) const;
+    void uniform(GLint location, const glm::ivec4& value) const;
+    void uniform(GLint location, const glm::uvec2& value) const;
+    void uniform(GLint location, const glm::uvec3& value) const;
+    void uniform(GLint location, const glm::uvec4& value) const;
+    void uniform(GLint location, const glm::mat3& value) const;
+    void uniform(GLint location, const glm::mat4& value) const;
+
+private:
+    friend class ProgramCache;
+
+    GLuint id = 0;
+
+    // takes ownership of program, previous one is deleted
+    void replace(GLuint program);
+};
+
+
+struct ProgramStage
+{
+    GLenum type; // GL_VERTEX_SHADER, ...
+    std::filesystem::path path;
+};
+
+
+// builds programs of the projects
+// linked programs are stored as glGetProgramBinary blobs in folder, keyed by hash of driver (vendor, renderer, version)
+// and sources of all stages, so a program is compiled only when its sources or the driver change
+// cache misses are compiled concurrently: all misses of a batch are compiled and linked before any status is queried,
+// with KHR_parallel_shader_compile the driver runs them on its own threads and completion can be polled (finish(false))
+// program is replaced only after successful link, a failed reload keeps the previous program
+class ProgramCache
+{
+public:
+    struct Statistics
+    {
+        size_t hits = 0; // loaded from binary
+        size_t compiled = 0;
+        size_t failed = 0;
+        double time_ms = 0.0; // last batch, from first add to completion
+    };
+
+    bool use_binaries = true;
+
+    Statistics statistics;
+
+
+    ProgramCache() = default;
+    ~ProgramCache();
+
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // binaries are not stored without folder
+    void set_folder(const std::filesystem::path& folder);
+
+    // loads program from binary or starts its compilation, program is replaced when it is ready
+    void add(Program& program, const std::vector<ProgramStage>& stages);
+    void add(Program& program, const std::filesystem::path& vertex, const std::filesystem::path& fragment);
+    void add_compute(Program& program, const std::filesystem::path& compute);
+
+    // completes pending programs, without wait only those the driver finished (reload without freezing)
+    // returns true when nothing is pending
+    bool finish(bool wait = true);
+
+    bool is_pending() const;
+
+    bool is_parallel_supported();
+
+    // removes stored binaries
+    void clear();
+
+private:
+    struct Pending
+    {
+        Program* target;
+        std::string name; // for logs
+        uint64_t hash;
+        std::vector<GLuint> shaders;
+        GLuint program;
+    };
+
+    std::filesystem::path folder;
+
+    bool initialized = false;
+    bool parallel_supported = false;
+    std::string driver; // vendor + renderer + version, part of hash
+
+    std::vector<Pending> pending;
+
+    bool batch_open = false;
+    std::chrono::steady_clock::time_point batch_start;
+    size_t batch_hits = 0;
+    size_t batch_compiled = 0;
+    size_t batch_failed = 0;
+
+    void init();
+    void open_batch();
+    void close_batch();
+
+    std::filesystem::path get_binary_path(uint64_t hash) const;
+    GLuint load_binary(uint64_t hash) const;
+    void store_binary(GLuint program, uint64_t hash) const;
+
+    // checks compile + link status, replaces target on success, releases gl objects
+    void complete(Pending& entry);
+    void discard(Pending& entry);
+};
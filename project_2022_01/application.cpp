@@ -4,6 +4,13 @@
 
 #include "src/math_util.hpp"
 
+#include "../common/gl_util.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
 
 
 Application::Application(int initial_width, int initial_height, std::vector<std::string> arguments) : PV227Application(initial_width, initial_height, arguments)
@@ -11,7 +18,9 @@ Application::Application(int initial_width, int initial_height, std::vector<std:
     hash31_seed_dis = std::uniform_real_distribution<float>(0, 10.0f);
 
     // prepare
+    program_cache.set_folder(lecture_folder_path / "shader_cache");
     compile_shaders();
+    program_cache.finish(); // first frame needs all programs
 
     prepare_cameras();
     prepare_scene();
@@ -19,6 +28,8 @@ Application::Application(int initial_width, int initial_height, std::vector<std:
     prepare_fireworks();
     prepare_hdr();
     prepare_mirror();
+    prepare_layered();
+    prepare_culling();
     
     // reset settings
     reset_global_config();
@@ -29,12 +40,18 @@ Application::Application(int initial_width, int initial_height, std::vector<std:
     spawn_default = false;
     spawn_random = false;
     spawn_random_at = false;
+    spawn_finale = false;
+
+    std::snprintf(firework_show_file, sizeof(firework_show_file), "finale.show");
+    std::snprintf(profiler_trace_file, sizeof(profiler_trace_file), "trace.json");
+    std::snprintf(benchmark_file, sizeof(benchmark_file), "benchmark.csv");
 
     mouse_plane_y = 0.16f;
 
     show_main_menu = true;
     show_fireworks_menu1 = false;
     show_fireworks_menu2 = false;
+    show_profiler = false;
 
     auto_spawn_pause = false;
     auto_spawn_delta = auto_spawn_delay;
@@ -42,6 +59,14 @@ Application::Application(int initial_width, int initial_height, std::vector<std:
     // opengl initialization
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClearDepth(1.0);
+
+    // obj importer against Geometry::from_file: --benchmark-obj [path] (castle3.obj by default)
+    for (size_t i = 1; i < arguments.size(); i++) {
+        if (arguments[i] == "--benchmark-obj") {
+            bool has_path = i + 1 < arguments.size() && arguments[i + 1].rfind("--", 0) != 0;
+            benchmark_obj(has_path ? std::filesystem::path(arguments[i + 1]) : lecture_folder_path / "models/castle3.obj", 5);
+        }
+    }
 }
 
 Application::~Application() {}
@@ -49,22 +74,47 @@ Application::~Application() {}
 
 void Application::compile_shaders()
 {
-    default_unlit_program = ShaderProgram(lecture_shaders_path / "object.vert", lecture_shaders_path / "unlit.frag");
-    default_lit_program = ShaderProgram(lecture_shaders_path / "object.vert", lecture_shaders_path / "lit.frag");
+    // all programs are submitted first, misses compile in parallel, reload (not waiting) keeps old programs until new are linked
+    const std::filesystem::path& shaders = lecture_shaders_path;
 
-    particle_textured_program = ShaderProgram();
-    particle_textured_program.add_vertex_shader(lecture_shaders_path / "particle_textured.vert");
-    particle_textured_program.add_fragment_shader(lecture_shaders_path / "particle_textured.frag");
-    particle_textured_program.add_geometry_shader(lecture_shaders_path / "particle_textured.geom");
-    particle_textured_program.link();
+    program_cache.add(unlit_program, shaders / "object.vert", shaders / "unlit.frag");
+    program_cache.add(lit_program, shaders / "object.vert", shaders / "lit.frag");
 
-    update_firework_program = ShaderProgram();
-    update_firework_program.add_compute_shader(lecture_shaders_path / "fireworks.comp");
-    update_firework_program.link();
+    program_cache.add(particle_textured_program, { { GL_VERTEX_SHADER, shaders / "particle_textured.vert" },
+                                                   { GL_GEOMETRY_SHADER, shaders / "particle_textured.geom" },
+                                                   { GL_FRAGMENT_SHADER, shaders / "particle_textured.frag" } });
 
-    hdr_to_ldr_program = ShaderProgram(lecture_shaders_path / "fullscreen_quad.vert", lecture_shaders_path / "hdr_to_ldr.frag");
+    program_cache.add_compute(update_firework_program, shaders / "fireworks.comp");
 
-    std::cout << "Shaders are reloaded." << std::endl;
+    program_cache.add_compute(sub_burst_emit_program, shaders / "sub_burst_emit.comp");
+    program_cache.add_compute(sub_burst_update_program, shaders / "sub_burst_update.comp");
+    program_cache.add(sub_burst_particle_program, { { GL_VERTEX_SHADER, shaders / "sub_burst_particle.vert" },
+                                                    { GL_GEOMETRY_SHADER, shaders / "particle_textured.geom" },
+                                                    { GL_FRAGMENT_SHADER, shaders / "particle_textured.frag" } });
+
+    program_cache.add(hdr_to_ldr_program, shaders / "fullscreen_quad.vert", shaders / "hdr_to_ldr.frag");
+
+    program_cache.add_compute(cull_program, shaders / "cull.comp");
+    program_cache.add_compute(hiz_program, shaders / "hiz.comp");
+    program_cache.add_compute(meshlet_cull_program, shaders / "meshlet_cull.comp");
+
+    // layered rendering needs gl_Layer and gl_ViewportIndex in vertex shader
+    layered_rendering_supported = has_gl_extension("GL_ARB_shader_viewport_layer_array");
+    if (layered_rendering_supported) {
+        program_cache.add(layered_lit_program, shaders / "object_layered.vert", shaders / "lit.frag");
+
+        program_cache.add(particle_textured_layered_program, { { GL_VERTEX_SHADER, shaders / "particle_textured.vert" },
+                                                               { GL_GEOMETRY_SHADER, shaders / "particle_textured_layered.geom" },
+                                                               { GL_FRAGMENT_SHADER, shaders / "particle_textured.frag" } });
+
+        program_cache.add(sub_burst_particle_layered_program, { { GL_VERTEX_SHADER, shaders / "sub_burst_particle.vert" },
+                                                                { GL_GEOMETRY_SHADER, shaders / "particle_textured_layered.geom" },
+                                                                { GL_FRAGMENT_SHADER, shaders / "particle_textured.frag" } });
+    }
+
+    program_cache.add(trail_program, shaders / "trail.vert", shaders / "trail.frag");
+
+    program_cache.finish(false);
 }
 
 
@@ -82,11 +132,13 @@ void Application::prepare_scene()
         PhongMaterialData(glm::vec3(0.05f, 0.25f, 0.01f), 1.0f, 200.0f, true)
     );
 
+    glm::mat4 castel_base_model = glm::translate(glm::vec3(0.0f, 0.05f, 0.0f)) * glm::scale(glm::vec3(3.8f, 0.1f, 3.8f));
     castel_base = SceneObject(
         cube,
-        ModelUBO(glm::translate(glm::vec3(0.0f, 0.05f, 0.0f)) * glm::scale(glm::vec3(3.8f, 0.1f, 3.8f))),
+        ModelUBO(castel_base_model),
         PhongMaterialData(glm::vec3(0.05f, 0.25f, 0.01f), 1.0f, 200.0f, true)
     );
+    castel_base_aabb = Aabb::from_positions(cube.positions).transform(castel_base_model);
 
     lake_object = SceneObject(
         cube,
@@ -100,12 +152,33 @@ void Application::prepare_scene()
     //     ModelUBO(glm::translate(glm::vec3(0.0f, 1.98f, 0.0f)) * glm::scale(glm::vec3(7.f, 7.f, 7.f))),
     //     PhongMaterialData(glm::vec3(0.25f, 0.22f, 0.2f), 1.0f, 200.0f, true)
     // );
-    Geometry castle = Geometry::from_file(lecture_folder_path / "models/castle2.obj");
-    castle_object = SceneObject(
-        castle,
-        ModelUBO(glm::translate(glm::vec3(0.0f, 1.06f, 0.0f)) * glm::scale(glm::vec3(7.f, 7.f, 7.f))),
-        PhongMaterialData(glm::vec3(0.25f, 0.22f, 0.2f), 1.0f, 200.0f, true)
-    );
+    std::filesystem::path castle_path = lecture_folder_path / "models/castle2.obj";
+    std::vector<MeshLod> lods = load_mesh_lods(castle_path, { 0.5f, 0.25f, 0.1f }, lecture_folder_path / "mesh_cache");
+
+    castle_model = glm::translate(glm::vec3(0.0f, 1.06f, 0.0f)) * glm::scale(glm::vec3(7.f, 7.f, 7.f));
+    castle_lod_errors.assign(CASTLE_LOD_COUNT, 0.0f);
+
+    // all levels share the original (fallback loader) when lods can't be built
+    Geometry castle_original = lods.size() == CASTLE_LOD_COUNT ? make_geometry(lods[0].mesh) : load_obj_geometry(castle_path);
+    for (int i = 0; i < CASTLE_LOD_COUNT; i++) {
+        bool has_lod = i > 0 && lods.size() == CASTLE_LOD_COUNT;
+        castle_lods[i] = SceneObject(
+            has_lod ? make_geometry(lods[i].mesh) : castle_original,
+            ModelUBO(castle_model),
+            PhongMaterialData(glm::vec3(0.25f, 0.22f, 0.2f), 1.0f, 200.0f, true)
+        );
+        castle_lod_errors[i] = has_lod ? lods[i].error : 0.0f;
+        if (lods.size() == CASTLE_LOD_COUNT) {
+            castle_lod_cache[i][0] = lods[i].cache_before;
+            castle_lod_cache[i][1] = lods[i].cache_after;
+        }
+    }
+    castle_object_aabb = Aabb::from_positions(castle_lods[0].get_geometry().positions).transform(castle_model);
+    castle_lod = 0;
+
+    for (int i = 0; i < CASTLE_LOD_COUNT; i++) {
+        castle_meshlets[i] = MeshletMesh(castle_lods[i].get_geometry());
+    }
 
     mouse_box = SceneObject(
         cube,
@@ -131,49 +204,62 @@ void Application::prepare_cameras()
 void Application::prepare_hdr()
 {
     glCreateFramebuffers(1, &hdr_fbo);
+    hdr_fbo_color_texture = 0;
+    hdr_fbo_depth_texture = 0;
+    hdr_fbo_depth_copy_texture = 0;
     on_resize_hdr();
 }
 
 void Application::prepare_mirror()
 {
-    // framebuffer + textures
-    mirror_texture_size = 1024;
-
-    glCreateFramebuffers(1, &mirror_fbo);
-
-    glCreateTextures(GL_TEXTURE_2D, 1, &mirror_fbo_color_texture);
-    glCreateTextures(GL_TEXTURE_2D, 1, &mirror_fbo_depth_texture);
+    // framebuffers + textures (mip levels 2048 - 128)
+    mirror = AdaptiveMirror(2048, 128);
 
-    glTextureStorage2D(mirror_fbo_color_texture, 1, GL_RGBA32F, mirror_texture_size, mirror_texture_size);
-    glTextureStorage2D(mirror_fbo_depth_texture, 1, GL_DEPTH_COMPONENT24, mirror_texture_size, mirror_texture_size);
-
-    TextureUtils::set_texture_2d_parameters(mirror_fbo_color_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
-    TextureUtils::set_texture_2d_parameters(mirror_fbo_depth_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+    // camera
+    mirror_projection = glm::perspective(glm::radians(90.f), 1.0f, 0.1f, 5000.0f);
+    mirror_camera_ubo.set_projection(mirror_projection);
+}
 
-    glNamedFramebufferTexture(mirror_fbo, GL_COLOR_ATTACHMENT0, mirror_fbo_color_texture, 0);
-    glNamedFramebufferTexture(mirror_fbo, GL_DEPTH_ATTACHMENT, mirror_fbo_depth_texture, 0);
-    FBOUtils::check_framebuffer_status(mirror_fbo, "mirror framebuffer");
+void Application::prepare_layered()
+{
+    on_resize_layered();
+}
 
-    // camera
-    glm::mat4 projection = glm::perspective(glm::radians(90.f), 1.0f, 0.1f, 5000.0f);
-    mirror_camera_ubo.set_projection(projection);
+void Application::prepare_culling()
+{
+    // scene objects + fireworks, dynamic bounds for each firework
+    culling = GpuCulling(firework_manager.max_count + 8, firework_manager.max_count);
+    on_resize_culling();
+
+    castle_cull_record = culling.max_record_count;
+    castle_mirror_cull_record = culling.max_record_count;
+    castel_base_cull_record = culling.max_record_count;
+    firework_cull_records.assign(firework_manager.get_slot_count(), culling.max_record_count);
 }
 
 void Application::prepare_fireworks()
 {
-    fireworks_max_count = 5;
     firework_max_particle_count = 4096;
 
-    fireworks.reserve(fireworks_max_count);
+    // slots grow on demand up to hard cap (culling bounds are allocated for hard cap)
+    firework_manager = FireworkManager(8, 512, firework_max_particle_count);
 
-    for (size_t i = 0; i < fireworks_max_count; i++) {
-        fireworks.emplace_back(firework_max_particle_count);
-    }
+    firework_lights = PhongLightsUBOVector(MAX_FIREWORK_LIGHTS, GL_DYNAMIC_STORAGE_BIT, GL_SHADER_STORAGE_BUFFER);
 
-    firework_lights = PhongLightsUBOVector(fireworks_max_count, GL_DYNAMIC_STORAGE_BIT, GL_SHADER_STORAGE_BUFFER);
+    // ready random spawns (enough for a finale), one worker is left for render thread
+    unsigned int thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    spawn_pool.emplace(thread_count, 2048, firework_max_particle_count, firework_randomization);
+
+    // emitters per frame, child particles in ring pool
+    sub_bursts = SubBursts(4096, 1 << 17);
+    sub_bursts_settle_time = 0.0f;
+
+    // history of particle positions, oldest trails are overwritten when pool is exhausted
+    trails = Trails(1 << 16);
 
     particle_texture = TextureUtils::load_texture_2d(lecture_textures_path / "star.png");
     TextureUtils::set_texture_2d_parameters(particle_texture, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    gpu_resources().add_texture(particle_texture, "star.png");
 }
 
 
@@ -188,8 +274,13 @@ void Application::on_resize_cameras()
 
 void Application::on_resize_hdr()
 {
+    gpu_resources().remove_texture(hdr_fbo_color_texture);
+    gpu_resources().remove_texture(hdr_fbo_depth_texture);
+    gpu_resources().remove_texture(hdr_fbo_depth_copy_texture);
+
     glDeleteTextures(1, &hdr_fbo_color_texture);
     glDeleteTextures(1, &hdr_fbo_depth_texture);
+    glDeleteTextures(1, &hdr_fbo_depth_copy_texture);
 
     glCreateTextures(GL_TEXTURE_2D, 1, &hdr_fbo_color_texture);
     glCreateTextures(GL_TEXTURE_2D, 1, &hdr_fbo_depth_texture);
@@ -200,9 +291,33 @@ void Application::on_resize_hdr()
     TextureUtils::set_texture_2d_parameters(hdr_fbo_color_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
     TextureUtils::set_texture_2d_parameters(hdr_fbo_depth_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
 
+    gpu_resources().add_texture(hdr_fbo_color_texture, "hdr color");
+    gpu_resources().add_texture(hdr_fbo_depth_texture, "hdr depth");
+
     glNamedFramebufferTexture(hdr_fbo, GL_COLOR_ATTACHMENT0, hdr_fbo_color_texture, 0);
     glNamedFramebufferTexture(hdr_fbo, GL_DEPTH_ATTACHMENT, hdr_fbo_depth_texture, 0);
     FBOUtils::check_framebuffer_status(hdr_fbo, "hdr framebuffer");
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &hdr_fbo_depth_copy_texture);
+    glTextureStorage2D(hdr_fbo_depth_copy_texture, 1, GL_DEPTH_COMPONENT24, width, height);
+    TextureUtils::set_texture_2d_parameters(hdr_fbo_depth_copy_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    gpu_resources().add_texture(hdr_fbo_depth_copy_texture, "hdr depth copy");
+}
+
+void Application::on_resize_layered()
+{
+    if (!layered_rendering_supported) {
+        return;
+    }
+
+    // layers have to hold both screen and largest mirror texture
+    layered_target.destroy();
+    layered_target.create(glm::max(static_cast<size_t>(width), mirror.max_texture_size), glm::max(static_cast<size_t>(height), mirror.max_texture_size));
+}
+
+void Application::on_resize_culling()
+{
+    culling.resize_hiz(width, height);
 }
 
 
@@ -213,11 +328,32 @@ void Application::reset_global_config()
     time_multiplier = 1.0f;
     elapsed_time_m = 0.0f;
 
+    simulation_step = 4.0f;
+    max_simulation_steps = 64;
+    simulation_accumulator = 0.0f;
+
     gravity = 0.000015f;
 
     use_mirror = true;
     mirror_factor = 0.72f;
     mirror_distortion = 0.25f;
+
+    use_layered_rendering = false;
+
+    use_gpu_culling = false;
+
+    use_meshlets = false;
+    use_meshlet_backface_culling = true;
+
+    castle_lod_max_pixels = 1.0f;
+    castle_mirror_lod = 2;
+
+    use_soft_particles = false;
+    soft_particles_distance = 2.0f;
+
+    use_trails = false;
+
+    use_analytic_motion = true;
 }
 
 void Application::reset_fireworks_config()
@@ -225,6 +361,8 @@ void Application::reset_fireworks_config()
     auto_spawn_delay = 1400.0f;
     auto_spawn_delay_variance = 0.4f;
 
+    finale_count = 200;
+
     FireworkRandomizationParams& fr = firework_randomization;
 
     fr.particle_count_min = 450;
@@ -269,6 +407,9 @@ void Application::reset_fireworks_config()
     fr.explosion_duration_variance = 0.1f;
     fr.flying2_duration_base = 1100.0f;
     fr.flying2_duration_variance = 0.25f;
+
+    fr.crossette_probability = 0.15f;
+    fr.pistil_probability = 0.15f;
 }
 
 void Application::reset_hdr_config()
@@ -287,33 +428,46 @@ void Application::reset_hdr_config()
 
 void Application::update(float delta)
 {
-    float delta_m = delta * time_multiplier;
-    elapsed_time_m += delta_m;
+    // frame = update + render
+    profiler.begin_frame();
+
+    // reloaded programs compiled in background
+    if (program_cache.is_pending()) {
+        program_cache.finish(false);
+    }
+
+    // fixed simulation steps, time over step limit is dropped (simulation slows down instead of taking longer steps)
+    simulation_accumulator += delta * time_multiplier;
+
+    int step_count = static_cast<int>(simulation_accumulator / simulation_step);
+    if (step_count > max_simulation_steps) {
+        step_count = max_simulation_steps;
+        simulation_accumulator = step_count * simulation_step;
+    }
+    simulation_accumulator -= step_count * simulation_step;
+
+    elapsed_time_m += step_count * simulation_step;
 
     PV227Application::update(delta);
-    update_fireworks(delta_m);
+    update_fireworks(step_count);
 }
 
-void Application::update_fireworks(float delta)
+float Application::get_interpolation_offset() const
 {
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-    update_firework_program.use();
+    // rendered between last two steps (one step behind, never extrapolated)
+    return simulation_accumulator - simulation_step;
+}
 
-    update_firework_program.uniform(0, delta);
-    update_firework_program.uniform(2, gravity);
+void Application::update_fireworks(int step_count)
+{
+    ProfilerScope scope(profiler, "update_fireworks");
 
-    for (Firework& firework : fireworks) {
-        firework.update(delta, gravity);
+    float delta = step_count * simulation_step;
 
-        float hash31_seed = hash31_seed_dis(rnd());
-        update_firework_program.uniform(1, hash31_seed);
-        
-        firework.update_gpu(update_firework_program, 256);
+    if (step_count > 0) {
+        simulate_fireworks(step_count);
     }
 
-    glFinish();
-
     bool spawn_random_auto = false;
 
     if (!auto_spawn_pause) {
@@ -325,33 +479,193 @@ void Application::update_fireworks(float delta)
         auto_spawn_delta = auto_spawn_delay * (1.0f + linmap01v(auto_spawn_delay_variance, random01()));
     }
 
+    // random spawns are pregenerated by worker threads
+    spawn_pool->set_randomization(firework_randomization);
+
     if (spawn_random_auto) {
-        try_spawn_firework(FireworkParams::create_random(firework_randomization));
+        firework_manager.spawn(spawn_pool->pop());
     }
     if (spawn_random_at) {
-        try_spawn_firework(FireworkParams::create_random_at(firework_randomization, spawn_random_at_pos));
+        firework_manager.spawn(spawn_pool->pop_at(spawn_random_at_pos));
         spawn_random_at = false;
     }
     if (spawn_random) {
-        try_spawn_firework(FireworkParams::create_random(firework_randomization));
+        firework_manager.spawn(spawn_pool->pop());
         spawn_random = false;
     }
     if (spawn_default) {
-        try_spawn_firework(FireworkParams::create_default(firework_randomization));
+        spawn_firework(FireworkParams::create_default(firework_randomization));
         spawn_default = false;
     }
+    if (spawn_finale) {
+        for (int i = 0; i < finale_count; i++) {
+            firework_manager.spawn(spawn_pool->pop());
+        }
+        spawn_finale = false;
+    }
+
+    // show (events with precomputed params)
+    if (firework_show.has_value() && firework_show->playing) {
+        firework_show->time += delta;
+        while (std::optional<size_t> event = firework_show->next_due_event()) {
+            firework_manager.spawn(firework_show->get_spawn(event.value()));
+        }
+    }
+
+    // activate spawned fireworks (spawns over hard cap wait for free slots)
+    firework_manager.process_spawn_queue();
+}
+
+void Application::simulate_fireworks(int step_count)
+{
+    ProfilerScope scope(profiler, "simulate_fireworks", true, true);
+
+    float delta = step_count * simulation_step;
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // child particles of sub bursts appended last frame
+    sub_bursts.emit(sub_burst_emit_program, elapsed_time_m);
+
+    update_firework_program.use();
+
+    update_firework_program.uniform(2, gravity);
+    sub_bursts.bind_append_queue();
+
+    // trails - one sample per simulation step, all fireworks write the same ring indices in the same step
+    if (use_trails) {
+        trails.advance(step_count, elapsed_time_m);
+        trails.bind();
+
+        update_firework_program.uniform(9, static_cast<unsigned int>(Trails::LENGTH));
+        update_firework_program.uniform(10, static_cast<unsigned int>(trails.capacity));
+        update_firework_program.uniform(11, elapsed_time_m);
+        update_firework_program.uniform(16, simulation_step);
+    }
+
+    // bounds of particle clouds (reduced in compute shader), used for culling
+    if (use_gpu_culling) {
+        culling.reset_bounds();
+        culling.bind_bounds(7, 8);
+    }
+
+    for (size_t slot : firework_manager.get_active_slots()) {
+        Firework& firework = firework_manager.get(slot);
+
+        // trails are allocated on first update with trails enabled (history starts at current positions)
+        bool trail_reset = false;
+        if (!use_trails) {
+            firework.trail_base = -1;
+        } else if (firework.trail_base < 0) {
+            firework.trail_base = trails.allocate(firework.state.particle_count);
+            trail_reset = true;
+        }
+
+        simulate_firework(firework, step_count, use_gpu_culling ? static_cast<int>(slot) : -1, trail_reset);
+    }
+
+    // before collect_inactive, fireworks ending in this frame may still have emitted children
+    if (!firework_manager.get_active_slots().empty()) {
+        sub_bursts_settle_time = elapsed_time_m + 1000.0f; // longest child lifetime (FireworkParams presets)
+    }
+
+    firework_manager.collect_inactive();
+
+    // all children are dead after settle time (nothing is emitted without active fireworks), pool isn't updated nor drawn
+    if (elapsed_time_m < sub_bursts_settle_time) {
+        sub_bursts.update(sub_burst_update_program, delta, elapsed_time_m, gravity);
+        sub_bursts.end_frame();
+    }
+}
+
+void Application::spawn_firework(const FireworkParams& params)
+{
+    firework_manager.spawn({ params, hash31_seed_dis(rnd()), { 0, 0 } });
+}
+
+void Application::simulate_firework(Firework& firework, int step_count, int bounds_slot, bool trail_reset)
+{
+    // steps in the same stage are one dispatch (acceleration is constant), dispatch count doesn't grow with step count
+    int i = 0;
+    for (; i < step_count && firework.active; i++) {
+        bool stage_change = firework.state.get_stage(firework.state.alive_time + simulation_step) != firework.state.stage;
+        if (stage_change && firework.has_pending_gpu_update()) {
+            update_firework_gpu(firework, bounds_slot, trail_reset, step_count - i);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            trail_reset = false;
+        }
+
+        firework.update(simulation_step, gravity);
+    }
+
+    if (firework.has_pending_gpu_update()) {
+        update_firework_gpu(firework, bounds_slot, trail_reset, step_count - i);
+    }
+}
+
+void Application::update_firework_gpu(Firework& firework, int bounds_slot, bool trail_reset, int steps_left)
+{
+    // analytic flying2 - vertex shader evaluates positions, compute pass only runs for sub bursts, trails or culling bounds
+    if (!firework.needs_gpu_update() && firework.trail_base < 0 && bounds_slot < 0) {
+        firework.skip_gpu_update();
+        return;
+    }
+
+    update_firework_program.uniform(1, firework.seed);
+    update_firework_program.uniform(5, bounds_slot);
+    update_firework_program.uniform(7, firework.trail_base);
+    update_firework_program.uniform(12, trail_reset);
+
+    // samples of steps integrated by this update, the last one is at the ring index of its step
+    int pending_steps = static_cast<int>(std::round((firework.state.alive_time - firework.state.gpu_alive_time) / simulation_step));
+    update_firework_program.uniform(8, trails.get_head(steps_left));
+    update_firework_program.uniform(15, static_cast<unsigned int>(std::max(pending_steps, 1)));
+
+    firework.update_gpu(update_firework_program, 256, use_analytic_motion, gravity);
+}
+
+void Application::load_firework_show()
+{
+    if (firework_show.has_value()) {
+        firework_manager.clear();
+        firework_show->destroy();
+    }
+
+    firework_show = FireworkShow::load(lecture_folder_path / "shows" / firework_show_file, firework_randomization, firework_max_particle_count);
 }
 
-bool Application::try_spawn_firework(const FireworkParams& params)
+void Application::seek_firework_show(float time)
 {
-    for (Firework& firework : fireworks) {
-        if (!firework.active) {
-            firework.activate(params);
-            return true;
+    firework_manager.clear();
+    sub_bursts.clear();
+    firework_show->seek(time);
+
+    // fireworks launched before time which are still alive, activated right away (not queued) so each gets its alive time
+    // fireworks which don't get a slot are skipped
+    std::vector<std::pair<size_t, float>> alive_slots; // slot, alive time
+    for (size_t event = firework_show->get_first_alive_event(); event < firework_show->cursor; event++) {
+        const FireworkShowEvent& show_event = firework_show->events[event];
+        float alive_time = time - show_event.time;
+
+        if (alive_time < show_event.params.get_end_time()) {
+            if (std::optional<size_t> slot = firework_manager.spawn_now(firework_show->get_spawn(event))) {
+                alive_slots.emplace_back(*slot, alive_time);
+            }
         }
     }
 
-    return false;
+    // catch up with simulation steps (one dispatch per stage)
+    update_firework_program.use();
+    update_firework_program.uniform(2, gravity);
+    sub_bursts.bind_append_queue();
+
+    for (const std::pair<size_t, float>& alive_slot : alive_slots) {
+        int step_count = std::min(static_cast<int>(std::ceil(alive_slot.second / simulation_step)), MAX_SEEK_STEPS);
+        simulate_firework(firework_manager.get(alive_slot.first), step_count, -1, false);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    firework_manager.collect_inactive();
 }
 
 void Application::update_firework_lights()
@@ -359,10 +673,17 @@ void Application::update_firework_lights()
     std::vector<PhongLightData>& lights = firework_lights.get_data();
     lights.clear();
 
-    for (Firework& firework : fireworks) {
-        if (firework.active) {
-            lights.push_back(firework.generate_light().value());
-        }
+    // lights are not attenuated, keep the brightest ones (luminance of light color)
+    std::vector<std::pair<float, size_t>> brightest;
+    for (size_t slot : firework_manager.get_active_slots()) {
+        float luminance = glm::dot(firework_manager.get(slot).get_light_color(), glm::vec3(0.2126f, 0.7152f, 0.0722f));
+        brightest.emplace_back(luminance, slot);
+    }
+    size_t light_count = std::min(brightest.size(), MAX_FIREWORK_LIGHTS);
+    std::partial_sort(brightest.begin(), brightest.begin() + light_count, brightest.end(), std::greater<std::pair<float, size_t>>());
+
+    for (size_t i = 0; i < light_count; i++) {
+        lights.push_back(firework_manager.get(brightest[i].second).generate_light().value());
     }
 
     firework_lights.update_opengl_data();
@@ -390,11 +711,114 @@ void Application::update_cameras()
 
     glm::mat4 mirror_view_matrix = glm::inverse(glm::mat4(glm::vec4(up, 0.0f), glm::vec4(-right, 0.0f), glm::vec4(front, 0.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f))) * glm::translate(-mirror_eye);
     mirror_camera_ubo.set_view(mirror_view_matrix);
-    
+
+    // adaptive mirror resolution + frustum fitted to visible part of lake
+    glm::vec3 lake_corners[4] = {
+        glm::vec3(-lake_size.x * 0.5f, 0.05f, -lake_size.y * 0.5f),
+        glm::vec3( lake_size.x * 0.5f, 0.05f, -lake_size.y * 0.5f),
+        glm::vec3( lake_size.x * 0.5f, 0.05f,  lake_size.y * 0.5f),
+        glm::vec3(-lake_size.x * 0.5f, 0.05f,  lake_size.y * 0.5f),
+    };
+
+    glm::mat4 normal_view_projection = normal_camera_ubo.get_data()[0].projection * view_matrix;
+    mirror.update(normal_view_projection, glm::vec2(width, height), mirror_projection * mirror_view_matrix, lake_corners);
+
+    mirror_camera_ubo.set_projection(mirror.crop * mirror_projection);
     mirror_camera_ubo.update_opengl_data();
 
     // mirror_clip_distance = glm::length(front);
     mirror_clip_distance = 1.0f;
+
+    // castle lod by screen space error (pixels per world unit at distance 1 from vertical fov)
+    float pixels_per_unit = 0.5f * static_cast<float>(height) * normal_camera_ubo.get_data()[0].projection[1][1];
+    float castle_distance = glm::length(camera.get_eye_position() - glm::vec3(castle_model[3]));
+    float castle_scale = glm::length(glm::vec3(castle_model[0]));
+    castle_lod = static_cast<int>(select_mesh_lod(castle_lod_errors, castle_scale, castle_distance, pixels_per_unit, castle_lod_max_pixels));
+}
+
+bool Application::is_mirror_scene_changed() const
+{
+    // castle and castle base are static, only fireworks (and their lights) and child particles change mirror image
+    return !firework_manager.get_active_slots().empty() || elapsed_time_m < sub_bursts_settle_time;
+}
+
+bool Application::is_layered_rendering() const
+{
+    // layered pass has no trails and no soft particles, two passes are used while they are on
+    return use_layered_rendering && layered_rendering_supported && use_mirror && !use_trails && !use_soft_particles;
+}
+
+void Application::update_culling()
+{
+    ProfilerScope scope(profiler, "update_culling", true, true);
+
+    bool layered = is_layered_rendering();
+    size_t view_count = use_mirror && mirror.visible ? 2 : 1;
+
+    culling.clear();
+
+    // scene objects (static bounds), in layered rendering one instance per view
+    GLuint object_instance_count = layered ? static_cast<GLuint>(view_count) : 1;
+
+    auto add_object = [&](const SceneObject& object, const Aabb& aabb) {
+        GLuint count = object.get_geometry().draw_elements_count > 0 ? object.get_geometry().draw_elements_count : object.get_geometry().draw_arrays_count;
+        return culling.add({ aabb.min, 0.0f, aabb.max, -1 }, { count, object_instance_count, 0, 0, 0 });
+    };
+
+    // layered draw submits one lod for both views
+    castle_cull_record = add_object(castle_lods[castle_lod], castle_object_aabb);
+    castle_mirror_cull_record = layered ? castle_cull_record : add_object(castle_lods[castle_mirror_lod], castle_object_aabb);
+    castel_base_cull_record = add_object(castel_base, castel_base_aabb);
+
+    // fireworks (bounds computed on gpu)
+    // (records are indexed by slot, bounds slot == firework slot)
+    firework_cull_records.assign(firework_manager.get_slot_count(), culling.max_record_count);
+    for (size_t slot : firework_manager.get_active_slots()) {
+        const Firework& firework = firework_manager.get(slot);
+        firework_cull_records[slot] = culling.add({ glm::vec3(0.0f), firework.get_max_particle_size(), glm::vec3(0.0f), static_cast<int>(slot) }, firework.get_draw_command());
+    }
+
+    const CameraData& normal_camera_data = normal_camera_ubo.get_data()[0];
+    const CameraData& mirror_camera_data = mirror_camera_ubo.get_data()[0];
+    glm::mat4 view_projections[2] = {
+        normal_camera_data.projection * normal_camera_data.view,
+        mirror_camera_data.projection * mirror_camera_data.view,
+    };
+
+    culling.cull(cull_program, view_projections, view_count, layered);
+}
+
+void Application::update_meshlet_culling()
+{
+    ProfilerScope scope(profiler, "update_meshlet_culling", true, true);
+
+    bool mirror_visible = use_mirror && mirror.visible;
+
+    const CameraData& normal_camera_data = normal_camera_ubo.get_data()[0];
+    const CameraData& mirror_camera_data = mirror_camera_ubo.get_data()[0];
+    glm::mat4 view_projections[2] = {
+        normal_camera_data.projection * normal_camera_data.view,
+        mirror_camera_data.projection * mirror_camera_data.view,
+    };
+    glm::vec3 eye_positions[2] = {
+        glm::vec3(normal_camera_data.view_inv[3]),
+        glm::vec3(mirror_camera_data.view_inv[3]),
+    };
+
+    // layered - lod of normal view for both views, one output
+    if (is_layered_rendering()) {
+        size_t view_count = mirror_visible ? 2 : 1;
+        castle_meshlets[castle_lod].cull(meshlet_cull_program, culling, castle_model, 0, view_projections, eye_positions, view_count, false,
+                                         use_meshlet_backface_culling);
+        return;
+    }
+
+    castle_meshlets[castle_lod].cull(meshlet_cull_program, culling, castle_model, 0, &view_projections[0], &eye_positions[0], 1, true,
+                                     use_meshlet_backface_culling);
+    if (mirror_visible) {
+        castle_meshlets[castle_mirror_lod].cull(meshlet_cull_program, culling, castle_model, 1, &view_projections[1], &eye_positions[1], 1, false,
+                                                use_meshlet_backface_culling);
+    }
 }
 
 
@@ -402,37 +826,81 @@ void Application::update_cameras()
 
 void Application::render()
 {
-    glBeginQuery(GL_TIME_ELAPSED, render_time_query);
+    // whole render as one zone, its gpu time (resolved frames later, never waited for) gives gpu fps
+    int render_zone = profiler.begin_zone("render");
 
     // compute cameras and firework lights
-    update_cameras();
-    update_firework_lights();
+    {
+        ProfilerScope scope(profiler, "update_cameras");
+        update_cameras();
+        update_firework_lights();
+    }
 
-    // rendering
-    if (use_mirror) {
-        glBindFramebuffer(GL_FRAMEBUFFER, mirror_fbo);
-        render_mirror();
+    if (use_gpu_culling) {
+        update_culling();
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, use_hdr_mapping ? hdr_fbo : 0);
+    if (use_meshlets) {
+        update_meshlet_culling();
+    }
 
-    render_from_normal_camera();
+    // rendering
+    if (is_layered_rendering()) {
+        render_layered();
+
+        // hierarchical z of normal view from layer 0 (view 1 is never occlusion culled)
+        if (use_gpu_culling || use_meshlets) {
+            ProfilerScope scope(profiler, "build_hiz", true, true);
+            const CameraData& camera_data = normal_camera_ubo.get_data()[0];
+            culling.build_hiz(hiz_program, layered_target.depth_views[0], camera_data.projection * camera_data.view);
+        }
 
-    if (use_hdr_mapping) {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        render_hdr_to_ldr();
+        // mirror is rendered into layer 1, not into mirror texture, so it has to be re-rendered once layered rendering is off
+        // (costs nothing while layered rendering is on, mirror texture isn't used)
+        mirror.invalidate();
+    } else {
+        if (use_mirror && mirror.begin_frame(is_mirror_scene_changed())) {
+            glBindFramebuffer(GL_FRAMEBUFFER, mirror.get_fbo());
+            render_mirror();
+        }
+
+        // occlusion culling and soft particles need depth texture of normal camera
+        bool needs_depth = use_gpu_culling || use_meshlets || use_soft_particles;
+        glBindFramebuffer(GL_FRAMEBUFFER, use_hdr_mapping || needs_depth ? hdr_fbo : 0);
+
+        render_from_normal_camera();
+
+        if (use_gpu_culling || use_meshlets) {
+            ProfilerScope scope(profiler, "build_hiz", true, true);
+            const CameraData& camera_data = normal_camera_ubo.get_data()[0];
+            culling.build_hiz(hiz_program, hdr_fbo_depth_texture, camera_data.projection * camera_data.view);
+        }
+
+        if (use_hdr_mapping) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            render_hdr_to_ldr(hdr_fbo_color_texture, glm::vec2(1.0f));
+        } else if (needs_depth) {
+            glBlitNamedFramebuffer(hdr_fbo, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
     }
 
-    // timing
-    glEndQuery(GL_TIME_ELAPSED);
-    glFinish();
-    GLuint64 render_time;
-    glGetQueryObjectui64v(render_time_query, GL_QUERY_RESULT, &render_time);
-    fps_gpu = 1.0f / (static_cast<float>(render_time) * 1e-9f);
+    // timing (without profiler, fps_gpu keeps its last value)
+    profiler.end_zone(render_zone);
+    if (const ProfilerFrame* frame = profiler.get_last_frame()) {
+        for (const ProfilerZone& zone : frame->zones) {
+            if (zone.depth == 0 && zone.has_gpu && zone.name == "render" && zone.gpu_end > zone.gpu_start) {
+                fps_gpu = static_cast<float>(1000.0 / (zone.gpu_end - zone.gpu_start));
+            }
+        }
+    }
+
+    profiler.end_frame();
 }
 
-void Application::render_hdr_to_ldr()
+void Application::render_hdr_to_ldr(GLuint texture, glm::vec2 uv_scale)
 {
+    ProfilerScope scope(profiler, "render_hdr_to_ldr", true, true);
+
     glViewport(0, 0, width, height);
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_BLEND);
@@ -441,8 +909,9 @@ void Application::render_hdr_to_ldr()
 
     hdr_to_ldr_program.uniform(0, exposure);
     hdr_to_ldr_program.uniform(1, gamma);
+    hdr_to_ldr_program.uniform(2, uv_scale);
 
-    glBindTextureUnit(0, hdr_fbo_color_texture);
+    glBindTextureUnit(0, texture);
 
     glBindVertexArray(empty_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
@@ -452,7 +921,9 @@ void Application::render_hdr_to_ldr()
 
 void Application::render_mirror()
 {
-    glViewport(0, 0, mirror_texture_size, mirror_texture_size);
+    ProfilerScope scope(profiler, "render_mirror");
+
+    glViewport(0, 0, mirror.get_texture_size(), mirror.get_texture_size());
     glEnable(GL_DEPTH_TEST);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -463,6 +934,8 @@ void Application::render_mirror()
 
 void Application::render_from_normal_camera()
 {
+    ProfilerScope scope(profiler, "render_from_normal_camera");
+
     glViewport(0, 0, width, height);
     glEnable(GL_DEPTH_TEST);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -472,29 +945,109 @@ void Application::render_from_normal_camera()
     render_scene_with_lights(false);
 }
 
+void Application::render_layered()
+{
+    ProfilerScope scope(profiler, "render_layered");
+
+    // view 0 - normal camera (layer 0, viewport 0), view 1 - mirror camera (layer 1, viewport 1)
+    size_t mirror_size = mirror.get_texture_size();
+    int view_count = mirror.visible ? 2 : 1;
+
+    layered_cameras_ubo.set_view(0, normal_camera_ubo, 0.0f);
+    layered_cameras_ubo.set_view(1, mirror_camera_ubo, mirror_clip_distance);
+    layered_cameras_ubo.update_opengl_data();
+    layered_cameras_ubo.bind_buffer_base(LayeredCamerasUBO::DEFAULT_LAYERED_CAMERAS_BINDING);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, layered_target.fbo);
+    glViewport(0, 0, width, height); // sets all viewports
+    glViewportIndexedf(1, 0.0f, 0.0f, static_cast<float>(mirror_size), static_cast<float>(mirror_size));
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clears all layers
+
+    normal_camera_ubo.bind_buffer_base(CameraUBO::DEFAULT_CAMERA_BINDING);
+
+    phong_lights_bo.bind(PhongLightsUBO::DEFAULT_LIGHTS_BINDING);
+    firework_lights.bind(4);
+
+    // normal view only (non-layered draws end in layer 0)
+    render_object(outer_terrain_object, lit_program);
+    render_mouse_box(unlit_program);
+
+    // lake depth only, mirror texture (layer 1) can't be sampled while the whole array is attached
+    // same program as lake color pass below -> same depth
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    render_object(lake_object, lit_program);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    // both views, submitted once
+    if (use_meshlets) {
+        bind_object(castle_lods[castle_lod], layered_lit_program);
+        layered_lit_program.uniform(6, true);
+        castle_meshlets[castle_lod].draw(0); // instance per view
+    } else {
+        render_object_layered(castle_lods[castle_lod], layered_lit_program, view_count, castle_cull_record);
+    }
+    render_object_layered(castel_base, layered_lit_program, view_count, castel_base_cull_record);
+    render_fireworks_layered(view_count);
+
+    // lake color into layer 0 only
+    // lake is opaque and fireworks are blended additively, so lake can be added after fireworks
+    glBindFramebuffer(GL_FRAMEBUFFER, layered_target.main_fbo);
+    glViewport(0, 0, width, height);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    render_lake(lit_program, true);
+
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+
+    // output
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (use_hdr_mapping) {
+        render_hdr_to_ldr(layered_target.color_views[0], layered_target.get_uv_scale(glm::vec2(width, height)));
+    } else {
+        glBlitNamedFramebuffer(layered_target.main_fbo, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+}
+
 void Application::render_scene_with_lights(bool from_mirror)
 {
     phong_lights_bo.bind(PhongLightsUBO::DEFAULT_LIGHTS_BINDING);
     firework_lights.bind(4);
 
-    render_scene(default_lit_program, from_mirror);
+    render_scene(lit_program, from_mirror);
     if (!from_mirror) {
-        render_mouse_box(default_unlit_program);
+        render_mouse_box(unlit_program);
     }
     render_fireworks(from_mirror);
 }
 
-void Application::render_scene(const ShaderProgram& program, bool from_mirror)
+void Application::render_scene(const Program& program, bool from_mirror)
 {
-    render_object(castle_object, program);
-    render_object(castel_base, program);
+    ProfilerScope scope(profiler, "render_scene", true, true);
+
+    size_t view = from_mirror ? 1 : 0;
+    if (use_meshlets) {
+        int lod = from_mirror ? castle_mirror_lod : castle_lod;
+        bind_object(castle_lods[lod], program);
+        castle_meshlets[lod].draw(view);
+    } else if (from_mirror) {
+        render_object_culled(castle_lods[castle_mirror_lod], program, castle_mirror_cull_record, view);
+    } else {
+        render_object_culled(castle_lods[castle_lod], program, castle_cull_record, view);
+    }
+    render_object_culled(castel_base, program, castel_base_cull_record, view);
     if (!from_mirror) {
         render_object(outer_terrain_object, program);
-        render_lake(program);
+        render_lake(program, false);
     }
 }
 
-void Application::render_object(const SceneObject& object, const ShaderProgram& program)
+void Application::bind_object(const SceneObject& object, const Program& program)
 {
     program.use();
 
@@ -506,13 +1059,59 @@ void Application::render_object(const SceneObject& object, const ShaderProgram&
         glBindTextureUnit(0, object.get_texture());
         program.uniform(1, 0.0f);
         program.uniform(2, false);
+        program.uniform(5, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
     }
+}
+
+void Application::render_object(const SceneObject& object, const Program& program)
+{
+    bind_object(object, program);
 
     object.get_geometry().bind_vao();
     object.get_geometry().draw();
 }
 
-void Application::render_lake(const ShaderProgram& program)
+void Application::render_object_culled(const SceneObject& object, const Program& program, size_t cull_record, size_t view)
+{
+    if (!use_gpu_culling || cull_record >= culling.max_record_count) {
+        render_object(object, program);
+        return;
+    }
+
+    bind_object(object, program);
+
+    object.get_geometry().bind_vao();
+    draw_object_indirect(object, culling.get_command_offset(view, cull_record));
+}
+
+void Application::render_object_layered(const SceneObject& object, const Program& program, int view_count, size_t cull_record)
+{
+    bind_object(object, program);
+    program.uniform(6, true);
+
+    // instance i is rendered from view i
+    object.get_geometry().bind_vao();
+    if (use_gpu_culling && cull_record < culling.max_record_count) {
+        draw_object_indirect(object, culling.get_command_offset(0, cull_record));
+    } else if (object.get_geometry().draw_elements_count > 0) {
+        glDrawElementsInstanced(GL_TRIANGLES, object.get_geometry().draw_elements_count, GL_UNSIGNED_INT, nullptr, view_count);
+    } else {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, object.get_geometry().draw_arrays_count, view_count);
+    }
+}
+
+void Application::draw_object_indirect(const SceneObject& object, GLintptr command_offset)
+{
+    culling.bind_commands();
+
+    if (object.get_geometry().draw_elements_count > 0) {
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(command_offset));
+    } else {
+        glDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<const void*>(command_offset));
+    }
+}
+
+void Application::render_lake(const Program& program, bool layered)
 {
     program.use();
 
@@ -521,11 +1120,20 @@ void Application::render_lake(const ShaderProgram& program)
 
     program.uniform(0, use_mirror);
     if (use_mirror) {
-        glBindTextureUnit(0, mirror_fbo_color_texture);
+        glm::vec4 uv_transform = mirror.uv_transform;
+        if (layered) {
+            // mirror is in the corner of layer 1
+            glBindTextureUnit(0, layered_target.color_views[1]);
+            uv_transform *= glm::vec4(glm::vec2(1.0f), layered_target.get_uv_scale(glm::vec2(mirror.get_texture_size())));
+        } else {
+            mirror.bind_textures(0);
+        }
+
         program.uniform(1, mirror_factor);
         program.uniform(2, true);
         program.uniform(3, mirror_distortion);
-        program.uniform(4, static_cast<float>(elapsed_time_m / 1000.0));
+        program.uniform(4, static_cast<float>((elapsed_time_m + get_interpolation_offset()) / 1000.0));
+        program.uniform(5, uv_transform);
     }
 
     lake_object.get_geometry().bind_vao();
@@ -534,27 +1142,126 @@ void Application::render_lake(const ShaderProgram& program)
 
 void Application::render_fireworks(bool from_mirror)
 {
+    ProfilerScope scope(profiler, "render_fireworks", true, true);
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ONE);
     glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_FALSE);
 
+    glBindTextureUnit(0, particle_texture);
+
+    // soft particles - copy of opaque depth, the attachment of current framebuffer can't be sampled (feedback loop)
+    if (use_soft_particles) {
+        GLuint depth_copy = hdr_fbo_depth_copy_texture;
+        if (from_mirror) {
+            depth_copy = mirror.copy_depth();
+        } else {
+            glCopyImageSubData(hdr_fbo_depth_texture, GL_TEXTURE_2D, 0, 0, 0, 0, hdr_fbo_depth_copy_texture, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+        }
+        glBindTextureUnit(1, depth_copy);
+    }
+
     particle_textured_program.use();
+    set_particle_uniforms(particle_textured_program, from_mirror);
+
+    if (use_gpu_culling) {
+        culling.bind_commands();
+    }
+
+    size_t view = from_mirror ? 1 : 0;
+    for (size_t slot : firework_manager.get_active_slots()) {
+        if (use_gpu_culling && slot < firework_cull_records.size() && firework_cull_records[slot] < culling.max_record_count) {
+            firework_manager.get(slot).render_indirect(particle_textured_program, culling.get_command_offset(view, firework_cull_records[slot]));
+        } else {
+            firework_manager.get(slot).render(particle_textured_program);
+        }
+    }
+
+    // child particles of sub bursts (whole pool is drawn, skipped once all children are dead)
+    if (elapsed_time_m < sub_bursts_settle_time) {
+        sub_burst_particle_program.use();
+        set_particle_uniforms(sub_burst_particle_program, from_mirror);
+        sub_bursts.render(sub_burst_particle_program, elapsed_time_m + get_interpolation_offset());
+    }
+
+    // trails (only those written in the last simulation step are visible)
+    if (use_trails) {
+        trail_program.use();
+        trail_program.uniform(2, from_mirror ? mirror_clip_distance : 0.0f);
+        trails.render(trail_program, trails.write_time);
+    }
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+}
+
+void Application::set_particle_uniforms(const Program& program, bool from_mirror)
+{
+    program.uniform(2, from_mirror ? mirror_clip_distance : 0.0f);
+
+    // soft particles (scene depth is bound to unit 1)
+    program.uniform(4, use_soft_particles);
+    program.uniform(5, soft_particles_distance);
+
+    // interpolation between simulation steps
+    program.uniform(10, get_interpolation_offset());
+    program.uniform(11, gravity);
+}
+
+void Application::render_fireworks_layered(int view_count)
+{
+    ProfilerScope scope(profiler, "render_fireworks_layered", true, true);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+
+    particle_textured_layered_program.use();
 
     glBindTextureUnit(0, particle_texture);
 
-    particle_textured_program.uniform(2, from_mirror ? mirror_clip_distance : 0.0f);
+    // geometry shader emits each particle into all views (clip distances are in layered cameras ubo)
+    particle_textured_layered_program.uniform(3, view_count);
+
+    // soft particles need per-layer depth (not supported in layered pass)
+    particle_textured_layered_program.uniform(4, false);
+
+    particle_textured_layered_program.uniform(10, get_interpolation_offset());
+    particle_textured_layered_program.uniform(11, gravity);
+
+    if (use_gpu_culling) {
+        culling.bind_commands();
+    }
+
+    for (size_t slot : firework_manager.get_active_slots()) {
+        if (use_gpu_culling && slot < firework_cull_records.size() && firework_cull_records[slot] < culling.max_record_count) {
+            firework_manager.get(slot).render_indirect(particle_textured_layered_program, culling.get_command_offset(0, firework_cull_records[slot]));
+        } else {
+            firework_manager.get(slot).render(particle_textured_layered_program);
+        }
+    }
 
-    for (const Firework& firework : fireworks) {
-        firework.render(particle_textured_program);
+    // child particles of sub bursts (skipped once all children are dead)
+    if (elapsed_time_m < sub_bursts_settle_time) {
+        sub_burst_particle_layered_program.use();
+        sub_burst_particle_layered_program.uniform(3, view_count);
+        sub_burst_particle_layered_program.uniform(4, false);
+        sub_burst_particle_layered_program.uniform(10, get_interpolation_offset());
+        sub_burst_particle_layered_program.uniform(11, gravity);
+        sub_bursts.render(sub_burst_particle_layered_program, elapsed_time_m + get_interpolation_offset());
     }
 
+    // no trails and no soft particles, layered rendering is off while they are on (see is_layered_rendering)
+
     glDisable(GL_BLEND);
     glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_TRUE);
 }
 
-void Application::render_mouse_box(const ShaderProgram& program)
+void Application::render_mouse_box(const Program& program)
 {
     std::optional<glm::vec3> mouse_box_pos = get_mouse_box_pos_ws();
     if (!mouse_box_pos.has_value()) {
@@ -618,6 +1325,20 @@ void Application::render_ui()
     }
 
     ImGui::End();
+
+    // profiler
+    ImGui::Begin("profiler", nullptr, ImGuiWindowFlags_NoDecoration);
+    ImGui::SetWindowPos(ImVec2(2.0f * unit + 3.0f * width, 0.5f * unit));
+    ImGui::SetWindowSize(ImVec2(1.5f * width, 0.0f));
+
+    if (!show_profiler) {
+        ImGui::Text("press [p] to show profiler");
+    } else {
+        ImGui::Text("press [p] to hide profiler");
+        render_profiler_menu();
+    }
+
+    ImGui::End();
 }
 
 void Application::render_main_menu()
@@ -651,13 +1372,62 @@ void Application::render_main_menu()
         reset_global_config();
     }
 
-    ImGui::SliderFloat("time multiplier", &time_multiplier, 0.0f, 5.0f, "%.2f");
+    ImGui::SliderFloat("time multiplier", &time_multiplier, 0.0f, 10.0f, "%.2f");
+    ImGui::SliderFloat("simulation step (ms)", &simulation_step, 1.0f, 33.0f, "%.1f");
+    ImGui::SliderInt(" > max steps per frame", &max_simulation_steps, 1, 256);
     ImGui::SliderFloat("gravity", &gravity, 0.0f, 0.0001f, "%.6f");
     
     ImGui::Checkbox("mirror", &use_mirror);
     ImGui::SliderFloat("mirror factor", &mirror_factor, 0.0f, 1.0f, "%.2f");
     ImGui::SliderFloat("waves", &mirror_distortion, 0.0f, 1.0f, "%.2f");
 
+    if (ImGui::Checkbox("adaptive mirror", &mirror.adaptive)) {
+        mirror.invalidate();
+    }
+    ImGui::SliderFloat(" > quality##mirror", &mirror.quality, 0.25f, 2.0f, "%.2f");
+    ImGui::Checkbox("reuse mirror", &mirror.reuse);
+    ImGui::Text("mirror size: %d (rendered %d, reused %d)", static_cast<int>(mirror.get_texture_size()), static_cast<int>(mirror.rendered_count), static_cast<int>(mirror.reused_count));
+
+    if (layered_rendering_supported) {
+        ImGui::Checkbox("single pass mirror (layered)", &use_layered_rendering);
+        if (use_layered_rendering && (use_trails || use_soft_particles)) {
+            ImGui::Text(" > off while trails / soft particles are on");
+        }
+    } else {
+        ImGui::Text("single pass mirror: not supported");
+    }
+
+    ImGui::SliderFloat("castle lod error (px)", &castle_lod_max_pixels, 0.25f, 8.0f, "%.2f");
+    if (ImGui::SliderInt(" > mirror lod", &castle_mirror_lod, 0, CASTLE_LOD_COUNT - 1)) {
+        mirror.invalidate();
+    }
+    ImGui::Text(" > normal view lod %d (error %.4f)", castle_lod, castle_lod_errors[castle_lod]);
+    const VertexCacheStatistics(&castle_cache)[2] = castle_lod_cache[castle_lod];
+    ImGui::Text(" > vertex cache: acmr %.2f -> %.2f, atvr %.2f -> %.2f", castle_cache[0].acmr, castle_cache[1].acmr, castle_cache[0].atvr, castle_cache[1].atvr);
+
+    ImGui::Checkbox("gpu culling", &use_gpu_culling);
+    ImGui::Checkbox(" > frustum##culling", &culling.frustum_culling);
+    ImGui::Checkbox(" > occlusion##culling", &culling.occlusion_culling);
+    if (use_gpu_culling) {
+        ImGui::Text("visible draws: %d / %d (mirror %d)", static_cast<int>(culling.visible_count[0]), static_cast<int>(culling.record_count), static_cast<int>(culling.visible_count[1]));
+    }
+
+    ImGui::Checkbox("castle meshlets", &use_meshlets);
+    ImGui::Checkbox(" > backface cones##meshlets", &use_meshlet_backface_culling);
+    if (use_meshlets) {
+        const MeshletMesh& meshlets = castle_meshlets[castle_lod];
+        ImGui::Text("meshlets: %d, visible triangles %d / %d (mirror %d)", static_cast<int>(meshlets.meshlets.size()), static_cast<int>(meshlets.visible_index_count[0] / 3),
+                    static_cast<int>(meshlets.index_count / 3), static_cast<int>(castle_meshlets[castle_mirror_lod].visible_index_count[1] / 3));
+    }
+
+    ImGui::Checkbox("soft particles", &use_soft_particles);
+    ImGui::SliderFloat(" > distance##soft", &soft_particles_distance, 0.1f, 10.0f, "%.2f");
+
+    ImGui::Checkbox("analytic flying2 motion", &use_analytic_motion);
+
+    ImGui::Checkbox("trails", &use_trails);
+    ImGui::SliderFloat(" > width##trails", &trails.width, 0.005f, 0.5f, "%.3f");
+
     ImGui::Dummy(spacing_size);
     ImGui::Text("  ========  hdr mapping  ========");
     ImGui::Dummy(spacing_size);
@@ -674,21 +1444,36 @@ void Application::render_main_menu()
     ImGui::Text("  ========  fireworks  ========");
     ImGui::Dummy(spacing_size);
 
-    std::string firework_name_format = fireworks_max_count < 10 ? "firework %1d" : "firework %2d";
+    const FireworkSpawnStats& spawn_stats = firework_manager.stats;
+    ImGui::Text("active: %d (peak %d), slots: %d / %d", static_cast<int>(firework_manager.get_active_slots().size()), static_cast<int>(spawn_stats.peak_active_count), static_cast<int>(firework_manager.get_slot_count()), static_cast<int>(firework_manager.max_count));
+    ImGui::Text("queued: %d (peak %d)", static_cast<int>(firework_manager.spawn_queue.size()), static_cast<int>(spawn_stats.peak_queue_length));
+    ImGui::Text("spawned: %d, delayed: %d, dropped: %d", static_cast<int>(spawn_stats.spawned_count), static_cast<int>(spawn_stats.delayed_count), static_cast<int>(spawn_stats.dropped_count));
+    ImGui::Text("spawn pool: %d / %d ready (%d threads), pooled: %d, generated on render thread: %d", static_cast<int>(spawn_pool->get_ready_count()), static_cast<int>(spawn_pool->capacity), static_cast<int>(spawn_pool->get_thread_count()), static_cast<int>(spawn_pool->popped_count), static_cast<int>(spawn_pool->fallback_count));
+    if (ImGui::Button("reset spawn stats")) {
+        firework_manager.reset_stats();
+        spawn_pool->popped_count = 0;
+        spawn_pool->fallback_count = 0;
+    }
+
+    ImGui::Dummy(spacing_size);
+
+    // only first few active fireworks are listed
+    const size_t listed_max_count = 10;
+    const std::vector<size_t>& active_slots = firework_manager.get_active_slots();
 
-    for (int firework_index = 0; firework_index < fireworks_max_count; firework_index++) {
-        const Firework firework = fireworks[firework_index];
+    for (size_t i = 0; i < std::min(active_slots.size(), listed_max_count); i++) {
+        const Firework& firework = firework_manager.get(active_slots[i]);
 
-        ImGui::Text(firework_name_format.c_str(), firework_index + 1);
+        ImGui::Text("firework %3d", static_cast<int>(active_slots[i]) + 1);
         ImGui::SameLine();
 
-        if (firework.active) {
-            ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(glm_to_imgui_v4(glm::vec4(firework.state.color, 1.0f))));
-            ImGui::ProgressBar(firework.state.alive_time / firework.state.end_time);
-            ImGui::PopStyleColor(1);
-        } else {
-            ImGui::ProgressBar(0.0f, ImVec2(-FLT_MIN, 0.0f), "not active");
-        }
+        ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(glm_to_imgui_v4(glm::vec4(firework.state.color, 1.0f))));
+        ImGui::ProgressBar(firework.state.alive_time / firework.state.end_time);
+        ImGui::PopStyleColor(1);
+    }
+
+    if (active_slots.size() > listed_max_count) {
+        ImGui::Text("... and %d more", static_cast<int>(active_slots.size() - listed_max_count));
     }
 
     ImGui::PopItemWidth();
@@ -711,6 +1496,32 @@ void Application::render_fireworks_menu1()
         reset_fireworks_config();
     }
 
+    ImGui::Dummy(spacing_size);
+    ImGui::Text("  ========  show  ========");
+    ImGui::Dummy(spacing_size);
+
+    ImGui::InputText("file##show", firework_show_file, sizeof(firework_show_file));
+    if (ImGui::Button("load show")) {
+        load_firework_show();
+    }
+
+    if (firework_show.has_value()) {
+        ImGui::SameLine();
+        if (ImGui::Button(firework_show->playing ? "pause##show" : "play##show")) {
+            firework_show->playing = !firework_show->playing;
+        }
+
+        // scrubbing
+        float show_time_s = firework_show->time / 1000.0f;
+        if (ImGui::SliderFloat("time##show", &show_time_s, 0.0f, firework_show->duration / 1000.0f, "%.2f s")) {
+            seek_firework_show(show_time_s * 1000.0f);
+        }
+
+        ImGui::Text("events: %d / %d", static_cast<int>(firework_show->cursor), static_cast<int>(firework_show->events.size()));
+    } else {
+        ImGui::Text("no show loaded");
+    }
+
     ImGui::Dummy(spacing_size);
     ImGui::Text("  ========  auto spawn  ========");
     ImGui::Dummy(spacing_size);
@@ -725,6 +1536,19 @@ void Application::render_fireworks_menu1()
     }
     ImGui::SliderFloat(" > variance##delay", &auto_spawn_delay_variance, 0.0f, 1.0f, "%.2f");
 
+    if (ImGui::Button("finale")) {
+        spawn_finale = true;
+    }
+    ImGui::SameLine();
+    ImGui::SliderInt("count##finale", &finale_count, 1, 1000);
+
+    ImGui::Dummy(spacing_size);
+    ImGui::Text("  ========  multi-stage shells  ========");
+    ImGui::Dummy(spacing_size);
+
+    ImGui::SliderFloat("crossette chance", &firework_randomization.crossette_probability, 0.0f, 1.0f, "%.2f");
+    ImGui::SliderFloat("pistil chance", &firework_randomization.pistil_probability, 0.0f, 1.0f - firework_randomization.crossette_probability, "%.2f");
+
     ImGui::Dummy(spacing_size);
     ImGui::Text("  ========  particle count  ========");
     ImGui::Dummy(spacing_size);
@@ -850,6 +1674,59 @@ void Application::render_fireworks_menu2()
     ImGui::PopItemWidth();
 }
 
+void Application::render_profiler_menu()
+{
+    float unit = ImGui::GetFontSize();
+    float width = ImGui::GetWindowWidth();
+    ImVec2 spacing_size(10.0f, unit * 0.2f);
+
+    ImGui::PushItemWidth(width * 0.5f);
+
+    ImGui::Dummy(spacing_size);
+    ImGui::Text("  ========  profiler  ========");
+    ImGui::Dummy(spacing_size);
+
+    ImGui::Checkbox("enabled##profiler", &profiler.enabled);
+
+    if (profiler.is_statistics_supported()) {
+        ImGui::Checkbox("pipeline statistics", &profiler.collect_statistics);
+    } else {
+        ImGui::Text("pipeline statistics not supported");
+    }
+
+    ImGui::InputText("file##trace", profiler_trace_file, sizeof(profiler_trace_file));
+    if (ImGui::Button("export trace")) {
+        profiler.export_chrome_trace(lecture_folder_path / profiler_trace_file);
+    }
+
+    ImGui::InputText("file##benchmark", benchmark_file, sizeof(benchmark_file));
+    if (ImGui::Button("export benchmark csv")) {
+        profiler.export_csv(lecture_folder_path / benchmark_file, gpu_resources());
+    }
+
+    const ProgramCache::Statistics& program_statistics = program_cache.statistics;
+    ImGui::Text("programs: %zu cached, %zu compiled, %zu failed, %.1f ms%s", program_statistics.hits, program_statistics.compiled, program_statistics.failed,
+                program_statistics.time_ms, program_cache.is_parallel_supported() ? " (parallel)" : "");
+    ImGui::Checkbox("program binaries", &program_cache.use_binaries);
+    if (ImGui::Button("clear program binaries")) {
+        program_cache.clear();
+    }
+
+    ImGui::Dummy(spacing_size);
+    ImGui::Text("  ========  last frame  ========");
+    ImGui::Dummy(spacing_size);
+
+    profiler.render_ui();
+
+    ImGui::Dummy(spacing_size);
+    ImGui::Text("  ========  gpu memory  ========");
+    ImGui::Dummy(spacing_size);
+
+    gpu_resources().render_ui();
+
+    ImGui::PopItemWidth();
+}
+
 
 //  ===============================================  input  ===============================================
 
@@ -858,6 +1735,8 @@ void Application::on_resize(int width, int height)
     PV227Application::on_resize(width, height);
     on_resize_cameras();
     on_resize_hdr();
+    on_resize_layered();
+    on_resize_culling();
 }
 
 void Application::on_mouse_button(int button, int action, int mods)
@@ -911,6 +1790,10 @@ void Application::on_key_pressed(int key, int scancode, int action, int mods)
         if (action == GLFW_PRESS) {
             show_fireworks_menu2 = !show_fireworks_menu2;
         }
+    } else if (key == GLFW_KEY_P) {
+        if (action == GLFW_PRESS) {
+            show_profiler = !show_profiler;
+        }
     }
 }
 
@@ -6,9 +6,23 @@
 #include "pv227_application.hpp"
 #include "scene_object.hpp"
 
+#include "src/adaptive_mirror.hpp"
 #include "src/firework.hpp"
+#include "src/firework_manager.hpp"
+#include "src/firework_show.hpp"
+#include "src/firework_spawn_pool.hpp"
+#include "src/gpu_culling.hpp"
+#include "src/layered_views.hpp"
+#include "src/meshlets.hpp"
+#include "src/sub_bursts.hpp"
+#include "src/trails.hpp"
 #include "src/ubo_vector.hpp"
 
+#include "../common/mesh_lod.hpp"
+#include "../common/obj_loader.hpp"
+#include "../common/profiler.hpp"
+#include "../common/program_cache.hpp"
+
 #include <optional>
 #include <random>
 
@@ -20,6 +34,12 @@ protected:
     // gpu seed distribution
     std::uniform_real_distribution<float> hash31_seed_dis;
 
+    // programs (built through program_cache, binaries are stored in lecture_folder_path / "shader_cache")
+    ProgramCache program_cache;
+
+    Program lit_program;
+    Program unlit_program;
+
     // scene objects
     glm::vec2 lake_size;
     glm::vec2 lake_outside_offset;
@@ -27,7 +47,22 @@ protected:
     SceneObject lake_object;
     SceneObject outer_terrain_object;
     SceneObject castel_base;
-    SceneObject castle_object;
+
+    Aabb castel_base_aabb; // world space
+    Aabb castle_object_aabb; // world space (of original, shared by lods)
+
+    // castle lods (0 = original, then 50 / 25 / 10 % of triangles, cached in mesh_cache)
+    // normal camera picks lod by error projected to the screen, mirror (small texture) uses one coarse lod
+    static const int CASTLE_LOD_COUNT = 4;
+
+    SceneObject castle_lods[CASTLE_LOD_COUNT];
+    std::vector<float> castle_lod_errors; // model space
+    VertexCacheStatistics castle_lod_cache[CASTLE_LOD_COUNT][2]; // index order of obj, optimized
+    glm::mat4 castle_model;
+
+    int castle_lod; // of normal camera
+    float castle_lod_max_pixels;
+    int castle_mirror_lod;
 
     PhongLightsUBOVector phong_lights_bo;
 
@@ -43,66 +78,143 @@ protected:
     GLuint hdr_fbo;
     GLuint hdr_fbo_color_texture;
     GLuint hdr_fbo_depth_texture;
+    GLuint hdr_fbo_depth_copy_texture; // sampled by soft particles (attached depth can't be sampled while drawing into hdr_fbo)
+
+    Program hdr_to_ldr_program;
 
-    ShaderProgram hdr_to_ldr_program;
+    // soft particles (main view renders into hdr_fbo, its depth is copied before particles are drawn)
+    bool use_soft_particles;
+    float soft_particles_distance;
+
+    // particle trails (position history on gpu)
+    bool use_trails;
 
     // physics
     float time_multiplier;
-    float elapsed_time_m;
+    float elapsed_time_m; // simulation time (whole steps)
+
+    // fixed step simulation, rendering interpolates between last two steps
+    float simulation_step; // ms (simulation time)
+    int max_simulation_steps; // per frame, bounds simulation cost of slow frames / high time multiplier
+    float simulation_accumulator; // simulation time not simulated yet
 
     float gravity;
 
+    bool use_analytic_motion; // fireworks entering flying2 are evaluated from alive time (no per frame integration)
+
     // mirror (lake reflection)
     bool use_mirror;
     float mirror_factor;
     float mirror_distortion;
 
-    size_t mirror_texture_size;
-
-    GLuint mirror_fbo;
-    GLuint mirror_fbo_color_texture;
-    GLuint mirror_fbo_depth_texture;
+    AdaptiveMirror mirror;
 
+    glm::mat4 mirror_projection;
     CameraUBO mirror_camera_ubo;
     
     float mirror_clip_distance;
 
+    // layered rendering (normal + mirror view rendered in single pass into layers of one framebuffer)
+    bool use_layered_rendering;
+    bool layered_rendering_supported;
+
+    LayeredTarget layered_target;
+    LayeredCamerasUBO layered_cameras_ubo;
+
+    Program layered_lit_program;
+    Program particle_textured_layered_program;
+
+    // gpu culling (frustum + occlusion using hierarchical z from previous frame)
+    bool use_gpu_culling;
+
+    GpuCulling culling;
+
+    Program cull_program;
+    Program hiz_program;
+
+    size_t castle_cull_record;
+    size_t castle_mirror_cull_record; // separate record (other lod) unless layered
+    size_t castel_base_cull_record;
+    std::vector<size_t> firework_cull_records;
+
+    // castle meshlets (per lod), culled per view on gpu into compacted index buffers
+    // frustum and occlusion settings + hierarchical z are shared with gpu culling
+    bool use_meshlets;
+    bool use_meshlet_backface_culling;
+
+    MeshletMesh castle_meshlets[CASTLE_LOD_COUNT];
+
+    Program meshlet_cull_program;
+
     // fireworks
     FireworkRandomizationParams firework_randomization;
 
-    size_t fireworks_max_count;
     size_t firework_max_particle_count;
     
-    std::vector<Firework> fireworks;
+    FireworkManager firework_manager;
+
+    std::optional<FireworkSpawnPool> spawn_pool; // random spawns generated by worker threads
+
+    // brightest active fireworks only (every fragment of lit shaders loops over them)
+    static const size_t MAX_FIREWORK_LIGHTS = 8;
 
     PhongLightsUBOVector firework_lights;
 
-    ShaderProgram update_firework_program;
+    Program update_firework_program;
 
     GLuint particle_texture;
-    ShaderProgram particle_textured_program;
+    Program particle_textured_program;
+
+    // sub bursts (multi-stage shells, emitted and simulated on gpu)
+    SubBursts sub_bursts;
+
+    Program sub_burst_emit_program;
+    Program sub_burst_update_program;
+    Program sub_burst_particle_program;
+    Program sub_burst_particle_layered_program;
+
+    float sub_bursts_settle_time; // child particles may be alive until this time (mirror reuse)
+
+    Trails trails;
+    Program trail_program;
 
     // fireworks spawning (user input)
     bool spawn_default;
     bool spawn_random;
     bool spawn_random_at;
+    bool spawn_finale;
 
     glm::vec3 spawn_random_at_pos;
 
+    int finale_count; // fireworks spawned in one frame
+
     bool auto_spawn_pause;
     float auto_spawn_delay;
     float auto_spawn_delay_variance;
     float auto_spawn_delta;
 
+    // firework show (timeline loaded from lecture_folder_path / "shows")
+    // seeking simulates fireworks in flight by at most MAX_SEEK_STEPS steps each (longer lived ones stay behind)
+    static const int MAX_SEEK_STEPS = 2048;
+
+    std::optional<FireworkShow> firework_show;
+    char firework_show_file[128];
+
     // mouse box
     SceneObject mouse_box;
 
     float mouse_plane_y;
 
+    // profiling (cpu + gpu zones of update and render passes)
+    Profiler profiler;
+    char profiler_trace_file[128]; // exported into lecture_folder_path
+    char benchmark_file[128]; // zone averages, pipeline statistics and gpu memory (csv)
+
     // gui
     bool show_main_menu;
     bool show_fireworks_menu1;
     bool show_fireworks_menu2;
+    bool show_profiler;
 
 public:
     Application(int initial_width, int initial_height, std::vector<std::string> arguments = {});
@@ -118,12 +230,16 @@ public:
 
     void prepare_hdr();
     void prepare_mirror();
+    void prepare_layered();
+    void prepare_culling();
     void prepare_fireworks();
 
     // window resizing
     void on_resize_cameras();
 
     void on_resize_hdr();
+    void on_resize_layered();
+    void on_resize_culling();
 
     // settings reset
     void reset_global_config();
@@ -132,35 +248,59 @@ public:
 
     // update
     void update(float delta) override;
-    void update_fireworks(float delta);
+    void update_fireworks(int step_count);
+    void simulate_fireworks(int step_count);
+    void simulate_firework(Firework& firework, int step_count, int bounds_slot, bool trail_reset);
+
+    void spawn_firework(const FireworkParams& params);
+    // steps_left - simulation steps of this frame after the update (trail samples are written per step)
+    void update_firework_gpu(Firework& firework, int bounds_slot, bool trail_reset, int steps_left);
 
-    bool try_spawn_firework(const FireworkParams& params);
+    void load_firework_show();
+    void seek_firework_show(float time);
 
     void update_firework_lights();
 
     void update_cameras();
 
+    float get_interpolation_offset() const;
+
+    bool is_mirror_scene_changed() const;
+    bool is_layered_rendering() const;
+
+    void update_culling();
+    void update_meshlet_culling();
+
     // render
     void render() override;
 
-    void render_hdr_to_ldr();
+    void render_hdr_to_ldr(GLuint texture, glm::vec2 uv_scale);
 
     void render_mirror();
     void render_from_normal_camera();
+    void render_layered();
 
     void render_scene_with_lights(bool from_mirror);
-    void render_scene(const ShaderProgram& program, bool from_mirror);
-    void render_object(const SceneObject& object, const ShaderProgram& program);
+    void render_scene(const Program& program, bool from_mirror);
+    void bind_object(const SceneObject& object, const Program& program);
+    void render_object(const SceneObject& object, const Program& program);
+    void render_object_culled(const SceneObject& object, const Program& program, size_t cull_record, size_t view);
+
+    void render_object_layered(const SceneObject& object, const Program& program, int view_count, size_t cull_record);
+    void draw_object_indirect(const SceneObject& object, GLintptr command_offset);
 
-    void render_lake(const ShaderProgram& program);
+    void render_lake(const Program& program, bool layered);
     void render_fireworks(bool from_mirror);
-    void render_mouse_box(const ShaderProgram& program);
+    void set_particle_uniforms(const Program& program, bool from_mirror);
+    void render_fireworks_layered(int view_count);
+    void render_mouse_box(const Program& program);
 
     // gui
     void render_ui() override;
     void render_main_menu();
     void render_fireworks_menu1();
     void render_fireworks_menu2();
+    void render_profiler_menu();
 
     // events
     void on_resize(int width, int height) override;
@@ -11,6 +11,7 @@ in VertexData
 
 layout(location = 0) uniform float exposure;
 layout(location = 1) uniform float gamma;
+layout(location = 2) uniform vec2 uv_scale; // input_tex can be larger than the screen (layered rendering)
 
 layout(binding = 0) uniform sampler2D input_tex;
 
@@ -22,7 +23,7 @@ layout(location = 0) out vec4 final_color;
 
 void main()
 {
-	vec3 c = texture(input_tex, in_data.tex_coord).rgb;
+	vec3 c = texture(input_tex, in_data.tex_coord * uv_scale).rgb;
 	vec3 c_exposure = 1.0f - exp2(-c * exposure);
 	vec3 c_gamma = pow(c_exposure, vec3(1.0f / gamma));
 	final_color = vec4(c_gamma, 1.0f);
@@ -7,6 +7,7 @@ in VertexData
     vec3 position_ws;
     vec3 normal_ws;
     vec2 tex_coord;
+    flat int view_index; // used only in layered rendering
 } in_data;
 
 
@@ -21,6 +22,15 @@ layout(std140, binding = 0) uniform CameraBuffer
     vec3 eye_position;
 };
 
+// cameras of all views in layered rendering (see object_layered.vert)
+layout(std140, binding = 5) uniform LayeredCameraBuffer
+{
+    mat4 projection[2];
+    mat4 view[2];
+    vec4 eye_position[2];
+    vec4 clip_distance[2];
+} cameras;
+
 struct PhongLight
 {
     vec4 position;
@@ -53,7 +63,7 @@ layout(std140, binding = 3) uniform PhongMaterialBuffer
 layout(std430, binding = 4) buffer FireworkLights
 {
     uint count;
-    PhongLight data[5];
+    PhongLight data[]; // at most Application::MAX_FIREWORK_LIGHTS
 } firework_lights;
 
 
@@ -64,6 +74,10 @@ layout(location = 3) uniform float texture_distorion_level;
 
 layout(location = 4) uniform float time; // in seconds
 
+layout(location = 5) uniform vec4 uv_transform; // (offset, scale), used for cropped mirror texture
+
+layout(location = 6) uniform bool layered; // eye position is taken from LayeredCameraBuffer
+
 layout(binding = 0) uniform sampler2D material_diffuse_texture;
 
 
@@ -125,7 +139,8 @@ void main()
 {
     // lighting
     vec3 N = normalize(in_data.normal_ws);
-    vec3 V = normalize(eye_position - in_data.position_ws);
+    vec3 eye = layered ? cameras.eye_position[in_data.view_index].xyz : eye_position;
+    vec3 V = normalize(eye - in_data.position_ws);
     
     vec3 amb = vec3(0.0);
     vec3 dif = vec3(0.0);
@@ -161,6 +176,8 @@ void main()
             uv += texture_distorion_level * offset;
         }
 
+        uv = (uv - uv_transform.xy) * uv_transform.zw;
+
         vec4 tex_color = texture(material_diffuse_texture, uv);
 
         mat_ambient = mix(material.ambient, tex_color.rgb, texture_factor);
@@ -34,6 +34,7 @@ out VertexData
     vec3 position_ws;	  // The vertex position in world space.
     vec3 normal_ws;		  // The vertex normal in world space.
     vec2 tex_coord;		  // The vertex texture coordinates.
+    flat int view_index;  // The index of the view (camera), always 0 (see object_layered.vert).
 } out_data;
 
 // ----------------------------------------------------------------------------
@@ -44,6 +45,7 @@ void main()
     out_data.tex_coord = tex_coord;
     out_data.position_ws = vec3(model * position);
     out_data.normal_ws = normalize(model_it * normal);
+    out_data.view_index = 0;
 
     gl_Position = projection * view * model * position;
 }
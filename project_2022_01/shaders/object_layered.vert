@@ -0,0 +1,54 @@
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : require
+
+// ----------------------------------------------------------------------------
+// Input Variables
+// ----------------------------------------------------------------------------
+layout (location = 0) in vec4 position;  // The vertex position.
+layout (location = 1) in vec3 normal;	 // The vertex normal.
+layout (location = 2) in vec2 tex_coord; // The vertex texture coordinates.
+
+// The UBO with cameras of all views (instance i is rendered into layer i and viewport i).
+layout (std140, binding = 5) uniform LayeredCameraBuffer
+{
+    mat4 projection[2];		// The projection matrices.
+    mat4 view[2];			// The view matrices.
+    vec4 eye_position[2];	// The positions of the eyes in world space.
+    vec4 clip_distance[2];	// The clip distance of particles (x).
+} cameras;
+
+// The UBO with the model data.
+layout (std140, binding = 1) uniform ModelData
+{
+    mat4 model;			// The model matrix.
+    mat4 model_inv;		// The inverse of the model matrix.
+    mat3 model_it;		// The inverse of the transpose of the top-left part 3x3 of the model matrix.
+};
+
+// ----------------------------------------------------------------------------
+// Output Variables
+// ----------------------------------------------------------------------------
+out VertexData
+{
+    vec3 position_ws;	  // The vertex position in world space.
+    vec3 normal_ws;		  // The vertex normal in world space.
+    vec2 tex_coord;		  // The vertex texture coordinates.
+    flat int view_index;  // The index of the view (camera) the vertex is rendered from.
+} out_data;
+
+// ----------------------------------------------------------------------------
+// Main Method
+// ----------------------------------------------------------------------------
+void main()
+{
+    int view_index = gl_InstanceID;
+
+    out_data.tex_coord = tex_coord;
+    out_data.position_ws = vec3(model * position);
+    out_data.normal_ws = normalize(model_it * normal);
+    out_data.view_index = view_index;
+
+    gl_Layer = view_index;
+    gl_ViewportIndex = view_index;
+    gl_Position = cameras.projection[view_index] * cameras.view[view_index] * model * position;
+}
\ No newline at end of file
@@ -9,14 +9,26 @@ in VertexData
 
     vec3 position_vs;
 
+    flat float clip_distance; // particles closer than clip distance are discarded (mirror)
     flat int id;
 } in_data;
 
 
-layout(binding = 0) uniform sampler2D particle_texture;
+layout(std140, binding = 0) uniform CameraBuffer
+{
+    mat4 projection;
+    mat4 projection_inv;
+    mat4 view;
+    mat4 view_inv;
+    mat3 view_it;
+    vec3 eye_position;
+};
 
-layout (location = 2) uniform float mirror_clip_distance;
+layout(binding = 0) uniform sampler2D particle_texture;
+layout(binding = 1) uniform sampler2D scene_depth_texture; // copy of opaque scene depth (not attached to current framebuffer)
 
+layout(location = 4) uniform bool soft_particles;
+layout(location = 5) uniform float soft_particles_distance;
 
 layout(location = 0) out vec4 final_color;
 
@@ -24,10 +36,19 @@ layout(location = 0) out vec4 final_color;
 
 void main()
 {
-    if (-in_data.position_vs.z < mirror_clip_distance) {
+    if (-in_data.position_vs.z < in_data.clip_distance) {
         discard;
     }
 
     float texture_intensity = texture(particle_texture, in_data.tex_coord).r;
+
+    // soft particles - fade out near opaque geometry (linear view space distance)
+    // depth is only read by particles (opaque shaders don't change and never write gl_FragDepth, so early-z stays on)
+    if (soft_particles) {
+        float scene_depth = texelFetch(scene_depth_texture, ivec2(gl_FragCoord.xy), 0).r;
+        float scene_depth_vs = projection[3][2] / (scene_depth * 2.0 - 1.0 + projection[2][2]);
+        texture_intensity *= clamp((scene_depth_vs + in_data.position_vs.z) / soft_particles_distance, 0.0, 1.0);
+    }
+
     final_color = vec4(in_data.color.rgb * texture_intensity, texture_intensity);
 }
\ No newline at end of file
@@ -2,10 +2,9 @@
 
 
 
-layout (location = 0) in vec4 position;
-layout (location = 1) in vec4 color;
-layout (location = 2) in vec2 fade_timing;
-layout (location = 3) in vec2 blink_timing;
+layout (location = 0) in vec4 position; // xyz (w = 1)
+layout (location = 1) in vec4 color; // rgba8
+layout (location = 2) in vec3 velocity; // half, only read in analytic flying2
 
 
 layout (std140, binding = 0) uniform CameraBuffer
@@ -18,8 +17,45 @@ layout (std140, binding = 0) uniform CameraBuffer
     vec3 eye_position;
 };
 
+layout (std140, binding = 1) buffer FireworkParams
+{
+    uint particle_count;
+
+    float explosion_force;
+    float explosion_force_variance;
+
+    float particle_size_base;
+    float rocket_size_mult;
+
+    float hue_variance;
+    float saturation_variance;
+
+    float end_time;
+
+    float fade_start;
+    float fade_start_variance;
+    float fade_end_variance;
+    float fade_size_mult;
+
+    float blink_start;
+    float blink_freq;
+    float blink_start_variance;
+    float blink_freq_variance;
+    float blink_size_mult;
+
+    float sub_burst_probability;
+    float sub_burst_time;
+};
+
 layout (location = 0) uniform uint stage;
 layout (location = 1) uniform float alive_time;
+layout (location = 7) uniform float hash31_seed;
+layout (location = 8) uniform float analytic_start; // -1 - position is integrated by fireworks.comp
+layout (location = 9) uniform float analytic_gravity;
+
+// fixed step simulation - particles are rendered between last two simulation steps
+layout (location = 10) uniform float interpolation_offset; // render time - simulation time (<= 0)
+layout (location = 11) uniform float gravity;
 
 
 out VertexData
@@ -35,19 +71,93 @@ out VertexData
 
 
 
+// Noise function by Dave Hoskins.
+vec3 hash31(float p)
+{
+    vec3 p3 = fract(vec3(p) * vec3(.1031, .11369, .13787));
+    p3 += dot(p3, vec3(p3.y + 19.19, p3.z + 19.19, p3.x + 19.19));
+    return fract(vec3((p3.x + p3.y) * p3.z, (p3.x + p3.z) * p3.y, (p3.y + p3.z) * p3.x));
+}
+
+// linmap(0, 1, b0, b1, x)
+float linmap01(float b0, float b1, float x)
+{
+    return (b1 - b0) * x + b0;
+}
+
+// linmap(0, 1, -v, v, x)
+float linmap01v(float v, float x)
+{
+    return v * (2.0f * x - 1.0f);
+}
+
+
+// per particle randomization (not stored per particle) - has to match fireworks.comp
+vec3 get_explosion_acc(uint index)
+{
+    float explosion_force_mult = 1.0f + (hash31(index + hash31_seed + 0.1f).x * 2.0f - 1.0f) * explosion_force_variance;
+    vec3 direction = normalize(hash31(index + hash31_seed) * 2.0f - 1.0f);
+    return direction * explosion_force * explosion_force_mult;
+}
+
+vec2 get_fade_timing(uint index)
+{
+    vec3 r = hash31(index + hash31_seed + 0.3f);
+    float fade_duration = end_time - fade_start;
+    float fade_start_offset = fade_duration * linmap01v(fade_start_variance, r.x);
+    float fade_end_offset = fade_duration * linmap01(-fade_end_variance, 0.0f, r.y);
+    return vec2(fade_start + fade_start_offset, end_time + fade_end_offset);
+}
+
+vec2 get_blink_timing(uint index)
+{
+    vec3 r = hash31(index + hash31_seed + 0.4f);
+    float blink_duration = end_time - blink_start;
+    float blink_start_offset = blink_duration * linmap01v(blink_start_variance, r.x);
+    float blink_freq_offset = blink_freq * linmap01v(blink_freq_variance, r.y);
+    return vec2(blink_start + blink_start_offset, blink_freq + blink_freq_offset);
+}
+
+bool is_sub_burst_spent(uint index, float time)
+{
+    return stage == 2 && time >= sub_burst_time && hash31(index + hash31_seed + 0.5f).x < sub_burst_probability;
+}
+
 void main()
 {
+    uint index = gl_VertexID;
+
+    float time = alive_time + interpolation_offset;
+
     out_data.position_ws = position;
+
+    if (stage == 2 && analytic_start >= 0.0f && alive_time > analytic_start) {
+        // analytic flying2 - position and velocity were stored at analytic_start, particles only fall since then
+        float t = time - analytic_start;
+        out_data.position_ws.xyz += velocity * t + 0.5f * vec3(0.0f, -analytic_gravity, 0.0f) * t * t;
+    } else {
+        // stored state is at simulation time, acceleration is constant within step - exact position between steps
+        float t = interpolation_offset;
+        vec3 a = vec3(0.0f, -gravity, 0.0f) + (stage == 1 ? get_explosion_acc(index) : vec3(0.0f));
+        out_data.position_ws.xyz += velocity * t + 0.5f * a * t * t;
+    }
     
     out_data.color = color;
     
+    vec2 fade_timing = get_fade_timing(index);
     float fade_start = fade_timing.x;
     float fade_end = fade_timing.y;
-    out_data.fade = (stage == 0 || alive_time < fade_start) ? 1.0f : (alive_time > fade_end ? -1.0f : 1.0f - ((alive_time - fade_start) / (fade_end - fade_start)));
+    out_data.fade = (stage == 0 || time < fade_start) ? 1.0f : (time > fade_end ? -1.0f : 1.0f - ((time - fade_start) / (fade_end - fade_start)));
+
+    // burst into sub burst - disappears (fade < 0)
+    if (is_sub_burst_spent(index, time)) {
+        out_data.fade = -1.0f;
+    }
 
+    vec2 blink_timing = get_blink_timing(index);
     float blink_start = blink_timing.x;
     float blink_freq = blink_timing.y;
-    out_data.blink = (stage == 0 || alive_time < blink_start) ? 1.0f : 0.5 * cos(2.0f * 3.14159f * (alive_time - blink_start) / blink_freq) + 0.5f;
+    out_data.blink = (stage == 0 || time < blink_start) ? 1.0f : 0.5 * cos(2.0f * 3.14159f * (time - blink_start) / blink_freq) + 0.5f;
     
     out_data.id = gl_VertexID;
 }
\ No newline at end of file
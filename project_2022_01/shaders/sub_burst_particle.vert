@@ -0,0 +1,49 @@
+#version 450 core
+
+
+
+// child particles of sub bursts, read directly from pool (no vertex attributes)
+struct SubBurstParticle
+{
+    vec4 pos_birth; // (position, birth time)
+    vec4 vel_lifetime; // (velocity, lifetime)
+    vec4 color;
+};
+
+layout (std430, binding = 10) buffer ParticlePool { SubBurstParticle particles[]; };
+
+layout (location = 1) uniform float time; // render time
+
+// fixed step simulation - pool state is at simulation time
+layout (location = 10) uniform float interpolation_offset; // render time - simulation time (<= 0)
+layout (location = 11) uniform float gravity;
+
+
+out VertexData
+{
+    vec4 position_ws;
+    vec4 color;
+
+    float fade;
+    float blink;
+
+    flat int id;
+} out_data;
+
+
+
+void main()
+{
+    SubBurstParticle particle = particles[gl_VertexID];
+
+    float t = interpolation_offset;
+    out_data.position_ws = vec4(particle.pos_birth.xyz + particle.vel_lifetime.xyz * t + 0.5f * vec3(0.0f, -gravity, 0.0f) * t * t, 1.0f);
+    out_data.color = particle.color;
+
+    // fade over whole lifetime, dead (or never used) particles have fade < 0 (zero size)
+    float age = time - particle.pos_birth.w;
+    out_data.fade = (age < 0.0f || age > particle.vel_lifetime.w) ? -1.0f : 1.0f - age / particle.vel_lifetime.w;
+    out_data.blink = 1.0f;
+
+    out_data.id = gl_VertexID;
+}
\ No newline at end of file
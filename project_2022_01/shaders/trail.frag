@@ -0,0 +1,28 @@
+#version 450 core
+
+
+
+in VertexData
+{
+    vec4 color;
+    vec3 position_vs;
+    float side;
+} in_data;
+
+layout(location = 2) uniform float mirror_clip_distance; // trails closer than clip distance are discarded (mirror)
+
+layout(location = 0) out vec4 final_color;
+
+
+
+void main()
+{
+    if (-in_data.position_vs.z < mirror_clip_distance) {
+        discard;
+    }
+
+    // soft edge across ribbon
+    float edge = 1.0f - abs(in_data.side);
+
+    final_color = in_data.color * edge;
+}
\ No newline at end of file
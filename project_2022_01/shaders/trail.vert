@@ -0,0 +1,80 @@
+#version 450 core
+
+
+
+// ribbon through last positions of one particle (instance = trail, two vertices per history sample, no vertex attributes)
+const uint TRAIL_LENGTH = 8; // has to match Trails::LENGTH
+
+layout (std430, binding = 11) buffer TrailHistoryBuffer { vec4 trail_history[]; }; // (position, intensity)
+layout (std430, binding = 12) buffer TrailInfoBuffer { vec4 trail_info[]; }; // (color, time of last write)
+
+layout(std140, binding = 0) uniform CameraBuffer
+{
+    mat4 projection;
+    mat4 projection_inv;
+    mat4 view;
+    mat4 view_inv;
+    mat3 view_it;
+    vec3 eye_position;
+};
+
+layout (location = 0) uniform float time;
+layout (location = 1) uniform uint head; // newest sample
+layout (location = 3) uniform float width;
+
+
+out VertexData
+{
+    vec4 color;
+    vec3 position_vs;
+    float side; // -1 .. 1 across ribbon
+} out_data;
+
+
+
+vec3 get_sample(uint trail, uint k)
+{
+    return trail_history[trail * TRAIL_LENGTH + (head + TRAIL_LENGTH - k) % TRAIL_LENGTH].xyz;
+}
+
+void main()
+{
+    uint trail = gl_InstanceID;
+    uint k = gl_VertexID / 2; // 0 - newest
+    float side = (gl_VertexID % 2 == 0) ? -1.0f : 1.0f;
+
+    vec4 info = trail_info[trail];
+
+    // trail wasn't written in the last simulation step (firework ended, trail reallocated, rocket stage) - degenerate ribbon
+    if (info.w < time) {
+        out_data.color = vec4(0.0f);
+        out_data.position_vs = vec3(0.0f);
+        out_data.side = 0.0f;
+        gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+        return;
+    }
+
+    vec4 history = trail_history[trail * TRAIL_LENGTH + (head + TRAIL_LENGTH - k) % TRAIL_LENGTH];
+    vec3 p = history.xyz;
+
+    // direction from neighbouring samples
+    vec3 newer = get_sample(trail, k == 0 ? 0 : k - 1);
+    vec3 older = get_sample(trail, min(k + 1, TRAIL_LENGTH - 1));
+    vec3 dir = newer - older;
+
+    vec3 to_eye = eye_position - p;
+    vec3 across = cross(dir, to_eye);
+    float across_length = length(across);
+    across = across_length > 1e-8f ? across / across_length : vec3(0.0f);
+
+    // tapers towards the oldest sample, intensity (particle fade) shrinks and darkens it
+    float taper = 1.0f - float(k) / float(TRAIL_LENGTH - 1);
+    float intensity = history.w * taper;
+
+    vec4 position_vs = view * vec4(p + across * side * 0.5f * width * intensity, 1.0f);
+
+    out_data.color = vec4(info.rgb * intensity, intensity);
+    out_data.position_vs = position_vs.xyz;
+    out_data.side = side;
+    gl_Position = projection * position_vs;
+}
\ No newline at end of file
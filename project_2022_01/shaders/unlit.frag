@@ -8,6 +8,7 @@ in VertexData
     vec3 position_ws;	  // The vertex position in world space.
     vec3 normal_ws;		  // The vertex normal in world space.
     vec2 tex_coord;		  // The vertex texture coordinates.
+    flat int view_index;  // The index of the view (camera).
 } in_data;
 
 // The material data.
@@ -0,0 +1,312 @@
+#include "adaptive_mirror.hpp"
+
+#include "utils.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <glm/gtc/matrix_access.hpp>
+
+#include <utility>
+
+
+
+//  ===============================================  clipping  ===============================================
+
+// vertex of mirror polygon in clip space of normal camera and mirror camera
+struct MirrorClipVertex
+{
+    glm::vec4 clip;
+    glm::vec4 mirror_clip;
+};
+
+// Sutherland–Hodgman clipping against plane dot(plane, clip) >= 0
+static std::vector<MirrorClipVertex> clip_polygon(const std::vector<MirrorClipVertex>& polygon, glm::vec4 plane)
+{
+    std::vector<MirrorClipVertex> result;
+
+    for (size_t i = 0; i < polygon.size(); i++) {
+        const MirrorClipVertex& a = polygon[i];
+        const MirrorClipVertex& b = polygon[(i + 1) % polygon.size()];
+
+        float da = glm::dot(plane, a.clip);
+        float db = glm::dot(plane, b.clip);
+
+        if (da >= 0.0f) {
+            result.push_back(a);
+        }
+
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            float t = da / (da - db);
+            result.push_back({ glm::mix(a.clip, b.clip, t), glm::mix(a.mirror_clip, b.mirror_clip, t) });
+        }
+    }
+
+    return result;
+}
+
+static float polygon_area(const std::vector<glm::vec2>& polygon)
+{
+    float area = 0.0f;
+    for (size_t i = 0; i < polygon.size(); i++) {
+        glm::vec2 a = polygon[i];
+        glm::vec2 b = polygon[(i + 1) % polygon.size()];
+        area += a.x * b.y - a.y * b.x;
+    }
+    return glm::abs(area) * 0.5f;
+}
+
+
+//  ===============================================  AdaptiveMirror  ===============================================
+
+AdaptiveMirror::AdaptiveMirror() = default;
+
+AdaptiveMirror::AdaptiveMirror(size_t max_texture_size, size_t min_texture_size) : max_texture_size(max_texture_size), min_texture_size(min_texture_size)
+{
+    level_count = 1;
+    while ((max_texture_size >> level_count) >= min_texture_size) {
+        level_count++;
+    }
+
+    // textures
+    glCreateTextures(GL_TEXTURE_2D, 1, &color_texture);
+    glCreateTextures(GL_TEXTURE_2D, 1, &depth_texture);
+
+    glTextureStorage2D(color_texture, level_count, GL_RGBA16F, max_texture_size, max_texture_size);
+    glTextureStorage2D(depth_texture, level_count, GL_DEPTH_COMPONENT24, max_texture_size, max_texture_size);
+
+    TextureUtils::set_texture_2d_parameters(color_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+    TextureUtils::set_texture_2d_parameters(depth_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+
+    gpu_resources().add_texture(color_texture, "mirror color");
+    gpu_resources().add_texture(depth_texture, "mirror depth");
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &depth_copy_texture);
+    glTextureStorage2D(depth_copy_texture, 1, GL_DEPTH_COMPONENT24, max_texture_size, max_texture_size);
+    TextureUtils::set_texture_2d_parameters(depth_copy_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    gpu_resources().add_texture(depth_copy_texture, "mirror depth copy");
+
+    // views share storage of color_texture (views need names from glGenTextures)
+    color_views.resize(level_count);
+    glGenTextures(level_count, color_views.data());
+    for (size_t level = 0; level < level_count; level++) {
+        glTextureView(color_views[level], GL_TEXTURE_2D, color_texture, GL_RGBA16F, level, 1, 0, 1);
+        TextureUtils::set_texture_2d_parameters(color_views[level], GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+    }
+
+    // framebuffers
+    fbos.resize(level_count);
+    glCreateFramebuffers(level_count, fbos.data());
+
+    for (size_t level = 0; level < level_count; level++) {
+        glNamedFramebufferTexture(fbos[level], GL_COLOR_ATTACHMENT0, color_texture, level);
+        glNamedFramebufferTexture(fbos[level], GL_DEPTH_ATTACHMENT, depth_texture, level);
+        FBOUtils::check_framebuffer_status(fbos[level], "mirror framebuffer");
+    }
+
+    visible = true;
+}
+
+AdaptiveMirror::~AdaptiveMirror()
+{
+    if (color_texture == 0) {
+        return; // default constructed or moved from
+    }
+
+    gpu_resources().remove_texture(color_texture);
+    gpu_resources().remove_texture(depth_texture);
+    gpu_resources().remove_texture(depth_copy_texture);
+
+    glDeleteFramebuffers(static_cast<GLsizei>(fbos.size()), fbos.data());
+    glDeleteTextures(static_cast<GLsizei>(color_views.size()), color_views.data());
+    glDeleteTextures(1, &color_texture);
+    glDeleteTextures(1, &depth_texture);
+    glDeleteTextures(1, &depth_copy_texture);
+}
+
+AdaptiveMirror::AdaptiveMirror(AdaptiveMirror&& other) noexcept : AdaptiveMirror()
+{
+    *this = std::move(other);
+}
+
+AdaptiveMirror& AdaptiveMirror::operator=(AdaptiveMirror&& other) noexcept
+{
+    // gl names are swapped, previous ones are released by destructor of other
+    std::swap(max_texture_size, other.max_texture_size);
+    std::swap(min_texture_size, other.min_texture_size);
+    std::swap(level_count, other.level_count);
+    std::swap(color_texture, other.color_texture);
+    std::swap(depth_texture, other.depth_texture);
+    std::swap(depth_copy_texture, other.depth_copy_texture);
+    std::swap(color_views, other.color_views);
+    std::swap(fbos, other.fbos);
+
+    adaptive = other.adaptive;
+    reuse = other.reuse;
+    quality = other.quality;
+
+    visible = other.visible;
+    level = other.level;
+    crop = other.crop;
+    uv_transform = other.uv_transform;
+    view_projection = other.view_projection;
+    screen_area = other.screen_area;
+
+    valid = other.valid;
+    last_level = other.last_level;
+    last_view_projection = other.last_view_projection;
+
+    rendered_count = other.rendered_count;
+    reused_count = other.reused_count;
+
+    return *this;
+}
+
+void AdaptiveMirror::update(const glm::mat4& camera_view_projection, glm::vec2 viewport_size, const glm::mat4& mirror_view_projection, const glm::vec3 mirror_corners[4])
+{
+    crop = glm::mat4(1.0f);
+    uv_transform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    view_projection = mirror_view_projection;
+
+    // visible part of mirror (clipped by normal camera frustum)
+    std::vector<MirrorClipVertex> polygon;
+    for (int i = 0; i < 4; i++) {
+        glm::vec4 p(mirror_corners[i], 1.0f);
+        polygon.push_back({ camera_view_projection * p, mirror_view_projection * p });
+    }
+
+    const glm::vec4 planes[6] = {
+        glm::vec4( 1.0f,  0.0f,  0.0f, 1.0f),
+        glm::vec4(-1.0f,  0.0f,  0.0f, 1.0f),
+        glm::vec4( 0.0f,  1.0f,  0.0f, 1.0f),
+        glm::vec4( 0.0f, -1.0f,  0.0f, 1.0f),
+        glm::vec4( 0.0f,  0.0f,  1.0f, 1.0f),
+        glm::vec4( 0.0f,  0.0f, -1.0f, 1.0f),
+    };
+
+    for (int i = 0; i < 6 && !polygon.empty(); i++) {
+        polygon = clip_polygon(polygon, planes[i]);
+    }
+
+    visible = polygon.size() >= 3;
+    if (!visible) {
+        screen_area = 0.0f;
+        return;
+    }
+
+    // screen area + visible rectangle in mirror ndc
+    std::vector<glm::vec2> polygon_ndc;
+    std::vector<glm::vec2> polygon_mirror_ndc;
+
+    glm::vec2 rect_min(1.0f);
+    glm::vec2 rect_max(-1.0f);
+
+    bool mirror_behind = false;
+
+    for (const MirrorClipVertex& v : polygon) {
+        polygon_ndc.push_back(glm::vec2(v.clip) / v.clip.w);
+
+        if (v.mirror_clip.w <= 0.00001f) {
+            mirror_behind = true;
+            continue;
+        }
+
+        glm::vec2 mirror_ndc = glm::vec2(v.mirror_clip) / v.mirror_clip.w;
+        polygon_mirror_ndc.push_back(mirror_ndc);
+        rect_min = glm::min(rect_min, mirror_ndc);
+        rect_max = glm::max(rect_max, mirror_ndc);
+    }
+
+    screen_area = polygon_area(polygon_ndc) * viewport_size.x * viewport_size.y * 0.25f;
+
+    if (!adaptive) {
+        level = 0;
+        return;
+    }
+
+    if (mirror_behind || polygon_mirror_ndc.size() < 3) { // degenerate mirror view, use full frustum
+        rect_min = glm::vec2(-1.0f);
+        rect_max = glm::vec2(1.0f);
+    }
+
+    // add margin for texture filtering and waves distortion
+    rect_min = glm::clamp(rect_min - 0.02f, -1.0f, 1.0f);
+    rect_max = glm::clamp(rect_max + 0.02f, -1.0f, 1.0f);
+
+    glm::vec2 rect_size = glm::max(rect_max - rect_min, glm::vec2(0.001f));
+
+    // texture size
+    float fill = mirror_behind ? 1.0f : polygon_area(polygon_mirror_ndc) / (rect_size.x * rect_size.y);
+    float texture_size = glm::sqrt(screen_area / glm::max(fill, 0.05f)) * quality;
+
+    level = 0;
+    while (level + 1 < level_count && static_cast<float>(max_texture_size >> (level + 1)) >= texture_size) {
+        level++;
+    }
+
+    // crop
+    glm::vec2 scale = 2.0f / rect_size;
+    glm::vec2 offset = -(rect_min + rect_max) / rect_size;
+
+    crop[0][0] = scale.x;
+    crop[1][1] = scale.y;
+    crop[3][0] = offset.x;
+    crop[3][1] = offset.y;
+
+    uv_transform = glm::vec4(rect_min * 0.5f + 0.5f, 2.0f / rect_size);
+
+    view_projection = crop * mirror_view_projection;
+}
+
+bool AdaptiveMirror::begin_frame(bool scene_changed)
+{
+    if (!visible) {
+        return false;
+    }
+
+    // crop is part of view_projection, so it's enough to compare level + view projection
+    bool same_view = true;
+    for (int i = 0; i < 4; i++) {
+        if (glm::any(glm::greaterThan(glm::abs(glm::column(view_projection, i) - glm::column(last_view_projection, i)), glm::vec4(0.00001f)))) {
+            same_view = false;
+        }
+    }
+
+    if (reuse && valid && !scene_changed && same_view && level == last_level) {
+        reused_count++;
+        return false;
+    }
+
+    valid = true;
+    last_level = level;
+    last_view_projection = view_projection;
+
+    rendered_count++;
+    return true;
+}
+
+void AdaptiveMirror::invalidate()
+{
+    valid = false;
+}
+
+size_t AdaptiveMirror::get_texture_size() const
+{
+    return max_texture_size >> level;
+}
+
+GLuint AdaptiveMirror::get_fbo() const
+{
+    return fbos[level];
+}
+
+void AdaptiveMirror::bind_textures(GLuint color_unit) const
+{
+    glBindTextureUnit(color_unit, color_views[level]);
+}
+
+GLuint AdaptiveMirror::copy_depth() const
+{
+    GLsizei size = static_cast<GLsizei>(get_texture_size());
+    glCopyImageSubData(depth_texture, GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, 0, depth_copy_texture, GL_TEXTURE_2D, 0, 0, 0, 0, size, size, 1);
+    return depth_copy_texture;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "program.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+
+// planar reflection target with adaptive resolution
+// color and depth textures are allocated once with full mip chain (from max_texture_size down to min_texture_size)
+// each frame the reflection is rendered into the mip level matching the screen area of the visible part of the mirror
+// mirror frustum is cropped to the visible part of the mirror, texture coordinates of the mirror have to be transformed using uv_transform
+// owns its textures and framebuffers (move only)
+struct AdaptiveMirror
+{
+    size_t max_texture_size = 0;
+    size_t min_texture_size = 0;
+    size_t level_count = 0;
+
+    GLuint color_texture = 0;
+    GLuint depth_texture = 0;
+    GLuint depth_copy_texture = 0; // single level, current level of depth_texture is copied here for sampling (soft particles)
+
+    std::vector<GLuint> color_views; // one single level view of color_texture per mip level (sampled by the lake)
+    std::vector<GLuint> fbos; // one framebuffer per mip level
+
+    // settings
+    bool adaptive = true; // false - always use max_texture_size and full mirror frustum
+    bool reuse = true; // skip rendering when mirror view and scene haven't changed
+    float quality = 1.0f; // mirror texels per screen pixel (along one axis)
+
+    // current frame
+    bool visible = false;
+    size_t level = 0;
+
+    glm::mat4 crop = glm::mat4(1.0f); // applied after mirror projection
+    glm::vec4 uv_transform = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); // (offset, scale), mirror uv = (uv - offset) * scale
+    glm::mat4 view_projection = glm::mat4(1.0f); // crop * mirror view projection
+
+    float screen_area = 0.0f; // visible mirror area in pixels
+
+    // reuse
+    bool valid = false;
+    size_t last_level = 0;
+    glm::mat4 last_view_projection = glm::mat4(1.0f);
+
+    // stats
+    size_t rendered_count = 0;
+    size_t reused_count = 0;
+
+
+    AdaptiveMirror();
+    AdaptiveMirror(size_t max_texture_size, size_t min_texture_size);
+    ~AdaptiveMirror();
+
+    AdaptiveMirror(const AdaptiveMirror&) = delete;
+    AdaptiveMirror& operator=(const AdaptiveMirror&) = delete;
+    AdaptiveMirror(AdaptiveMirror&& other) noexcept;
+    AdaptiveMirror& operator=(AdaptiveMirror&& other) noexcept;
+
+    // mirror_corners - corners of mirror rectangle in world space (in polygon order)
+    // mirror uv has to match ndc of mirror camera (uv = ndc * 0.5 + 0.5)
+    void update(const glm::mat4& camera_view_projection, glm::vec2 viewport_size, const glm::mat4& mirror_view_projection, const glm::vec3 mirror_corners[4]);
+
+    // returns true if reflection has to be rendered this frame (false - texture from previous frame can be reused)
+    bool begin_frame(bool scene_changed);
+    void invalidate();
+
+    size_t get_texture_size() const;
+    GLuint get_fbo() const;
+
+    // color view of current level (texture parameters are not changed per bind)
+    void bind_textures(GLuint color_unit) const;
+
+    // copies depth of current level into depth_copy_texture (level 0), which isn't attached to any framebuffer
+    GLuint copy_depth() const;
+};
@@ -4,8 +4,12 @@
 
 #include "ubo_impl.hpp"
 
+#include "../../common/gpu_resources.hpp"
+
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <algorithm>
 #include <random>
 
 
@@ -20,7 +24,8 @@ FireworkParams::FireworkParams(unsigned int particle_count, glm::vec3 pos, glm::
     , color(color), hue_variance(hue_variance), saturation_variance(saturation_variance)
     , flying1_duration(flying1_duration), explosion_duration(explosion_duration), flying2_duration(flying2_duration)
     , fade_delay(fade_delay), fade_start_variance(fade_start_variance), fade_end_variance(fade_end_variance), fade_size_mult(fade_size_mult)
-    , blink_delay(blink_delay), blink_freq(blink_freq), blink_start_variance(blink_start_variance), blink_freq_variance(blink_freq_variance), blink_size_mult(blink_size_mult) {}
+    , blink_delay(blink_delay), blink_freq(blink_freq), blink_start_variance(blink_start_variance), blink_freq_variance(blink_freq_variance), blink_size_mult(blink_size_mult)
+    , sub_burst_probability(0.0f), sub_burst_delay(0.0f), sub_burst_particle_count(0), sub_burst_force(0.0f), sub_burst_lifetime(0.0f), sub_burst_hue_shift(0.0f) {}
 
 void FireworkParams::set_particle_count(unsigned int particle_count_)
 {
@@ -72,6 +77,26 @@ void FireworkParams::set_blinking(float blink_delay_, float blink_freq_, float b
     blink_size_mult = blink_size_mult_;
 }
 
+void FireworkParams::set_sub_bursts(float sub_burst_probability_, float sub_burst_delay_, unsigned int sub_burst_particle_count_, float sub_burst_force_, float sub_burst_lifetime_, float sub_burst_hue_shift_)
+{
+    sub_burst_probability = sub_burst_probability_;
+    sub_burst_delay = sub_burst_delay_;
+    sub_burst_particle_count = sub_burst_particle_count_;
+    sub_burst_force = sub_burst_force_;
+    sub_burst_lifetime = sub_burst_lifetime_;
+    sub_burst_hue_shift = sub_burst_hue_shift_;
+}
+
+void FireworkParams::set_crossette()
+{
+    set_sub_bursts(0.04f, 0.35f, 24, 0.0025f, 800.0f, 0.0f);
+}
+
+void FireworkParams::set_pistil()
+{
+    set_sub_bursts(0.1f, 0.0f, 32, 0.0015f, 900.0f, 0.5f);
+}
+
 float FireworkParams::get_explosion_time() const
 {
     return flying1_duration;
@@ -97,6 +122,11 @@ float FireworkParams::get_blink_start() const
     return get_flying2_time() + blink_delay * flying2_duration;
 }
 
+float FireworkParams::get_sub_burst_time() const
+{
+    return get_flying2_time() + sub_burst_delay * flying2_duration;
+}
+
 
 //  ===============================================  FireworkParams - randomized creation  ===============================================
 
@@ -106,6 +136,7 @@ FireworkParams FireworkParams::create_default(const FireworkRandomizationParams&
     // params.set_color(glm::vec3(0.75f), 0.33333f);
     params.set_fading(0.3f, 0.25f, 0.3f, 0.5f);
     params.set_blinking(0.6f, 100.f, 0.5f, 0.8f, 0.45f);
+    params.set_sub_bursts(0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f);
 
     params.set_particle_count((fr.particle_count_min + fr.particle_count_max) / 2);
 
@@ -125,18 +156,28 @@ FireworkParams FireworkParams::create_default(const FireworkRandomizationParams&
 }
 
 FireworkParams FireworkParams::create_random(const FireworkRandomizationParams& fr)
+{
+    return create_random(fr, rnd());
+}
+
+FireworkParams FireworkParams::create_random_at(const FireworkRandomizationParams& fr, glm::vec3 pos)
+{
+    return create_random_at(fr, pos, rnd());
+}
+
+FireworkParams FireworkParams::create_random(const FireworkRandomizationParams& fr, std::mt19937& generator)
 {
     // physics - position
-    float x = linmap01(fr.start_pos_min.x, fr.start_pos_max.x, random01());
-    float y = linmap01(fr.start_pos_min.y, fr.start_pos_max.y, random01());
-    float z = linmap01(fr.start_pos_min.z, fr.start_pos_max.z, random01());
+    float x = linmap01(fr.start_pos_min.x, fr.start_pos_max.x, random01(generator));
+    float y = linmap01(fr.start_pos_min.y, fr.start_pos_max.y, random01(generator));
+    float z = linmap01(fr.start_pos_min.z, fr.start_pos_max.z, random01(generator));
 
     glm::vec3 pos(x, y, z);
 
-    return create_random_at(fr, pos);
+    return create_random_at(fr, pos, generator);
 }
 
-FireworkParams FireworkParams::create_random_at(const FireworkRandomizationParams& fr, glm::vec3 pos)
+FireworkParams FireworkParams::create_random_at(const FireworkRandomizationParams& fr, glm::vec3 pos, std::mt19937& generator)
 {
     FireworkParams params;
 
@@ -145,7 +186,7 @@ FireworkParams FireworkParams::create_random_at(const FireworkRandomizationParam
     params.set_blinking(0.6f, 100.f, 0.5f, 0.8f, 0.45f);
 
     // particle count
-    size_t particle_count = std::uniform_int_distribution(fr.particle_count_min, fr.particle_count_max)(rnd());
+    size_t particle_count = std::uniform_int_distribution(fr.particle_count_min, fr.particle_count_max)(generator);
     params.set_particle_count(particle_count);
 
     // physics - velocity
@@ -157,48 +198,58 @@ FireworkParams FireworkParams::create_random_at(const FireworkRandomizationParam
     b = glm::normalize(b);
 
     float max_radius = glm::length(up) * glm::sin(fr.max_angle);
-    float x_rnd = random01();
+    float x_rnd = random01(generator);
     x_rnd = glm::pow(x_rnd, 2.0f);
     float radius = glm::sqrt(x_rnd) * max_radius;
-    float angle = linmap01(0.0f, 2.0f * glm::pi<float>(), random01());
+    float angle = linmap01(0.0f, 2.0f * glm::pi<float>(), random01(generator));
     glm::vec2 dir(glm::cos(angle) * radius, glm::sin(angle) * radius);
 
     float vel_size_variance = fr.vel_size_variance;
-    float vel_size = fr.vel_size_base * (1.0f + linmap01v(vel_size_variance, random01()));
+    float vel_size = fr.vel_size_base * (1.0f + linmap01v(vel_size_variance, random01(generator)));
     glm::vec3 vel = glm::normalize(up + a * dir.x + b * dir.y) * vel_size;
 
     // physics - explosion force
-    float explosion_force = fr.explosion_force_base * (1.0f + linmap01v(fr.explosion_force_variance, random01()));
-    float explosion_force_variance = fr.explosion_force_variance_base * (1.0f + linmap01v(fr.explosion_force_variance_variance, random01()));
+    float explosion_force = fr.explosion_force_base * (1.0f + linmap01v(fr.explosion_force_variance, random01(generator)));
+    float explosion_force_variance = fr.explosion_force_variance_base * (1.0f + linmap01v(fr.explosion_force_variance_variance, random01(generator)));
 
     params.set_physics(pos, vel, explosion_force, explosion_force_variance);
 
     // sizing
-    float particle_size_base = fr.particle_size_base_base * (1.0f + linmap01v(fr.particle_size_base_variance, random01()));
+    float particle_size_base = fr.particle_size_base_base * (1.0f + linmap01v(fr.particle_size_base_variance, random01(generator)));
 
     params.set_sizing(particle_size_base, fr.rocket_size_mult);
 
     // color
-    float hue = glm::mod(fr.hue_base + linmap01v(fr.hue_range * 0.5, random01()), 1.0f);
+    float hue = glm::mod(fr.hue_base + linmap01v(fr.hue_range * 0.5, random01(generator)), 1.0f);
 
     float sat_min = glm::max(fr.saturation_base - fr.saturation_range * 0.5f, 0.0f);
     float sat_max = glm::min(fr.saturation_base + fr.saturation_range * 0.5f, 1.0f);
-    float sat = linmap01(sat_min, sat_max, random01());
+    float sat = linmap01(sat_min, sat_max, random01(generator));
 
     glm::vec3 color = hsv_to_rgb(glm::vec3(hue, sat, 1.0f));
 
-    float hue_variance = fr.hue_variance_base * (1.0f + linmap01v(fr.hue_variance_variance, random01()));
-    float saturation_variance = fr.saturation_variance_base * (1.0f + linmap01v(fr.saturation_variance_variance, random01()));
+    float hue_variance = fr.hue_variance_base * (1.0f + linmap01v(fr.hue_variance_variance, random01(generator)));
+    float saturation_variance = fr.saturation_variance_base * (1.0f + linmap01v(fr.saturation_variance_variance, random01(generator)));
 
     params.set_color(color, hue_variance, saturation_variance);
 
     // timing
-    float flying1_duration = fr.flying1_duration_base * (1.0f + linmap01v(fr.flying1_duration_variance, random01()));
-    float explosion_duration = fr.explosion_duration_base * (1.0f + linmap01v(fr.explosion_duration_variance, random01()));
-    float flying2_duration = fr.flying2_duration_base * (1.0f + linmap01v(fr.flying2_duration_variance, random01()));
+    float flying1_duration = fr.flying1_duration_base * (1.0f + linmap01v(fr.flying1_duration_variance, random01(generator)));
+    float explosion_duration = fr.explosion_duration_base * (1.0f + linmap01v(fr.explosion_duration_variance, random01(generator)));
+    float flying2_duration = fr.flying2_duration_base * (1.0f + linmap01v(fr.flying2_duration_variance, random01(generator)));
 
     params.set_timing(flying1_duration, explosion_duration, flying2_duration);
 
+    // multi-stage shells
+    float shell_rnd = random01(generator);
+    if (shell_rnd < fr.crossette_probability) {
+        params.set_crossette();
+    } else if (shell_rnd < fr.crossette_probability + fr.pistil_probability) {
+        params.set_pistil();
+    } else {
+        params.set_sub_bursts(0.0f, 0.0f, 0, 0.0f, 0.0f, 0.0f);
+    }
+
     return params;
 }
 
@@ -224,7 +275,13 @@ FireworkParamsGpu::FireworkParamsGpu(const FireworkParams& params) :
     blink_freq(params.blink_freq),
     blink_start_variance(params.blink_start_variance),
     blink_freq_variance(params.blink_freq_variance),
-    blink_size_mult(params.blink_size_mult) {}
+    blink_size_mult(params.blink_size_mult),
+    sub_burst_probability(params.sub_burst_probability),
+    sub_burst_time(params.get_sub_burst_time()),
+    sub_burst_particle_count(params.sub_burst_particle_count),
+    sub_burst_force(params.sub_burst_force),
+    sub_burst_lifetime(params.sub_burst_lifetime),
+    sub_burst_hue_shift(params.sub_burst_hue_shift) {}
 
 
 FireworkParamsGpuUBO::FireworkParamsGpuUBO() : UBO<FireworkParamsGpu>(OpenGLUtils::get_opengl_version() >= 4.5f ? GL_DYNAMIC_STORAGE_BIT : GL_DYNAMIC_DRAW, GL_SHADER_STORAGE_BUFFER) {}
@@ -234,6 +291,11 @@ void FireworkParamsGpuUBO::set_state(const FireworkParams& params)
     data[0] = FireworkParamsGpu(params);
 }
 
+void FireworkParamsGpuUBO::set_state(const FireworkParamsGpu& params_gpu)
+{
+    data[0] = params_gpu;
+}
+
 
 //  ===============================================  FireworkState  ===============================================
 
@@ -247,12 +309,30 @@ FireworkState::FireworkState(const FireworkParams& params) :
     color(params.color),
     fade_start(params.get_fade_start()),
     fade_size_mult(params.fade_size_mult),
+    particle_size_base(params.particle_size_base),
+    rocket_size_mult(params.rocket_size_mult),
     alive_time(0.0f),
     stage(FireworkStage::FLYING1),
+    gpu_alive_time(0.0f),
+    last_stage(FireworkStage::FLYING1),
+    sub_burst_time(params.sub_burst_probability > 0.0f ? params.get_sub_burst_time() : -1.0f),
+    analytic_start(-1.0f),
+    analytic_gravity(0.0f),
     avg_pos(params.pos),
     avg_vel(params.vel),
     avg_acc(0.0f, 0.0f, 0.0f) {}
 
+FireworkStage FireworkState::get_stage(float time) const
+{
+    if (time > flying2_time) {
+        return FireworkStage::FLYING2;
+    } else if (time > explosion_time) {
+        return FireworkStage::EXPLOSION;
+    } else {
+        return FireworkStage::FLYING1;
+    }
+}
+
 
 //  ===============================================  Firework  ===============================================
 
@@ -260,43 +340,41 @@ Firework::Firework(size_t max_particle_count) : max_particle_count(max_particle_
 {
     active = false;
 
+    params_range = { 0, 0 };
+    seed = 0.0f;
+    trail_base = -1;
+
     glCreateBuffers(1, &vbo_pos);
-    glNamedBufferStorage(vbo_pos, 4 * sizeof(float) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(vbo_pos, 3 * sizeof(float) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
     glCreateBuffers(1, &vbo_vel);
-    glNamedBufferStorage(vbo_vel, 4 * sizeof(float) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
-    glCreateBuffers(1, &vbo_acc);
-    glNamedBufferStorage(vbo_acc, 4 * sizeof(float) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(vbo_vel, 2 * sizeof(GLuint) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
     glCreateBuffers(1, &vbo_color);
-    glNamedBufferStorage(vbo_color, 4 * sizeof(float) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
-    glCreateBuffers(1, &vbo_fade_timing);
-    glNamedBufferStorage(vbo_fade_timing, 2 * sizeof(float) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
-    glCreateBuffers(1, &vbo_blink_timing);
-    glNamedBufferStorage(vbo_blink_timing, 2 * sizeof(float) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(vbo_color, sizeof(GLuint) * max_particle_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    gpu_resources().add_buffer(vbo_pos, "firework positions");
+    gpu_resources().add_buffer(vbo_vel, "firework velocities");
+    gpu_resources().add_buffer(vbo_color, "firework colors");
 
     glCreateVertexArrays(1, &vao);
 
-    glVertexArrayVertexBuffer(vao, 0, vbo_pos, 0, 4 * sizeof(float));
+    glVertexArrayVertexBuffer(vao, 0, vbo_pos, 0, 3 * sizeof(float));
     glEnableVertexArrayAttrib(vao, 0);
-    glVertexArrayAttribFormat(vao, 0, 4, GL_FLOAT, false, 0);
+    glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, false, 0);
     glVertexArrayAttribBinding(vao, 0, 0);
 
-    glVertexArrayVertexBuffer(vao, 1, vbo_color, 0, 4 * sizeof(float));
+    glVertexArrayVertexBuffer(vao, 1, vbo_color, 0, sizeof(GLuint));
     glEnableVertexArrayAttrib(vao, 1);
-    glVertexArrayAttribFormat(vao, 1, 4, GL_FLOAT, false, 0);
+    glVertexArrayAttribFormat(vao, 1, 4, GL_UNSIGNED_BYTE, true, 0);
     glVertexArrayAttribBinding(vao, 1, 1);
 
-    glVertexArrayVertexBuffer(vao, 2, vbo_fade_timing, 0, 2 * sizeof(float));
+    // three halves of packed velocity (analytic motion)
+    glVertexArrayVertexBuffer(vao, 2, vbo_vel, 0, 2 * sizeof(GLuint));
     glEnableVertexArrayAttrib(vao, 2);
-    glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, false, 0);
+    glVertexArrayAttribFormat(vao, 2, 3, GL_HALF_FLOAT, false, 0);
     glVertexArrayAttribBinding(vao, 2, 2);
-
-    glVertexArrayVertexBuffer(vao, 3, vbo_blink_timing, 0, 2 * sizeof(float));
-    glEnableVertexArrayAttrib(vao, 3);
-    glVertexArrayAttribFormat(vao, 3, 2, GL_FLOAT, false, 0);
-    glVertexArrayAttribBinding(vao, 3, 3);
 }
 
-void Firework::activate(FireworkParams params)
+void Firework::activate(FireworkParams params, float seed, FireworkParamsGpuRange params_range, const std::optional<FireworkParamsGpu>& precomputed_gpu)
 {
     params.particle_count = std::min(params.particle_count, max_particle_count);
 
@@ -304,17 +382,29 @@ void Firework::activate(FireworkParams params)
 
     state = FireworkState(params);
 
-    params_gpu.set_state(params);
-    params_gpu.update_opengl_data();
+    this->seed = seed;
+    this->params_range = params_range;
+
+    trail_base = -1;
 
-    glm::vec4 pos4(params.pos, 1.0f);
-    glNamedBufferSubData(vbo_pos, 0, 4 * sizeof(float), &pos4);
+    // precomputed params are already on gpu
+    if (params_range.buffer == 0) {
+        if (precomputed_gpu.has_value()) {
+            params_gpu.set_state(precomputed_gpu.value());
+        } else {
+            params_gpu.set_state(params);
+        }
+        params_gpu.update_opengl_data();
+    }
+
+    // rocket (packed as in fireworks.comp)
+    glNamedBufferSubData(vbo_pos, 0, 3 * sizeof(float), &params.pos);
 
-    glm::vec4 vel4(params.vel, 0.0f);
-    glNamedBufferSubData(vbo_vel, 0, 4 * sizeof(float), &vel4);
+    GLuint vel_packed[2] = { glm::packHalf2x16(glm::vec2(params.vel.x, params.vel.y)), glm::packHalf2x16(glm::vec2(params.vel.z, 0.0f)) };
+    glNamedBufferSubData(vbo_vel, 0, sizeof(vel_packed), vel_packed);
 
-    glm::vec4 color4(params.color, 0.0f);
-    glNamedBufferSubData(vbo_color, 0, 4 * sizeof(float), &color4);
+    GLuint color_packed = glm::packUnorm4x8(glm::vec4(params.color, 1.0f));
+    glNamedBufferSubData(vbo_color, 0, sizeof(GLuint), &color_packed);
 }
 
 void Firework::deactivate()
@@ -330,19 +420,15 @@ void Firework::update(float delta, float gravity)
 
     state.alive_time += delta;
 
-    state.last_stage = state.stage;
-
     if (state.alive_time > state.end_time) {
         deactivate();
         return;
-    } else if (state.alive_time > state.flying2_time) {
-        state.stage = FireworkStage::FLYING2;
-    } else if (state.alive_time > state.explosion_time) {
-        state.stage = FireworkStage::EXPLOSION;
-    } else {
-        state.stage = FireworkStage::FLYING1;
     }
 
+    // stages are never skipped (explosion initializes particles on gpu), too long step only shortens next stage
+    FireworkStage stage = state.get_stage(state.alive_time);
+    state.stage = static_cast<FireworkStage>(std::min(static_cast<unsigned int>(stage), static_cast<unsigned int>(state.stage) + 1));
+
     // update
     glm::vec3 g(0.0f, -gravity, 0.0f);
     glm::vec3 v = state.avg_vel;
@@ -352,7 +438,7 @@ void Firework::update(float delta, float gravity)
     state.avg_vel += a * delta;
 }
 
-void Firework::update_gpu(const ShaderProgram& compute_program, unsigned int local_size)
+void Firework::update_gpu(const Program& compute_program, unsigned int local_size, bool analytic_motion, float gravity)
 {
     if (!active) {
         return;
@@ -360,45 +446,124 @@ void Firework::update_gpu(const ShaderProgram& compute_program, unsigned int loc
 
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vbo_pos);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, vbo_vel);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, vbo_acc);
     
-    if (state.last_stage == FireworkStage::FLYING1 && state.stage == FireworkStage::EXPLOSION) { // [todo] is this optimization?
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, vbo_color);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, vbo_fade_timing);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, vbo_blink_timing);
-    }
+    // explosion initializes colors, sub bursts and trails read them
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, vbo_color);
 
-    params_gpu.bind_buffer_base(6);
+    bind_params(6);
 
+    // acceleration is constant within stage, so integration over whole pending time is exact
+    compute_program.uniform(0, state.alive_time - state.gpu_alive_time);
     compute_program.uniform(3, static_cast<unsigned int>(state.stage));
     compute_program.uniform(4, static_cast<unsigned int>(state.last_stage));
+    compute_program.uniform(6, state.alive_time);
+    compute_program.uniform(13, state.analytic_start);
+    compute_program.uniform(14, state.analytic_gravity);
 
     glDispatchCompute((state.particle_count - 1) / local_size + 1, 1, 1);
+
+    // this update still integrated and stored state, later ones are analytic
+    if (analytic_motion && state.stage == FireworkStage::FLYING2 && state.analytic_start < 0.0f) {
+        state.analytic_start = state.alive_time;
+        state.analytic_gravity = gravity;
+    }
+
+    skip_gpu_update();
+}
+
+void Firework::skip_gpu_update()
+{
+    state.gpu_alive_time = state.alive_time;
+    state.last_stage = state.stage;
+}
+
+bool Firework::is_analytic() const
+{
+    return state.stage == FireworkStage::FLYING2 && state.analytic_start >= 0.0f && state.alive_time > state.analytic_start;
+}
+
+bool Firework::has_pending_gpu_update() const
+{
+    return active && state.alive_time > state.gpu_alive_time;
 }
 
-void Firework::render(const ShaderProgram& program) const
+bool Firework::needs_gpu_update() const
+{
+    bool sub_burst_now = state.sub_burst_time >= 0.0f && state.alive_time >= state.sub_burst_time && state.gpu_alive_time < state.sub_burst_time;
+    return !is_analytic() || sub_burst_now;
+}
+
+void Firework::render(const Program& program) const
 {
     if (!active) {
         return;
     }
 
-    params_gpu.bind_buffer_base(1);
+    bind_params(1);
 
     program.uniform(0, static_cast<unsigned int>(state.stage));
     program.uniform(1, state.alive_time);
+    program.uniform(7, seed); // fade and blink timings are regenerated in vertex shader
+    program.uniform(8, state.analytic_start);
+    program.uniform(9, state.analytic_gravity);
     
     glBindVertexArray(vao);
     glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
     glDrawArrays(GL_POINTS, 0, state.stage == FireworkStage::FLYING1 ? 1 : state.particle_count);
 }
 
-std::optional<PhongLightData> Firework::generate_light() const
+void Firework::render_indirect(const Program& program, GLintptr command_offset) const
 {
     if (!active) {
-        return std::nullopt;
+        return;
+    }
+
+    bind_params(1);
+
+    program.uniform(0, static_cast<unsigned int>(state.stage));
+    program.uniform(1, state.alive_time);
+    program.uniform(7, seed); // fade and blink timings are regenerated in vertex shader
+    program.uniform(8, state.analytic_start);
+    program.uniform(9, state.analytic_gravity);
+    
+    glBindVertexArray(vao);
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glDrawArraysIndirect(GL_POINTS, reinterpret_cast<const void*>(command_offset));
+}
+
+void Firework::bind_params(GLuint index) const
+{
+    if (params_range.buffer != 0) {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, params_range.buffer, params_range.offset, sizeof(FireworkParamsGpu));
+    } else {
+        params_gpu.bind_buffer_base(index);
     }
+}
+
+DrawCommand Firework::get_draw_command() const
+{
+    return { state.stage == FireworkStage::FLYING1 ? 1 : state.particle_count, 1, 0, 0, 0 };
+}
 
+float Firework::get_max_particle_size() const
+{
+    // billboard half diagonal
+    float size_mult = state.stage == FireworkStage::FLYING1 ? glm::max(state.rocket_size_mult, 1.0f) : 1.0f;
+    return 0.71f * size_mult * state.particle_size_base;
+}
+
+glm::vec3 Firework::get_light_color() const
+{
     float fade_mult = state.alive_time < state.fade_start ? 1.0f : 1.0f - glm::pow(1.0f - state.fade_size_mult, 1.5f) * (state.alive_time - state.fade_start) / (state.end_time - state.fade_start);
     float count_mult = state.stage == FireworkStage::FLYING1 ? 0.5f : (state.stage == FireworkStage::EXPLOSION ? 0.5f + 1.0f * (state.alive_time - state.explosion_time) / (state.flying2_time - state.explosion_time) : 1.5f);
-    return PhongLightData::CreatePointLight(state.avg_pos, glm::vec3(0.0f), count_mult * fade_mult * state.color, glm::vec3(0.0f), 1.0f, 0.0f, 0.0f);
+    return count_mult * fade_mult * state.color;
+}
+
+std::optional<PhongLightData> Firework::generate_light() const
+{
+    if (!active) {
+        return std::nullopt;
+    }
+
+    return PhongLightData::CreatePointLight(state.avg_pos, glm::vec3(0.0f), get_light_color(), glm::vec3(0.0f), 1.0f, 0.0f, 0.0f);
 }
\ No newline at end of file
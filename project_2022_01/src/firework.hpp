@@ -4,9 +4,14 @@
 #include "ubo.hpp"
 #include "light_ubo.hpp"
 
+#include "../../common/program_cache.hpp"
+
+#include "gpu_culling.hpp"
+
 #include <glm/glm.hpp>
 
 #include <optional>
+#include <random>
 
 
 
@@ -56,6 +61,10 @@ struct FireworkRandomizationParams
     float explosion_duration_variance;
     float flying2_duration_base;
     float flying2_duration_variance;
+
+    // multi-stage shells (chance of random shell)
+    float crossette_probability;
+    float pistil_probability;
 };
 
 
@@ -97,6 +106,14 @@ struct FireworkParams
     float blink_freq_variance;
     float blink_size_mult;
 
+    // sub bursts (selected particles burst into child particles, emitted on gpu)
+    float sub_burst_probability; // per particle, 0 - simple shell
+    float sub_burst_delay; // after explosion, relative to flying2 duration
+    unsigned int sub_burst_particle_count; // per sub burst (at most SubBursts::MAX_PARTICLES_PER_BURST)
+    float sub_burst_force;
+    float sub_burst_lifetime;
+    float sub_burst_hue_shift;
+
 
     FireworkParams();
     FireworkParams(unsigned int particle_count, glm::vec3 pos, glm::vec3 vel, float explosion_force, float explosion_force_variance, float particle_size_base, float rocket_size_mult, glm::vec3 color, float hue_variance, float saturation_variance, float flying1_duration, float explosion_duration, float flying2_duration, float fade_delay, float fade_start_variance, float fade_end_variance, float fade_size_mult, float blink_delay, float blink_freq, float blink_start_variance, float blink_freq_variance, float blink_size_mult);
@@ -109,6 +126,11 @@ struct FireworkParams
     void set_timing(float flying1_duration_, float explosion_duration_, float flying2_duration_);
     void set_fading(float fade_delay_, float fade_start_variance_, float fade_end_variance_, float fade_size_mult_);
     void set_blinking(float blink_delay_, float blink_freq_, float blink_start_variance_, float blink_freq_variance_, float blink_size_mult_);
+    void set_sub_bursts(float sub_burst_probability_, float sub_burst_delay_, unsigned int sub_burst_particle_count_, float sub_burst_force_, float sub_burst_lifetime_, float sub_burst_hue_shift_);
+
+    // presets
+    void set_crossette(); // particles split into small stars late in flight
+    void set_pistil(); // burst of contrasting color right after explosion (peony with pistil)
 
     float get_explosion_time() const;
     float get_flying2_time() const;
@@ -116,11 +138,16 @@ struct FireworkParams
     
     float get_fade_start() const;
     float get_blink_start() const;
+    float get_sub_burst_time() const;
 
 
     static FireworkParams create_default(const FireworkRandomizationParams& fr);
     static FireworkParams create_random(const FireworkRandomizationParams& fr);
     static FireworkParams create_random_at(const FireworkRandomizationParams& fr, glm::vec3 pos);
+
+    // seeded versions (same generator state -> same params)
+    static FireworkParams create_random(const FireworkRandomizationParams& fr, std::mt19937& generator);
+    static FireworkParams create_random_at(const FireworkRandomizationParams& fr, glm::vec3 pos, std::mt19937& generator);
 };
 
 
@@ -151,6 +178,13 @@ struct FireworkParamsGpu
     float blink_freq_variance;
     float blink_size_mult;
 
+    float sub_burst_probability;
+    float sub_burst_time;
+    unsigned int sub_burst_particle_count;
+    float sub_burst_force;
+    float sub_burst_lifetime;
+    float sub_burst_hue_shift;
+
     FireworkParamsGpu();
     FireworkParamsGpu(const FireworkParams& params);
 };
@@ -175,12 +209,19 @@ class FireworkParamsGpuUBO : public UBO<FireworkParamsGpu>
     static_assert(offsetof(FireworkParamsGpu, blink_start_variance) == 56, "incorrect FireworkParamsGpu layout");
     static_assert(offsetof(FireworkParamsGpu, blink_freq_variance) == 60, "incorrect FireworkParamsGpu layout");
     static_assert(offsetof(FireworkParamsGpu, blink_size_mult) == 64, "incorrect FireworkParamsGpu layout");
-    static_assert(sizeof(FireworkParamsGpu) == 68, "incorrect FireworkParamsGpu layout");
+    static_assert(offsetof(FireworkParamsGpu, sub_burst_probability) == 68, "incorrect FireworkParamsGpu layout");
+    static_assert(offsetof(FireworkParamsGpu, sub_burst_time) == 72, "incorrect FireworkParamsGpu layout");
+    static_assert(offsetof(FireworkParamsGpu, sub_burst_particle_count) == 76, "incorrect FireworkParamsGpu layout");
+    static_assert(offsetof(FireworkParamsGpu, sub_burst_force) == 80, "incorrect FireworkParamsGpu layout");
+    static_assert(offsetof(FireworkParamsGpu, sub_burst_lifetime) == 84, "incorrect FireworkParamsGpu layout");
+    static_assert(offsetof(FireworkParamsGpu, sub_burst_hue_shift) == 88, "incorrect FireworkParamsGpu layout");
+    static_assert(sizeof(FireworkParamsGpu) == 92, "incorrect FireworkParamsGpu layout");
 
 public:
     FireworkParamsGpuUBO();
 
     void set_state(const FireworkParams& params);
+    void set_state(const FireworkParamsGpu& params_gpu);
 };
 
 
@@ -207,9 +248,25 @@ struct FireworkState
     float fade_start;
     float fade_size_mult;
 
+    float particle_size_base;
+    float rocket_size_mult;
+
     float alive_time;
     FireworkStage stage;
-    FireworkStage last_stage;
+
+    // gpu state can lag behind (several simulation steps are one dispatch)
+    float gpu_alive_time; // alive time of gpu state
+    FireworkStage last_stage; // stage of last gpu update
+
+    float sub_burst_time; // -1 - no sub bursts
+
+    // analytic motion in flying2 - particles only fall, gpu state (position, velocity) is stored once at analytic_start
+    // and shaders evaluate position from alive time, compute pass is skipped unless something else needs it
+    float analytic_start; // -1 - integrated every frame
+    float analytic_gravity;
+
+    // stage at given alive time
+    FireworkStage get_stage(float time) const;
 
     glm::vec3 avg_pos;
     glm::vec3 avg_vel;
@@ -221,6 +278,15 @@ struct FireworkState
 };
 
 
+// range of shared buffer with precomputed FireworkParamsGpu (show)
+// buffer == 0 - firework uploads params into its own params_gpu
+struct FireworkParamsGpuRange
+{
+    GLuint buffer;
+    GLintptr offset;
+};
+
+
 // structure holding one firework
 // can be inactive
 // contains and manages gpu buffers for one firework
@@ -231,28 +297,51 @@ struct Firework
 
     // state
     FireworkParamsGpuUBO params_gpu;
+    FireworkParamsGpuRange params_range;
     FireworkState state;
 
-    // buffers (firework gpu state)
-    GLuint vbo_pos;
-    GLuint vbo_vel;
-    GLuint vbo_acc;
-    GLuint vbo_color;
-    GLuint vbo_fade_timing;
-    GLuint vbo_blink_timing;
+    float seed; // explosion randomization (hash31 seed)
+    int trail_base; // first trail in Trails pool, -1 - no trails
+
+    // buffers (firework gpu state, packed - 24 B per particle)
+    // explosion acceleration, fade and blink timings aren't stored, shaders regenerate them from seed
+    GLuint vbo_pos; // vec3 (fp32)
+    GLuint vbo_vel; // 3x half + rounding residuals (fireworks.comp, store_vel)
+    GLuint vbo_color; // rgba8
 
     GLuint vao;
 
 
     Firework(size_t max_particle_count);
 
-    void activate(FireworkParams params);
+    void activate(FireworkParams params, float seed, FireworkParamsGpuRange params_range = { 0, 0 }, const std::optional<FireworkParamsGpu>& precomputed_gpu = std::nullopt);
     void deactivate();
 
+    // one simulation step on cpu, gpu state is brought up to date by update_gpu (any number of steps in one stage at once)
     void update(float delta, float gravity);
-    void update_gpu(const ShaderProgram& compute_program, unsigned int local_size);
 
-    void render(const ShaderProgram& program) const;
+    // analytic_motion - firework entering flying2 switches to analytic motion (see FireworkState::analytic_start)
+    void update_gpu(const Program& compute_program, unsigned int local_size, bool analytic_motion, float gravity);
+    void skip_gpu_update();
+
+    bool is_analytic() const;
+
+    // true if cpu state is ahead of gpu state
+    bool has_pending_gpu_update() const;
+
+    // false if particles are evaluated analytically and no sub burst happens since last gpu update
+    bool needs_gpu_update() const;
+
+    void render(const Program& program) const;
+    void render_indirect(const Program& program, GLintptr command_offset) const; // commands have to be bound (GL_DRAW_INDIRECT_BUFFER)
+
+    void bind_params(GLuint index) const;
+
+    // culling
+    DrawCommand get_draw_command() const;
+    float get_max_particle_size() const;
 
+    // color of point light at average particle position (fades with particles)
+    glm::vec3 get_light_color() const;
     std::optional<PhongLightData> generate_light() const;
 };
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "firework_manager.hpp"
+
+#include <algorithm>
+
+
+
+//  ===============================================  FireworkManager  ===============================================
+
+FireworkManager::FireworkManager() = default;
+
+FireworkManager::FireworkManager(size_t initial_count, size_t max_count, size_t max_particle_count) : max_particle_count(max_particle_count), max_count(max_count)
+{
+    max_queue_length = 4096;
+    grow_step = std::max(initial_count, size_t(8));
+
+    for (size_t i = 0; i < std::min(initial_count, max_count); i++) {
+        fireworks.emplace_back(max_particle_count);
+    }
+
+    // lowest slots are used first
+    for (size_t i = fireworks.size(); i > 0; i--) {
+        free_slots.push_back(i - 1);
+    }
+
+    queue_delayed_count = 0;
+
+    reset_stats();
+}
+
+bool FireworkManager::spawn(const FireworkSpawn& spawn)
+{
+    if (spawn_queue.size() >= max_queue_length) {
+        stats.dropped_count++;
+        return false;
+    }
+
+    spawn_queue.push_back(spawn);
+    stats.peak_queue_length = std::max(stats.peak_queue_length, spawn_queue.size());
+    return true;
+}
+
+void FireworkManager::process_spawn_queue()
+{
+    while (!spawn_queue.empty()) {
+        if (free_slots.empty() && !grow()) {
+            break;
+        }
+
+        activate(spawn_queue.front());
+        spawn_queue.pop_front();
+
+        if (queue_delayed_count > 0) {
+            queue_delayed_count--;
+        }
+    }
+
+    // remaining spawns wait for next frame
+    stats.delayed_count += spawn_queue.size() - queue_delayed_count;
+    queue_delayed_count = spawn_queue.size();
+}
+
+std::optional<size_t> FireworkManager::spawn_now(const FireworkSpawn& spawn)
+{
+    if (free_slots.empty() && !grow()) {
+        stats.dropped_count++;
+        return std::nullopt;
+    }
+
+    return activate(spawn);
+}
+
+size_t FireworkManager::activate(const FireworkSpawn& spawn)
+{
+    size_t slot = free_slots.back();
+    free_slots.pop_back();
+
+    fireworks[slot].activate(spawn.params, spawn.seed, spawn.params_range, spawn.params_gpu);
+    active_slots.push_back(slot);
+
+    stats.spawned_count++;
+    stats.peak_active_count = std::max(stats.peak_active_count, active_slots.size());
+    return slot;
+}
+
+void FireworkManager::collect_inactive()
+{
+    size_t kept = 0;
+    for (size_t slot : active_slots) {
+        if (fireworks[slot].active) {
+            active_slots[kept++] = slot;
+        } else {
+            free_slots.push_back(slot);
+        }
+    }
+    active_slots.resize(kept);
+}
+
+void FireworkManager::clear()
+{
+    for (size_t slot : active_slots) {
+        fireworks[slot].deactivate();
+        free_slots.push_back(slot);
+    }
+    active_slots.clear();
+
+    spawn_queue.clear();
+    queue_delayed_count = 0;
+}
+
+void FireworkManager::reset_stats()
+{
+    stats = FireworkSpawnStats{};
+}
+
+size_t FireworkManager::get_slot_count() const
+{
+    return fireworks.size();
+}
+
+const std::vector<size_t>& FireworkManager::get_active_slots() const
+{
+    return active_slots;
+}
+
+Firework& FireworkManager::get(size_t slot)
+{
+    return fireworks[slot];
+}
+
+const Firework& FireworkManager::get(size_t slot) const
+{
+    return fireworks[slot];
+}
+
+bool FireworkManager::grow()
+{
+    size_t count = std::min(grow_step, max_count - fireworks.size());
+    if (count == 0) {
+        return false;
+    }
+
+    size_t first = fireworks.size();
+    for (size_t i = 0; i < count; i++) {
+        fireworks.emplace_back(max_particle_count);
+    }
+
+    for (size_t i = first + count; i > first; i--) {
+        free_slots.push_back(i - 1);
+    }
+
+    stats.grown_count += count;
+    return true;
+}
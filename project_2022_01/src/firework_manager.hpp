@@ -0,0 +1,84 @@
+#pragma once
+
+#include "firework.hpp"
+
+#include <deque>
+#include <optional>
+#include <vector>
+
+
+
+// counters of firework spawning (back-pressure)
+struct FireworkSpawnStats
+{
+    size_t spawned_count; // activated fireworks
+    size_t delayed_count; // spawns that had to wait in queue for a free slot (at least one frame)
+    size_t dropped_count; // spawns rejected because queue was full
+    size_t grown_count; // slots allocated on demand
+
+    size_t peak_active_count;
+    size_t peak_queue_length;
+};
+
+
+// queued firework
+struct FireworkSpawn
+{
+    FireworkParams params;
+    float seed;
+    FireworkParamsGpuRange params_range; // precomputed gpu params (optional)
+    std::optional<FireworkParamsGpu> params_gpu; // gpu params generated off render thread (optional, FireworkSpawnPool)
+};
+
+
+// pool of firework slots
+// slots are allocated on demand (up to max_count), inactive slots are kept in free list, so spawning is O(1)
+// spawns which can't get a slot (max_count reached) wait in queue and are activated as soon as some firework ends
+struct FireworkManager
+{
+    size_t max_particle_count; // per firework
+    size_t max_count; // hard cap of slots
+    size_t max_queue_length;
+    size_t grow_step; // slots allocated at once
+
+    std::deque<Firework> fireworks; // slots, deque keeps fireworks in place when growing
+    std::vector<size_t> free_slots; // stack
+    std::vector<size_t> active_slots; // in activation order
+
+    std::deque<FireworkSpawn> spawn_queue;
+    size_t queue_delayed_count; // spawns in queue which were already counted as delayed
+
+    FireworkSpawnStats stats;
+
+
+    FireworkManager();
+    FireworkManager(size_t initial_count, size_t max_count, size_t max_particle_count);
+
+    // queues spawn, fireworks are activated in process_spawn_queue
+    // returns false if queue is full (spawn is dropped)
+    bool spawn(const FireworkSpawn& spawn);
+
+    // activates queued spawns (grows slots if needed), call once per frame after spawn requests
+    void process_spawn_queue();
+
+    // activates spawn right away (bypasses queue), returns its slot, std::nullopt if no slot can be allocated
+    std::optional<size_t> spawn_now(const FireworkSpawn& spawn);
+
+    // returns slots of fireworks deactivated during update to free list, call after Firework::update of all active fireworks
+    void collect_inactive();
+
+    // deactivates all fireworks and clears queue (slots are kept)
+    void clear();
+
+    void reset_stats();
+
+    size_t get_slot_count() const;
+    const std::vector<size_t>& get_active_slots() const;
+
+    Firework& get(size_t slot);
+    const Firework& get(size_t slot) const;
+
+private:
+    bool grow();
+    size_t activate(const FireworkSpawn& spawn); // takes free slot, there has to be one
+};
@@ -0,0 +1,200 @@
+#include "firework_show.hpp"
+
+#include "math_util.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+
+
+//  ===============================================  FireworkShow - loading  ===============================================
+
+FireworkShow::FireworkShow() = default;
+
+std::optional<FireworkShow> FireworkShow::load(const std::filesystem::path& path, const FireworkRandomizationParams& fr, size_t max_particle_count)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Firework show " << path << " can't be opened." << std::endl;
+        return std::nullopt;
+    }
+
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> seed_dis(0.0f, 100.0f);
+
+    FireworkShow show;
+
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(file, line)) {
+        line_number++;
+
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream input(line);
+        std::string first;
+        if (!(input >> first)) {
+            continue; // empty line
+        }
+
+        auto error = [&](const std::string& message) {
+            std::cerr << "Firework show " << path << ", line " << line_number << ": " << message << std::endl;
+            return std::nullopt;
+        };
+
+        if (first == "seed") {
+            unsigned int seed;
+            if (!(input >> seed)) {
+                return error("expected seed value");
+            }
+            generator.seed(seed);
+            continue;
+        }
+
+        float time_s;
+        std::string type;
+        try {
+            time_s = std::stof(first);
+        } catch (...) {
+            return error("expected time");
+        }
+        if (!(input >> type)) {
+            return error("expected event type");
+        }
+
+        std::vector<FireworkParams> launched;
+
+        if (type == "default" || type == "random" || type == "random_at") {
+            glm::vec3 pos(0.0f);
+            if (type == "random_at" && !(input >> pos.x >> pos.y >> pos.z)) {
+                return error("expected position");
+            }
+
+            // optional count, anything else after the event is an error
+            int count = 1;
+            if (!(input >> std::ws).eof() && (!(input >> count) || count < 1)) {
+                return error("expected positive launch count");
+            }
+
+            for (int i = 0; i < count; i++) {
+                if (type == "default") {
+                    launched.push_back(FireworkParams::create_default(fr));
+                } else if (type == "random") {
+                    launched.push_back(FireworkParams::create_random(fr, generator));
+                } else {
+                    launched.push_back(FireworkParams::create_random_at(fr, pos, generator));
+                }
+            }
+        } else if (type == "params") {
+            FireworkParams params = FireworkParams::create_default(fr);
+
+            unsigned int particle_count;
+            glm::vec3 pos, vel, color;
+            float explosion_force, explosion_force_variance, particle_size_base, rocket_size_mult, hue_variance, saturation_variance;
+            float flying1_duration, explosion_duration, flying2_duration;
+
+            input >> particle_count >> pos.x >> pos.y >> pos.z >> vel.x >> vel.y >> vel.z >> explosion_force >> explosion_force_variance
+                >> particle_size_base >> rocket_size_mult >> color.r >> color.g >> color.b >> hue_variance >> saturation_variance
+                >> flying1_duration >> explosion_duration >> flying2_duration;
+            if (!input) {
+                return error("expected 19 values of params event");
+            }
+
+            params.set_particle_count(particle_count);
+            params.set_physics(pos, vel, explosion_force, explosion_force_variance);
+            params.set_sizing(particle_size_base, rocket_size_mult);
+            params.set_color(color, hue_variance, saturation_variance);
+            params.set_timing(flying1_duration, explosion_duration, flying2_duration);
+
+            launched.push_back(params);
+        } else {
+            return error("unknown event type '" + type + "'");
+        }
+
+        for (FireworkParams& params : launched) {
+            params.particle_count = std::min(params.particle_count, max_particle_count);
+            show.events.push_back({ time_s * 1000.0f, params, seed_dis(generator) });
+        }
+    }
+
+    std::stable_sort(show.events.begin(), show.events.end(), [](const FireworkShowEvent& a, const FireworkShowEvent& b) { return a.time < b.time; });
+
+    show.duration = 0.0f;
+    show.max_lifetime = 0.0f;
+    for (const FireworkShowEvent& event : show.events) {
+        show.duration = std::max(show.duration, event.time + event.params.get_end_time());
+        show.max_lifetime = std::max(show.max_lifetime, event.params.get_end_time());
+    }
+
+    show.time = 0.0f;
+    show.cursor = 0;
+    show.playing = false;
+
+    show.upload_params();
+
+    return show;
+}
+
+void FireworkShow::upload_params()
+{
+    GLint alignment = 1;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    params_stride = (sizeof(FireworkParamsGpu) + alignment - 1) / alignment * alignment;
+
+    // one upload of all params (padding between events is left uninitialized)
+    std::vector<unsigned char> data(std::max(events.size(), size_t(1)) * params_stride);
+    for (size_t i = 0; i < events.size(); i++) {
+        FireworkParamsGpu params_gpu(events[i].params);
+        std::copy_n(reinterpret_cast<const unsigned char*>(&params_gpu), sizeof(FireworkParamsGpu), data.data() + i * params_stride);
+    }
+
+    glCreateBuffers(1, &params_buffer);
+    glNamedBufferStorage(params_buffer, data.size(), data.data(), 0);
+    gpu_resources().add_buffer(params_buffer, "firework show params");
+}
+
+void FireworkShow::destroy()
+{
+    gpu_resources().remove_buffer(params_buffer);
+    glDeleteBuffers(1, &params_buffer);
+    params_buffer = 0;
+}
+
+
+//  ===============================================  FireworkShow - playback  ===============================================
+
+std::optional<size_t> FireworkShow::next_due_event()
+{
+    if (cursor < events.size() && events[cursor].time <= time) {
+        return cursor++;
+    }
+    return std::nullopt;
+}
+
+void FireworkShow::seek(float time)
+{
+    this->time = time;
+
+    auto it = std::lower_bound(events.begin(), events.end(), time, [](const FireworkShowEvent& event, float t) { return event.time < t; });
+    cursor = it - events.begin();
+}
+
+size_t FireworkShow::get_first_alive_event() const
+{
+    float t = time - max_lifetime;
+
+    auto it = std::lower_bound(events.begin(), events.begin() + cursor, t, [](const FireworkShowEvent& event, float t) { return event.time < t; });
+    return it - events.begin();
+}
+
+FireworkSpawn FireworkShow::get_spawn(size_t event) const
+{
+    return { events[event].params, events[event].seed, { params_buffer, static_cast<GLintptr>(event) * params_stride } };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "firework.hpp"
+#include "firework_manager.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+
+
+// one launch of a show, params are fully resolved when show is loaded
+struct FireworkShowEvent
+{
+    float time; // from show start (ms)
+    FireworkParams params;
+    float seed;
+};
+
+
+// timeline of firework launches loaded from show file
+// random events are resolved at load time using generator seeded from the file, so playback is deterministic
+// gpu params of all events are uploaded at once into params_buffer (fireworks bind their range instead of uploading own params)
+//
+// show file - one event per line, '#' starts comment, times in seconds:
+//     seed <uint>
+//     <time> default [count]
+//     <time> random [count]
+//     <time> random_at <x> <y> <z> [count]
+//     <time> params <particle_count> <pos xyz> <vel xyz> <explosion_force> <explosion_force_variance> <particle_size_base> <rocket_size_mult> <color rgb> <hue_variance> <saturation_variance> <flying1_duration> <explosion_duration> <flying2_duration>
+struct FireworkShow
+{
+    std::vector<FireworkShowEvent> events; // sorted by time (stable, file order for same time)
+
+    GLuint params_buffer;
+    GLintptr params_stride; // FireworkParamsGpu aligned to storage buffer offset alignment
+
+    float duration; // end of last firework
+    float max_lifetime; // longest firework
+
+    // playback
+    float time;
+    size_t cursor; // next event to spawn
+    bool playing;
+
+
+    FireworkShow();
+
+    // returns std::nullopt if file can't be read or parsed (error is printed)
+    static std::optional<FireworkShow> load(const std::filesystem::path& path, const FireworkRandomizationParams& fr, size_t max_particle_count);
+
+    void destroy();
+
+    // returns next event with time <= show time (and moves cursor), std::nullopt if there is none
+    std::optional<size_t> next_due_event();
+
+    // moves playback to time, events starting before time are skipped
+    void seek(float time);
+
+    // first event which can still be alive at current show time (events from here up to cursor may be in flight)
+    size_t get_first_alive_event() const;
+
+    FireworkSpawn get_spawn(size_t event) const;
+
+private:
+    void upload_params();
+};
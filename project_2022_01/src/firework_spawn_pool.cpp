@@ -0,0 +1,151 @@
+#include "firework_spawn_pool.hpp"
+
+#include "math_util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+
+
+// randomization params are compared bytewise (copies are made by memcpy, so padding matches)
+static_assert(std::is_trivially_copyable_v<FireworkRandomizationParams>, "FireworkRandomizationParams has to be trivially copyable");
+
+
+//  ===============================================  FireworkSpawnPool  ===============================================
+
+FireworkSpawnPool::FireworkSpawnPool(size_t thread_count, size_t capacity, size_t max_particle_count, const FireworkRandomizationParams& fr)
+    : capacity(capacity), max_particle_count(max_particle_count)
+{
+    popped_count = 0;
+    fallback_count = 0;
+
+    std::memcpy(&randomization, &fr, sizeof(FireworkRandomizationParams));
+    generation = 0;
+    stopping = false;
+
+    std::random_device seed_source;
+    for (size_t i = 0; i < std::max(thread_count, size_t(1)); i++) {
+        workers.emplace_back(&FireworkSpawnPool::run_worker, this, seed_source());
+    }
+}
+
+FireworkSpawnPool::~FireworkSpawnPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    refill.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void FireworkSpawnPool::set_randomization(const FireworkRandomizationParams& fr)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::memcmp(&randomization, &fr, sizeof(FireworkRandomizationParams)) == 0) {
+            return;
+        }
+
+        std::memcpy(&randomization, &fr, sizeof(FireworkRandomizationParams));
+        generation++;
+        ready.clear();
+    }
+    refill.notify_all();
+}
+
+FireworkSpawn FireworkSpawnPool::pop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (ready.empty()) {
+        FireworkRandomizationParams fr;
+        std::memcpy(&fr, &randomization, sizeof(FireworkRandomizationParams));
+        lock.unlock();
+
+        fallback_count++;
+        return generate(fr, rnd());
+    }
+
+    FireworkSpawn spawn = ready.front();
+    ready.pop_front();
+    popped_count++;
+
+    // workers are woken when half of the pool is used
+    bool wake = ready.size() <= capacity / 2;
+    lock.unlock();
+
+    if (wake) {
+        refill.notify_all();
+    }
+
+    return spawn;
+}
+
+FireworkSpawn FireworkSpawnPool::pop_at(glm::vec3 pos)
+{
+    FireworkSpawn spawn = pop();
+    spawn.params.pos = pos;
+    return spawn;
+}
+
+size_t FireworkSpawnPool::get_ready_count()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready.size();
+}
+
+size_t FireworkSpawnPool::get_thread_count() const
+{
+    return workers.size();
+}
+
+void FireworkSpawnPool::run_worker(unsigned int seed)
+{
+    std::mt19937 generator(seed);
+
+    FireworkRandomizationParams fr;
+    std::vector<FireworkSpawn> batch;
+    batch.reserve(BATCH_SIZE);
+
+    while (true) {
+        size_t batch_generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            refill.wait(lock, [this]() { return stopping || ready.size() < capacity; });
+            if (stopping) {
+                return;
+            }
+
+            std::memcpy(&fr, &randomization, sizeof(FireworkRandomizationParams));
+            batch_generation = generation;
+        }
+
+        // generated without lock, other workers generate their batches in parallel
+        batch.clear();
+        for (size_t i = 0; i < BATCH_SIZE; i++) {
+            batch.push_back(generate(fr, generator));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (batch_generation == generation) {
+            size_t count = std::min(batch.size(), capacity - std::min(capacity, ready.size()));
+            ready.insert(ready.end(), batch.begin(), batch.begin() + count);
+        }
+    }
+}
+
+FireworkSpawn FireworkSpawnPool::generate(const FireworkRandomizationParams& fr, std::mt19937& generator) const
+{
+    FireworkParams params = FireworkParams::create_random(fr, generator);
+    params.particle_count = std::min(params.particle_count, max_particle_count);
+
+    // same range as Application::hash31_seed_dis
+    float seed = std::uniform_real_distribution<float>(0.0f, 10.0f)(generator);
+
+    return { params, seed, { 0, 0 }, FireworkParamsGpu(params) };
+}
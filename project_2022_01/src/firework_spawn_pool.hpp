@@ -0,0 +1,62 @@
+#pragma once
+
+#include "firework.hpp"
+#include "firework_manager.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+// background generation of random firework spawns (FireworkParams::create_random)
+// worker threads keep a queue of ready spawns (params, gpu params block, hash seed), spawning only pops them
+// workers have their own generators, so render thread never touches random singleton for pooled spawns
+// queued spawns are discarded when randomization params change
+struct FireworkSpawnPool
+{
+    static const size_t BATCH_SIZE = 32; // spawns generated by worker per lock
+
+    size_t capacity;
+    size_t max_particle_count;
+
+    // counters (render thread)
+    size_t popped_count;
+    size_t fallback_count; // spawns generated synchronously because pool was empty
+
+
+    FireworkSpawnPool(size_t thread_count, size_t capacity, size_t max_particle_count, const FireworkRandomizationParams& fr);
+    ~FireworkSpawnPool();
+
+    FireworkSpawnPool(const FireworkSpawnPool&) = delete;
+    FireworkSpawnPool& operator=(const FireworkSpawnPool&) = delete;
+
+    // discards queued spawns if params differ from the ones used by workers, call once per frame
+    void set_randomization(const FireworkRandomizationParams& fr);
+
+    // random spawn (create_random), generated synchronously if pool is empty
+    FireworkSpawn pop();
+
+    // random spawn at position (create_random_at - position is the only difference)
+    FireworkSpawn pop_at(glm::vec3 pos);
+
+    size_t get_ready_count();
+    size_t get_thread_count() const;
+
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable refill;
+
+    // guarded by mutex
+    std::deque<FireworkSpawn> ready;
+    FireworkRandomizationParams randomization;
+    size_t generation; // incremented when randomization changes, batches of older generation are dropped
+    bool stopping;
+
+    void run_worker(unsigned int seed);
+    FireworkSpawn generate(const FireworkRandomizationParams& fr, std::mt19937& generator) const;
+};
@@ -0,0 +1,236 @@
+#include "gpu_culling.hpp"
+
+#include "utils.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <limits>
+
+
+
+//  ===============================================  Aabb  ===============================================
+
+Aabb::Aabb() : min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max()) {}
+Aabb::Aabb(glm::vec3 min, glm::vec3 max) : min(min), max(max) {}
+
+Aabb Aabb::from_positions(const std::vector<float>& positions)
+{
+    Aabb aabb;
+    for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+        glm::vec3 p(positions[i], positions[i + 1], positions[i + 2]);
+        aabb.min = glm::min(aabb.min, p);
+        aabb.max = glm::max(aabb.max, p);
+    }
+    return aabb;
+}
+
+Aabb Aabb::transform(const glm::mat4& matrix) const
+{
+    Aabb aabb;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = glm::mix(min, max, glm::vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+        glm::vec3 p = glm::vec3(matrix * glm::vec4(corner, 1.0f));
+        aabb.min = glm::min(aabb.min, p);
+        aabb.max = glm::max(aabb.max, p);
+    }
+    return aabb;
+}
+
+
+//  ===============================================  GpuCulling  ===============================================
+
+GpuCulling::GpuCulling() = default;
+
+GpuCulling::GpuCulling(size_t max_record_count, size_t max_bounds_count) : max_record_count(max_record_count), max_bounds_count(max_bounds_count)
+{
+    records.reserve(max_record_count);
+    commands.reserve(max_record_count);
+
+    glCreateBuffers(1, &records_buffer);
+    glNamedBufferStorage(records_buffer, sizeof(CullRecord) * max_record_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &commands_buffer);
+    glNamedBufferStorage(commands_buffer, sizeof(DrawCommand) * max_record_count * MAX_VIEW_COUNT, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &counters_buffer);
+    glNamedBufferStorage(counters_buffer, sizeof(GLuint) * MAX_VIEW_COUNT, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &bounds_min_buffer);
+    glNamedBufferStorage(bounds_min_buffer, 4 * sizeof(GLuint) * max_bounds_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &bounds_max_buffer);
+    glNamedBufferStorage(bounds_max_buffer, 4 * sizeof(GLuint) * max_bounds_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    gpu_resources().add_buffer(records_buffer, "culling records");
+    gpu_resources().add_buffer(commands_buffer, "culling commands");
+    gpu_resources().add_buffer(counters_buffer, "culling counters");
+    stats_readback = GpuReadback(sizeof(GLuint) * MAX_VIEW_COUNT);
+    gpu_resources().add_buffer(bounds_min_buffer, "firework bounds");
+    gpu_resources().add_buffer(bounds_max_buffer, "firework bounds");
+
+    hiz_texture = 0;
+    hiz_width = 0;
+    hiz_height = 0;
+    hiz_level_count = 0;
+
+    hiz_view_projection = glm::mat4(1.0f);
+    hiz_valid = false;
+
+    frustum_culling = true;
+    occlusion_culling = true;
+
+    visible_count[0] = 0;
+    visible_count[1] = 0;
+    record_count = 0;
+}
+
+void GpuCulling::resize_hiz(size_t width, size_t height)
+{
+    gpu_resources().remove_texture(hiz_texture);
+    glDeleteTextures(1, &hiz_texture);
+
+    hiz_width = width;
+    hiz_height = height;
+
+    hiz_level_count = 1;
+    while ((std::max(hiz_width, hiz_height) >> hiz_level_count) > 0) {
+        hiz_level_count++;
+    }
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &hiz_texture);
+    glTextureStorage2D(hiz_texture, hiz_level_count, GL_R32F, hiz_width, hiz_height);
+    TextureUtils::set_texture_2d_parameters(hiz_texture, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST);
+    gpu_resources().add_texture(hiz_texture, "hierarchical z");
+
+    invalidate_hiz();
+}
+
+void GpuCulling::clear()
+{
+    records.clear();
+    commands.clear();
+}
+
+size_t GpuCulling::add(const CullRecord& record, const DrawCommand& command)
+{
+    if (records.size() >= max_record_count) {
+        return max_record_count; // not culled, caller has to draw directly
+    }
+
+    records.push_back(record);
+    commands.push_back(command);
+    return records.size() - 1;
+}
+
+void GpuCulling::reset_bounds()
+{
+    // min = ordered(+inf), max = ordered(-inf)
+    GLuint min_value = 0xFFFFFFFFu;
+    GLuint max_value = 0u;
+    glClearNamedBufferData(bounds_min_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &min_value);
+    glClearNamedBufferData(bounds_max_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &max_value);
+}
+
+void GpuCulling::bind_bounds(GLuint min_binding, GLuint max_binding) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, min_binding, bounds_min_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, max_binding, bounds_max_buffer);
+}
+
+void GpuCulling::build_hiz(const Program& program, GLuint depth_texture, const glm::mat4& view_projection)
+{
+    program.use();
+
+    size_t src_width = hiz_width;
+    size_t src_height = hiz_height;
+
+    for (size_t level = 0; level < hiz_level_count; level++) {
+        size_t dst_width = std::max<size_t>(hiz_width >> level, 1);
+        size_t dst_height = std::max<size_t>(hiz_height >> level, 1);
+
+        // level 0 - copy of depth, other levels - max of previous level
+        glBindTextureUnit(0, level == 0 ? depth_texture : hiz_texture);
+        glBindImageTexture(0, hiz_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        program.uniform(0, level == 0);
+        program.uniform(1, static_cast<int>(level == 0 ? 0 : level - 1));
+        program.uniform(2, glm::ivec2(src_width, src_height));
+        program.uniform(3, glm::ivec2(dst_width, dst_height));
+
+        glDispatchCompute((dst_width + 7) / 8, (dst_height + 7) / 8, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+
+    hiz_view_projection = view_projection;
+    hiz_valid = true;
+}
+
+void GpuCulling::invalidate_hiz()
+{
+    hiz_valid = false;
+}
+
+void GpuCulling::cull(const Program& program, const glm::mat4 view_projections[], size_t view_count, bool layered)
+{
+    read_stats();
+
+    record_count = records.size();
+    if (record_count == 0) {
+        return;
+    }
+
+    // upload records, commands are copied for all views and culled in place
+    glNamedBufferSubData(records_buffer, 0, sizeof(CullRecord) * record_count, records.data());
+    for (size_t view = 0; view < view_count; view++) {
+        glNamedBufferSubData(commands_buffer, get_command_offset(view, 0), sizeof(DrawCommand) * record_count, commands.data());
+    }
+
+    GLuint zero = 0;
+    glClearNamedBufferData(counters_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    program.use();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, records_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commands_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, counters_buffer);
+    bind_bounds(3, 4);
+
+    glBindTextureUnit(0, hiz_texture);
+
+    program.uniform(0, static_cast<unsigned int>(record_count));
+    program.uniform(1, static_cast<unsigned int>(max_record_count));
+    program.uniform(2, static_cast<int>(view_count));
+    program.uniform(3, layered);
+    program.uniform(4, frustum_culling);
+    program.uniform(5, occlusion_culling && hiz_valid && !layered);
+    program.uniform(6, static_cast<int>(hiz_level_count));
+    program.uniform(7, hiz_view_projection);
+    for (size_t view = 0; view < view_count; view++) {
+        program.uniform(8 + view, view_projections[view]);
+    }
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    glDispatchCompute((record_count + 63) / 64, layered ? 1 : view_count, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    stats_readback.copy(counters_buffer, 0);
+}
+
+void GpuCulling::bind_commands() const
+{
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands_buffer);
+}
+
+GLintptr GpuCulling::get_command_offset(size_t view, size_t record) const
+{
+    return static_cast<GLintptr>(sizeof(DrawCommand) * (view * max_record_count + record));
+}
+
+void GpuCulling::read_stats()
+{
+    // copies of counters are fenced, stats keep older values until a copy is finished
+    stats_readback.read(visible_count);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "program.hpp"
+
+#include "../../common/program_cache.hpp"
+
+#include "gpu_readback.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+
+// axis aligned bounding box
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+
+    Aabb();
+    Aabb(glm::vec3 min, glm::vec3 max);
+
+    // positions - 3 floats per vertex
+    static Aabb from_positions(const std::vector<float>& positions);
+
+    // aabb of transformed box
+    Aabb transform(const glm::mat4& matrix) const;
+};
+
+
+// one culled draw, layout matches CullRecord in cull.comp (std430)
+struct CullRecord
+{
+    glm::vec3 aabb_min; // world space
+    float expand; // aabb is expanded by this value (billboard size)
+    glm::vec3 aabb_max; // world space
+    int bounds_slot; // >= 0 - aabb is taken from dynamic bounds (computed on gpu), -1 - static aabb
+};
+
+// DrawElementsIndirectCommand, DrawArraysIndirectCommand uses first 4 values (count, instance_count, first, base_instance)
+struct DrawCommand
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_vertex; // base_instance for arrays
+    GLuint base_instance; // unused for arrays
+};
+
+
+// gpu culling of draws
+// frustum culling for all views, occlusion culling (hierarchical z from previous frame) for view 0
+// culled draws are kept in place with instance_count 0 (each draw uses its own vao)
+struct GpuCulling
+{
+    // check correct layout for gpu
+    static_assert(sizeof(CullRecord) == 32, "incorrect CullRecord layout");
+    static_assert(sizeof(DrawCommand) == 20, "incorrect DrawCommand layout");
+
+    static const size_t MAX_VIEW_COUNT = 2;
+
+    size_t max_record_count;
+    size_t max_bounds_count;
+
+    // records + draw commands (for all views, view-major)
+    std::vector<CullRecord> records;
+    std::vector<DrawCommand> commands;
+
+    GLuint records_buffer;
+    GLuint commands_buffer;
+    GLuint counters_buffer; // visible draws per view
+
+    // dynamic bounds (ordered uint encoded floats, written by atomics)
+    GLuint bounds_min_buffer;
+    GLuint bounds_max_buffer;
+
+    // hierarchical z (max depth), built from depth of view 0
+    GLuint hiz_texture;
+    size_t hiz_width;
+    size_t hiz_height;
+    size_t hiz_level_count;
+
+    glm::mat4 hiz_view_projection;
+    bool hiz_valid;
+
+    // settings
+    bool frustum_culling;
+    bool occlusion_culling;
+
+    // stats (read back a few frames late without waiting for gpu)
+    GpuReadback stats_readback; // counters_buffer
+    GLuint visible_count[MAX_VIEW_COUNT];
+    size_t record_count;
+
+
+    GpuCulling();
+    GpuCulling(size_t max_record_count, size_t max_bounds_count);
+
+    void resize_hiz(size_t width, size_t height);
+
+    // records
+    void clear();
+    size_t add(const CullRecord& record, const DrawCommand& command);
+
+    // dynamic bounds
+    void reset_bounds();
+    void bind_bounds(GLuint min_binding, GLuint max_binding) const;
+
+    // builds hierarchical z from depth texture (view_projection - matrix used for rendering the depth)
+    void build_hiz(const Program& program, GLuint depth_texture, const glm::mat4& view_projection);
+    void invalidate_hiz();
+
+    // layered - all views are rendered by one draw (view 0 commands), draw is culled only if it isn't visible in any view
+    void cull(const Program& program, const glm::mat4 view_projections[], size_t view_count, bool layered);
+
+    void bind_commands() const;
+    GLintptr get_command_offset(size_t view, size_t record) const;
+
+    // latest finished counters into visible_count (never waits for gpu)
+    void read_stats();
+};
@@ -0,0 +1,63 @@
+#include "gpu_readback.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <cstring>
+
+
+
+//  ===============================================  GpuReadback  ===============================================
+
+GpuReadback::GpuReadback() : size(0), buffer(0), data(nullptr), fences{}, slot(0) {}
+
+GpuReadback::GpuReadback(size_t size) : GpuReadback()
+{
+    this->size = size;
+
+    glCreateBuffers(1, &buffer);
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glNamedBufferStorage(buffer, size * SLOT_COUNT, nullptr, flags);
+    data = static_cast<uint8_t*>(glMapNamedBufferRange(buffer, 0, size * SLOT_COUNT, flags));
+    gpu_resources().add_buffer(buffer, "readback");
+}
+
+void GpuReadback::copy(GLuint source, GLintptr offset)
+{
+    if (buffer == 0) {
+        return;
+    }
+
+    GLsync& fence = fences[slot];
+    if (fence != nullptr) {
+        glDeleteSync(fence);
+    }
+
+    glCopyNamedBufferSubData(source, buffer, offset, static_cast<GLintptr>(size * slot), size);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    slot = (slot + 1) % SLOT_COUNT;
+}
+
+bool GpuReadback::read(void* result)
+{
+    // newest to oldest, fences of one queue are signaled in order
+    for (size_t i = 1; i <= SLOT_COUNT; i++) {
+        size_t s = (slot + SLOT_COUNT - i) % SLOT_COUNT;
+        if (fences[s] == nullptr || glClientWaitSync(fences[s], 0, 0) == GL_TIMEOUT_EXPIRED) {
+            continue;
+        }
+
+        std::memcpy(result, data + size * s, size);
+
+        // this and older copies are done
+        for (GLsync& fence : fences) {
+            if (fence != nullptr && glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        return true;
+    }
+
+    return false;
+}
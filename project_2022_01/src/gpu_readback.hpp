@@ -0,0 +1,32 @@
+#pragma once
+
+#include "program.hpp"
+
+#include <cstdint>
+
+
+
+// delayed readback of a small range of a gpu buffer (stats counters)
+// each copy goes into a slot of a persistently mapped ring and is read only after its fence is signaled,
+// so the cpu never waits for the gpu (values are up to SLOT_COUNT frames old)
+struct GpuReadback
+{
+    static const size_t SLOT_COUNT = 3;
+
+    size_t size; // bytes per copy
+
+    GLuint buffer;
+    uint8_t* data; // persistently mapped
+    GLsync fences[SLOT_COUNT]; // nullptr - slot is free or already read
+    size_t slot; // next slot to copy into
+
+
+    GpuReadback();
+    GpuReadback(size_t size);
+
+    // copies size bytes of source at offset into next slot (unread copy in that slot is dropped)
+    void copy(GLuint source, GLintptr offset);
+
+    // newest finished copy (older copies are dropped), false - no copy finished since last read
+    bool read(void* result);
+};
@@ -0,0 +1,90 @@
+#include "layered_views.hpp"
+
+#include "utils.hpp"
+
+#include "ubo_impl.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+
+
+//  ===============================================  LayeredCamerasUBO  ===============================================
+
+LayeredCamerasUBO::LayeredCamerasUBO() : UBO<LayeredCamerasData>(OpenGLUtils::get_opengl_version() >= 4.5f ? GL_DYNAMIC_STORAGE_BIT : GL_DYNAMIC_DRAW, GL_UNIFORM_BUFFER) {}
+
+void LayeredCamerasUBO::set_view(size_t view_index, const CameraUBO& camera, float clip_distance)
+{
+    const CameraData& camera_data = camera.get_data()[0];
+
+    data[0].projection[view_index] = camera_data.projection;
+    data[0].view[view_index] = camera_data.view;
+    data[0].eye_position[view_index] = glm::vec4(glm::vec3(camera_data.eye_position), 1.0f);
+    data[0].clip_distance[view_index] = glm::vec4(clip_distance, 0.0f, 0.0f, 0.0f);
+}
+
+
+//  ===============================================  LayeredTarget  ===============================================
+
+LayeredTarget::LayeredTarget() : width(0), height(0), color_texture(0), depth_texture(0), color_views{0, 0}, depth_views{0, 0}, fbo(0), main_fbo(0) {}
+
+void LayeredTarget::create(size_t width_, size_t height_)
+{
+    width = width_;
+    height = height_;
+
+    // textures
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &color_texture);
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &depth_texture);
+
+    glTextureStorage3D(color_texture, 1, GL_RGBA16F, width, height, LAYERED_VIEW_COUNT);
+    glTextureStorage3D(depth_texture, 1, GL_DEPTH_COMPONENT24, width, height, LAYERED_VIEW_COUNT);
+
+    // views share storage of color_texture / depth_texture, they aren't tracked
+    gpu_resources().add_texture(color_texture, "layered color");
+    gpu_resources().add_texture(depth_texture, "layered depth");
+
+    // views (sampled as ordinary 2d textures)
+    glGenTextures(LAYERED_VIEW_COUNT, color_views);
+    for (size_t i = 0; i < LAYERED_VIEW_COUNT; i++) {
+        glTextureView(color_views[i], GL_TEXTURE_2D, color_texture, GL_RGBA16F, 0, 1, i, 1);
+        TextureUtils::set_texture_2d_parameters(color_views[i], GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+    }
+
+    glGenTextures(LAYERED_VIEW_COUNT, depth_views);
+    for (size_t i = 0; i < LAYERED_VIEW_COUNT; i++) {
+        glTextureView(depth_views[i], GL_TEXTURE_2D, depth_texture, GL_DEPTH_COMPONENT24, 0, 1, i, 1);
+        TextureUtils::set_texture_2d_parameters(depth_views[i], GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    }
+
+    // framebuffers
+    glCreateFramebuffers(1, &fbo);
+    glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, color_texture, 0);
+    glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depth_texture, 0);
+    FBOUtils::check_framebuffer_status(fbo, "layered framebuffer");
+
+    glCreateFramebuffers(1, &main_fbo);
+    glNamedFramebufferTextureLayer(main_fbo, GL_COLOR_ATTACHMENT0, color_texture, 0, 0);
+    glNamedFramebufferTextureLayer(main_fbo, GL_DEPTH_ATTACHMENT, depth_texture, 0, 0);
+    FBOUtils::check_framebuffer_status(main_fbo, "layered framebuffer (main layer)");
+}
+
+void LayeredTarget::destroy()
+{
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteFramebuffers(1, &main_fbo);
+
+    gpu_resources().remove_texture(color_texture);
+    gpu_resources().remove_texture(depth_texture);
+
+    glDeleteTextures(LAYERED_VIEW_COUNT, color_views);
+    glDeleteTextures(LAYERED_VIEW_COUNT, depth_views);
+    glDeleteTextures(1, &color_texture);
+    glDeleteTextures(1, &depth_texture);
+
+    *this = LayeredTarget();
+}
+
+glm::vec2 LayeredTarget::get_uv_scale(glm::vec2 viewport_size) const
+{
+    return viewport_size / glm::vec2(width, height);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ubo.hpp"
+#include "camera_ubo.hpp"
+
+#include <glm/glm.hpp>
+
+
+
+// number of views rendered in single (layered) pass
+// view 0 - normal camera, view 1 - mirror camera
+constexpr size_t LAYERED_VIEW_COUNT = 2;
+
+
+// cameras for layered rendering, layout matches LayeredCameraBuffer in shaders
+struct LayeredCamerasData
+{
+    glm::mat4 projection[LAYERED_VIEW_COUNT];
+    glm::mat4 view[LAYERED_VIEW_COUNT];
+    glm::vec4 eye_position[LAYERED_VIEW_COUNT];
+    glm::vec4 clip_distance[LAYERED_VIEW_COUNT]; // x - particles closer than clip distance are discarded (mirror)
+};
+
+class LayeredCamerasUBO : public UBO<LayeredCamerasData>
+{
+    // check correct layout for gpu (std140)
+    static_assert(offsetof(LayeredCamerasData, projection) == 0, "incorrect LayeredCamerasData layout");
+    static_assert(offsetof(LayeredCamerasData, view) == 128, "incorrect LayeredCamerasData layout");
+    static_assert(offsetof(LayeredCamerasData, eye_position) == 256, "incorrect LayeredCamerasData layout");
+    static_assert(offsetof(LayeredCamerasData, clip_distance) == 288, "incorrect LayeredCamerasData layout");
+    static_assert(sizeof(LayeredCamerasData) == 320, "incorrect LayeredCamerasData layout");
+
+public:
+    static const int DEFAULT_LAYERED_CAMERAS_BINDING = 5;
+
+    LayeredCamerasUBO();
+
+    void set_view(size_t view_index, const CameraUBO& camera, float clip_distance);
+};
+
+
+// layered framebuffer with one layer per view
+// layer sizes are the same, each view renders into its own viewport (gl_ViewportIndex)
+struct LayeredTarget
+{
+    size_t width;
+    size_t height;
+
+    GLuint color_texture; // GL_TEXTURE_2D_ARRAY
+    GLuint depth_texture; // GL_TEXTURE_2D_ARRAY
+
+    GLuint color_views[LAYERED_VIEW_COUNT]; // GL_TEXTURE_2D view of each layer
+    GLuint depth_views[LAYERED_VIEW_COUNT]; // GL_TEXTURE_2D view of each layer (hierarchical z of view 0)
+
+    GLuint fbo; // all layers
+    GLuint main_fbo; // layer 0 only
+
+
+    LayeredTarget();
+
+    void create(size_t width, size_t height);
+    void destroy();
+
+    // scale of texture coordinates of viewport (0, 0, viewport_width, viewport_height)
+    glm::vec2 get_uv_scale(glm::vec2 viewport_size) const;
+};
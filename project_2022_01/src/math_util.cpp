@@ -56,6 +56,7 @@ float RandomSingleton::random01()
 
 std::mt19937& rnd() { return RandomSingleton::get_random_generator(); }
 float random01() { return RandomSingleton::random01(); }
+float random01(std::mt19937& generator) { return std::uniform_real_distribution<float>(0.0f, 1.0f)(generator); }
 
 
 //  ===============================================  hsv rgb conversion  ===============================================
@@ -32,6 +32,7 @@ public:
 
 std::mt19937& rnd();
 float random01();
+float random01(std::mt19937& generator); // seeded generator (deterministic sequences)
 
 
 glm::vec3 hsv_to_rgb(glm::vec3 rgb);
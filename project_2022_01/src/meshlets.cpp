@@ -0,0 +1,354 @@
+#include "meshlets.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+
+namespace {
+    const float DISTANCE_WEIGHT = 1.0f;
+    const float FREE_NEIGHBOR_WEIGHT = 0.1f;
+
+    // greedy growth from a seed triangle, next triangle shares most vertices with the meshlet, faces the same way
+    // (tighter normal cone), is close to its center (smaller sphere) and has few free neighbors (fills gaps instead
+    // of leaving small islands for later meshlets)
+    // next seed is the triangle left on the border of previous meshlet with fewest free neighbors, index order when
+    // the border is empty
+    std::vector<GLuint> build_meshlets(const std::vector<float>& positions, const std::vector<GLuint>& indices, std::vector<Meshlet>& meshlets)
+    {
+        size_t vertex_count = positions.size() / 3;
+        size_t triangle_count = indices.size() / 3;
+
+        std::vector<glm::vec3> normals(triangle_count);
+        std::vector<glm::vec3> centers(triangle_count);
+        float edge_length = 0.0f; // average, scale of distances
+        for (size_t t = 0; t < triangle_count; t++) {
+            glm::vec3 p[3];
+            for (int c = 0; c < 3; c++) {
+                const float* position = &positions[3 * indices[3 * t + c]];
+                p[c] = glm::vec3(position[0], position[1], position[2]);
+            }
+            glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            float length = glm::length(normal);
+            normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            centers[t] = (p[0] + p[1] + p[2]) / 3.0f;
+            edge_length += glm::length(p[1] - p[0]) / static_cast<float>(triangle_count);
+        }
+        edge_length = std::max(edge_length, 1e-20f);
+
+        // vertex -> triangles (compressed rows)
+        std::vector<GLuint> offsets(vertex_count + 1, 0);
+        for (GLuint index : indices) {
+            offsets[index + 1]++;
+        }
+        for (size_t v = 0; v < vertex_count; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        std::vector<GLuint> adjacency(offsets[vertex_count]);
+        std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangle_count; t++) {
+            for (int c = 0; c < 3; c++) {
+                adjacency[fill[indices[3 * t + c]]++] = static_cast<GLuint>(t);
+            }
+        }
+
+        // stamps of current meshlet (vertex in meshlet, triangle in frontier)
+        const GLuint none = ~0u;
+        std::vector<GLuint> vertex_stamps(vertex_count, none);
+        std::vector<GLuint> frontier_stamps(triangle_count, none);
+        std::vector<uint8_t> assigned(triangle_count, 0);
+
+        std::vector<GLuint> result;
+        result.reserve(indices.size());
+
+        auto count_free_neighbors = [&](GLuint t) {
+            size_t count = 0;
+            for (int c = 0; c < 3; c++) {
+                GLuint vertex = indices[3 * t + c];
+                for (GLuint i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+                    count += assigned[adjacency[i]] ? 0 : 1;
+                }
+            }
+            return count;
+        };
+
+        std::vector<GLuint> triangles;
+        std::vector<GLuint> frontier;
+        size_t next_index_seed = 0;
+
+        while (true) {
+            size_t seed = triangle_count;
+            size_t seed_neighbors = ~size_t(0);
+            for (GLuint t : frontier) {
+                size_t neighbors = assigned[t] ? ~size_t(0) : count_free_neighbors(t);
+                if (neighbors < seed_neighbors) {
+                    seed_neighbors = neighbors;
+                    seed = t;
+                }
+            }
+
+            if (seed == triangle_count) {
+                while (next_index_seed < triangle_count && assigned[next_index_seed]) {
+                    next_index_seed++;
+                }
+                if (next_index_seed == triangle_count) {
+                    break;
+                }
+                seed = next_index_seed;
+            }
+
+            GLuint stamp = static_cast<GLuint>(meshlets.size());
+            glm::vec3 normal_sum(0.0f);
+            glm::vec3 center_sum(0.0f);
+            triangles.clear();
+            frontier.clear();
+
+            auto add_triangle = [&](GLuint t) {
+                assigned[t] = 1;
+                triangles.push_back(t);
+                normal_sum += normals[t];
+                center_sum += centers[t];
+                for (int c = 0; c < 3; c++) {
+                    GLuint vertex = indices[3 * t + c];
+                    vertex_stamps[vertex] = stamp;
+                    for (GLuint i = offsets[vertex]; i < offsets[vertex + 1]; i++) {
+                        GLuint neighbor = adjacency[i];
+                        if (!assigned[neighbor] && frontier_stamps[neighbor] != stamp) {
+                            frontier_stamps[neighbor] = stamp;
+                            frontier.push_back(neighbor);
+                        }
+                    }
+                }
+            };
+
+            add_triangle(static_cast<GLuint>(seed));
+            while (triangles.size() < MeshletMesh::MAX_TRIANGLES) {
+                float best_score = -1e30f;
+                size_t best = frontier.size();
+                glm::vec3 axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::vec3(0.0f);
+                glm::vec3 center = center_sum / static_cast<float>(triangles.size());
+                float spread = std::sqrt(static_cast<float>(triangles.size())) * edge_length; // expected meshlet radius
+
+                for (size_t i = 0; i < frontier.size();) {
+                    GLuint t = frontier[i];
+                    if (assigned[t]) {
+                        frontier[i] = frontier.back();
+                        frontier.pop_back();
+                        continue;
+                    }
+
+                    int shared = 0;
+                    for (int c = 0; c < 3; c++) {
+                        shared += vertex_stamps[indices[3 * t + c]] == stamp ? 1 : 0;
+                    }
+                    float score = static_cast<float>(shared) + glm::dot(normals[t], axis) - DISTANCE_WEIGHT * glm::length(centers[t] - center) / spread
+                                  - FREE_NEIGHBOR_WEIGHT * static_cast<float>(count_free_neighbors(t));
+                    if (score > best_score) {
+                        best_score = score;
+                        best = i;
+                    }
+                    i++;
+                }
+
+                if (best == frontier.size()) {
+                    break; // no neighbor left (small islands give small meshlets)
+                }
+
+                GLuint t = frontier[best];
+                frontier[best] = frontier.back();
+                frontier.pop_back();
+                add_triangle(t);
+            }
+
+            // bounds - sphere around aabb center, cone of face normals
+            glm::vec3 aabb_min(1e30f);
+            glm::vec3 aabb_max(-1e30f);
+            for (GLuint t : triangles) {
+                for (int c = 0; c < 3; c++) {
+                    const float* p = &positions[3 * indices[3 * t + c]];
+                    aabb_min = glm::min(aabb_min, glm::vec3(p[0], p[1], p[2]));
+                    aabb_max = glm::max(aabb_max, glm::vec3(p[0], p[1], p[2]));
+                }
+            }
+
+            Meshlet meshlet;
+            meshlet.center = (aabb_min + aabb_max) * 0.5f;
+            meshlet.radius = 0.0f;
+            for (GLuint t : triangles) {
+                for (int c = 0; c < 3; c++) {
+                    const float* p = &positions[3 * indices[3 * t + c]];
+                    meshlet.radius = std::max(meshlet.radius, glm::length(glm::vec3(p[0], p[1], p[2]) - meshlet.center));
+                }
+            }
+
+            meshlet.cone_axis = glm::length(normal_sum) > 0.0f ? glm::normalize(normal_sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+            float min_dot = 1.0f;
+            for (GLuint t : triangles) {
+                if (normals[t] != glm::vec3(0.0f)) {
+                    min_dot = std::min(min_dot, glm::dot(normals[t], meshlet.cone_axis));
+                }
+            }
+            meshlet.cone_cutoff = min_dot > 0.0f ? std::sqrt(1.0f - min_dot * min_dot) : 1.0f;
+
+            meshlet.first_index = static_cast<GLuint>(result.size());
+            meshlet.index_count = static_cast<GLuint>(3 * triangles.size());
+            meshlet.padding[0] = 0;
+            meshlet.padding[1] = 0;
+            meshlets.push_back(meshlet);
+
+            for (GLuint t : triangles) {
+                result.insert(result.end(), &indices[3 * t], &indices[3 * t] + 3);
+            }
+        }
+
+        return result;
+    }
+} // namespace
+
+
+
+//  ===============================================  MeshletMesh  ===============================================
+
+MeshletMesh::MeshletMesh()
+    : index_count(0), vertex_buffer(0), index_buffer(0), meshlet_buffer(0), output_index_buffers{ 0, 0 }, command_buffer(0), vaos{ 0, 0 },
+      visible_index_count{ 0, 0 }
+{}
+
+MeshletMesh::MeshletMesh(const Geometry& geometry) : MeshletMesh()
+{
+    const size_t vertex_size = 8; // floats: position (3), normal (3), tex coord (2)
+    size_t vertex_count = geometry.positions.size() / 3;
+
+    std::vector<float> vertices;
+    vertices.reserve(vertex_size * vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        for (size_t c = 0; c < 3; c++) {
+            vertices.push_back(geometry.positions[3 * v + c]);
+        }
+        for (size_t c = 0; c < 3; c++) {
+            vertices.push_back(3 * v + c < geometry.normals.size() ? geometry.normals[3 * v + c] : 0.0f);
+        }
+        for (size_t c = 0; c < 2; c++) {
+            vertices.push_back(2 * v + c < geometry.tex_coords.size() ? geometry.tex_coords[2 * v + c] : 0.0f);
+        }
+    }
+
+    std::vector<GLuint> source_indices(geometry.indices.begin(), geometry.indices.end());
+    if (source_indices.empty()) {
+        for (size_t v = 0; v < vertex_count; v++) {
+            source_indices.push_back(static_cast<GLuint>(v));
+        }
+    }
+    source_indices.resize(source_indices.size() / 3 * 3);
+
+    std::vector<GLuint> indices = build_meshlets(geometry.positions, source_indices, meshlets);
+    index_count = indices.size();
+    if (meshlets.empty()) {
+        return;
+    }
+
+    glCreateBuffers(1, &vertex_buffer);
+    glNamedBufferStorage(vertex_buffer, sizeof(float) * vertices.size(), vertices.data(), 0);
+    glCreateBuffers(1, &index_buffer);
+    glNamedBufferStorage(index_buffer, sizeof(GLuint) * indices.size(), indices.data(), 0);
+    glCreateBuffers(1, &meshlet_buffer);
+    glNamedBufferStorage(meshlet_buffer, sizeof(Meshlet) * meshlets.size(), meshlets.data(), 0);
+
+    glCreateBuffers(OUTPUT_COUNT, output_index_buffers);
+    for (GLuint buffer : output_index_buffers) {
+        glNamedBufferStorage(buffer, sizeof(GLuint) * indices.size(), nullptr, 0);
+    }
+    glCreateBuffers(1, &command_buffer);
+    glNamedBufferStorage(command_buffer, sizeof(DrawCommand) * OUTPUT_COUNT, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    gpu_resources().add_buffer(vertex_buffer, "meshlet vertices");
+    gpu_resources().add_buffer(index_buffer, "meshlet indices");
+    gpu_resources().add_buffer(meshlet_buffer, "meshlets");
+    gpu_resources().add_buffer(output_index_buffers[0], "meshlet visible indices (normal)");
+    gpu_resources().add_buffer(output_index_buffers[1], "meshlet visible indices (mirror)");
+    gpu_resources().add_buffer(command_buffer, "meshlet commands");
+
+    for (GpuReadback& readback : readbacks) {
+        readback = GpuReadback(sizeof(GLuint));
+    }
+
+    // locations 0, 1, 2 as in object shaders (position, normal, tex coord)
+    glCreateVertexArrays(OUTPUT_COUNT, vaos);
+    for (size_t output = 0; output < OUTPUT_COUNT; output++) {
+        glVertexArrayVertexBuffer(vaos[output], 0, vertex_buffer, 0, static_cast<GLsizei>(sizeof(float) * vertex_size));
+        glVertexArrayElementBuffer(vaos[output], output_index_buffers[output]);
+
+        const GLint sizes[3] = { 3, 3, 2 };
+        GLuint offset = 0;
+        for (GLuint location = 0; location < 3; location++) {
+            glEnableVertexArrayAttrib(vaos[output], location);
+            glVertexArrayAttribFormat(vaos[output], location, sizes[location], GL_FLOAT, GL_FALSE, offset);
+            glVertexArrayAttribBinding(vaos[output], location, 0);
+            offset += sizeof(float) * sizes[location];
+        }
+    }
+}
+
+void MeshletMesh::cull(const Program& program, const GpuCulling& culling, const glm::mat4& model, size_t output, const glm::mat4 view_projections[],
+                       const glm::vec3 eye_positions[], size_t view_count, bool occlusion, bool backface)
+{
+    if (meshlets.empty()) {
+        return;
+    }
+
+    GLintptr command_offset = static_cast<GLintptr>(sizeof(DrawCommand) * output);
+
+    // count of a finished earlier cull of this output (copies are fenced, never waits for gpu)
+    readbacks[output].read(&visible_index_count[output]);
+
+    // indices are appended by atomics to count
+    DrawCommand command = { 0, static_cast<GLuint>(view_count), 0, 0, 0 };
+    glNamedBufferSubData(command_buffer, command_offset, sizeof(DrawCommand), &command);
+
+    program.use();
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshlet_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, index_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, output_index_buffers[output]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, command_buffer);
+
+    glBindTextureUnit(0, culling.hiz_texture);
+
+    program.uniform(0, static_cast<unsigned int>(meshlets.size()));
+    program.uniform(1, static_cast<unsigned int>(output));
+    program.uniform(2, static_cast<int>(view_count));
+    program.uniform(3, culling.frustum_culling);
+    program.uniform(4, backface);
+    program.uniform(5, culling.occlusion_culling && occlusion && culling.hiz_valid && view_count == 1);
+    program.uniform(6, static_cast<int>(culling.hiz_level_count));
+    program.uniform(7, culling.hiz_view_projection);
+    program.uniform(8, model);
+    program.uniform(9, glm::mat4(glm::transpose(glm::inverse(glm::mat3(model)))));
+    for (size_t view = 0; view < view_count; view++) {
+        program.uniform(static_cast<int>(10 + view), eye_positions[view]);
+        program.uniform(static_cast<int>(12 + view), view_projections[view]);
+    }
+
+    // one work group per meshlet (y for counts over dispatch limit)
+    GLuint group_count_x = static_cast<GLuint>(std::min<size_t>(meshlets.size(), 65535));
+    GLuint group_count_y = static_cast<GLuint>((meshlets.size() + group_count_x - 1) / group_count_x);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+    glDispatchCompute(group_count_x, group_count_y, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    readbacks[output].copy(command_buffer, command_offset);
+}
+
+void MeshletMesh::draw(size_t output) const
+{
+    if (meshlets.empty()) {
+        return;
+    }
+
+    glBindVertexArray(vaos[output]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(sizeof(DrawCommand) * output));
+}
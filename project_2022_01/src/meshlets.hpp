@@ -0,0 +1,68 @@
+#pragma once
+
+#include "gpu_culling.hpp"
+#include "gpu_readback.hpp"
+#include "program.hpp"
+#include "scene_object.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+
+// cluster of up to MAX_TRIANGLES spatially close triangles, layout matches Meshlet in meshlet_cull.comp (std430)
+struct Meshlet
+{
+    glm::vec3 center; // bounding sphere, model space
+    float radius;
+    glm::vec3 cone_axis; // average normal, model space
+    float cone_cutoff; // sin of cone half angle, 1 - normals spread over a hemisphere or more (never backfacing)
+    GLuint first_index;
+    GLuint index_count;
+    GLuint padding[2];
+};
+
+
+// mesh split into meshlets, drawn through per view index buffers compacted on gpu
+// meshlet_cull.comp culls meshlets (frustum, backface cone, hierarchical z of GpuCulling for the normal camera)
+// and appends indices of visible ones into the output of the view, draw is one glDrawElementsIndirect
+// (same vertex layout as Geometry, so the object shaders are used unchanged)
+struct MeshletMesh
+{
+    static_assert(sizeof(Meshlet) == 48, "incorrect Meshlet layout");
+
+    static const size_t MAX_TRIANGLES = 128;
+    static const size_t OUTPUT_COUNT = 2; // normal, mirror
+
+    std::vector<Meshlet> meshlets;
+    size_t index_count;
+
+    GLuint vertex_buffer; // position (3), normal (3), tex coord (2)
+    GLuint index_buffer; // meshlet order
+    GLuint meshlet_buffer;
+
+    // per output
+    GLuint output_index_buffers[OUTPUT_COUNT];
+    GLuint command_buffer; // DrawCommand per output
+    GLuint vaos[OUTPUT_COUNT]; // vertex buffer + output indices
+
+    // stats (read back a few frames late without waiting for gpu)
+    GpuReadback readbacks[OUTPUT_COUNT]; // count of command of each output
+    GLuint visible_index_count[OUTPUT_COUNT];
+
+
+    MeshletMesh();
+    // triangles, non-indexed geometry gets sequential indices
+    MeshletMesh(const Geometry& geometry);
+
+    // triangles visible in any of views [0, view_count) are written to output, draw has view_count instances (layered)
+    // frustum and occlusion settings are taken from culling, occlusion is tested only for a single view which rendered
+    // the hierarchical z of culling (normal camera)
+    // backface - scene is drawn without face culling, holes in open meshes may show back faces culled by cones
+    void cull(const Program& program, const GpuCulling& culling, const glm::mat4& model, size_t output, const glm::mat4 view_projections[],
+              const glm::vec3 eye_positions[], size_t view_count, bool occlusion, bool backface);
+
+    // program and model are expected to be bound
+    void draw(size_t output) const;
+};
@@ -0,0 +1,136 @@
+#include "sub_bursts.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <limits>
+#include <vector>
+
+
+
+// std430 layout of emitter and particle (see sub_burst_emit.comp)
+static const size_t EMITTER_SIZE = 4 * 4 * sizeof(float);
+static const size_t PARTICLE_SIZE = 3 * 4 * sizeof(float);
+static const size_t QUEUE_HEADER_SIZE = 4 * sizeof(GLuint);
+
+
+
+//  ===============================================  SubBursts  ===============================================
+
+SubBursts::SubBursts() = default;
+
+SubBursts::SubBursts(size_t max_emitter_count, size_t pool_size) : max_emitter_count(max_emitter_count), pool_size(pool_size)
+{
+    glCreateBuffers(2, queue_buffers);
+    for (int i = 0; i < 2; i++) {
+        glNamedBufferStorage(queue_buffers[i], QUEUE_HEADER_SIZE + EMITTER_SIZE * max_emitter_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+
+    glCreateBuffers(1, &pool_buffer);
+    glNamedBufferStorage(pool_buffer, PARTICLE_SIZE * pool_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &pool_head_buffer);
+    glNamedBufferStorage(pool_head_buffer, sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateVertexArrays(1, &vao);
+
+    // smaller particles than parent, fade shrinks them, no blinking
+    FireworkParams params(0, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f, 0.3f, 1.0f, glm::vec3(1.0f), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.3f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f);
+    FireworkParamsGpu params_gpu(params);
+
+    glCreateBuffers(1, &render_params_buffer);
+    glNamedBufferStorage(render_params_buffer, sizeof(FireworkParamsGpu), &params_gpu, 0);
+
+    for (int i = 0; i < 2; i++) {
+        gpu_resources().add_buffer(queue_buffers[i], "sub-burst queue");
+    }
+    gpu_resources().add_buffer(pool_buffer, "sub-burst pool");
+    gpu_resources().add_buffer(pool_head_buffer, "sub-burst pool head");
+    gpu_resources().add_buffer(render_params_buffer, "sub-burst params");
+
+    append_queue = 0;
+
+    clear();
+}
+
+void SubBursts::emit(const Program& emit_program, float time) const
+{
+    GLuint queue = queue_buffers[1 - append_queue];
+
+    emit_program.use();
+
+    emit_program.uniform(0, time);
+    emit_program.uniform(2, static_cast<unsigned int>(pool_size));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, queue);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, pool_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, pool_head_buffer);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, queue);
+    glDispatchComputeIndirect(0);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // consumed - reset count (stays on gpu)
+    GLuint zero = 0;
+    glClearNamedBufferSubData(queue, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+}
+
+void SubBursts::bind_append_queue() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, QUEUE_BINDING, queue_buffers[append_queue]);
+}
+
+void SubBursts::update(const Program& update_program, float delta, float time, float gravity) const
+{
+    update_program.use();
+
+    update_program.uniform(0, delta);
+    update_program.uniform(1, time);
+    update_program.uniform(2, gravity);
+    update_program.uniform(3, static_cast<unsigned int>(pool_size));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, queue_buffers[append_queue]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, pool_buffer);
+
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glDispatchCompute((pool_size - 1) / LOCAL_SIZE + 1, 1, 1);
+}
+
+void SubBursts::end_frame()
+{
+    append_queue = 1 - append_queue;
+}
+
+void SubBursts::render(const Program& program, float time) const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, render_params_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POOL_RENDER_BINDING, pool_buffer);
+
+    program.uniform(0, static_cast<unsigned int>(FireworkStage::FLYING2));
+    program.uniform(1, time);
+
+    glBindVertexArray(vao);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glDrawArrays(GL_POINTS, 0, pool_size);
+}
+
+void SubBursts::clear() const
+{
+    // queue header - dispatch command (0, 1, 1) + capacity
+    GLuint header[4] = { 0, 1, 1, static_cast<GLuint>(max_emitter_count) };
+    for (int i = 0; i < 2; i++) {
+        glNamedBufferSubData(queue_buffers[i], 0, sizeof(header), header);
+    }
+
+    // birth time = -inf - particles are dead (age > lifetime)
+    std::vector<float> particles(4 * 3 * pool_size, 0.0f);
+    for (size_t i = 0; i < pool_size; i++) {
+        particles[i * 12 + 3] = -std::numeric_limits<float>::infinity();
+    }
+    glNamedBufferSubData(pool_buffer, 0, PARTICLE_SIZE * pool_size, particles.data());
+
+    GLuint zero = 0;
+    glNamedBufferSubData(pool_head_buffer, 0, sizeof(GLuint), &zero);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "program.hpp"
+
+#include "../../common/program_cache.hpp"
+
+#include "firework.hpp"
+
+
+
+// child particles of multi-stage shells (crossette, pistil), fully on gpu
+// fireworks.comp appends emitters (particles bursting this frame) into emission queue
+// next frame the queue is consumed by indirect dispatch (one work group per emitter) which allocates child particles from shared ring pool
+// queue header is the dispatch command (emitter count, 1, 1), so cpu never reads how many shells burst
+// pool is updated and drawn with fixed size dispatch / draw, cpu cost doesn't depend on shells
+struct SubBursts
+{
+    static const unsigned int MAX_PARTICLES_PER_BURST = 256; // has to match sub_burst_emit.comp
+    static const unsigned int LOCAL_SIZE = 256; // has to match sub_burst_update.comp
+
+    static const GLuint QUEUE_BINDING = 9; // fireworks.comp
+    static const GLuint POOL_RENDER_BINDING = 10; // sub_burst_particle.vert
+
+    size_t max_emitter_count;
+    size_t pool_size;
+
+    GLuint queue_buffers[2]; // header (count, 1, 1, capacity) + emitters, one is appended while other is consumed
+    GLuint pool_buffer;
+    GLuint pool_head_buffer;
+
+    GLuint render_params_buffer; // FireworkParamsGpu - particle size, fade size (particle_textured.geom)
+
+    GLuint vao; // empty, particles are read from pool_buffer
+
+    size_t append_queue; // index of queue appended this frame
+
+
+    SubBursts();
+    SubBursts(size_t max_emitter_count, size_t pool_size);
+
+    // consumes queue filled in previous frame, call before fireworks update
+    // children are seeded by their emitter (parent firework seed and particle index)
+    void emit(const Program& emit_program, float time) const;
+
+    // queue for fireworks.comp
+    void bind_append_queue() const;
+
+    // simulates pool and clamps appended queue to its capacity, call after fireworks update
+    void update(const Program& update_program, float delta, float time, float gravity) const;
+
+    // swaps queues, call once per frame after update
+    void end_frame();
+
+    void render(const Program& program, float time) const;
+
+    // kills all child particles and clears queues
+    void clear() const;
+};
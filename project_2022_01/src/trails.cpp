@@ -0,0 +1,97 @@
+#include "trails.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+
+
+//  ===============================================  Trails  ===============================================
+
+Trails::Trails() = default;
+
+Trails::Trails(size_t capacity) : capacity(capacity)
+{
+    glCreateBuffers(1, &history_buffer);
+    glNamedBufferStorage(history_buffer, 4 * sizeof(float) * LENGTH * capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &info_buffer);
+    glNamedBufferStorage(info_buffer, 4 * sizeof(float) * capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    gpu_resources().add_buffer(history_buffer, "trail history");
+    gpu_resources().add_buffer(info_buffer, "trail info");
+
+    glCreateVertexArrays(1, &vao);
+
+    width = 0.05f;
+
+    clear();
+}
+
+int Trails::allocate(size_t count)
+{
+    if (count == 0 || count > capacity) {
+        return -1;
+    }
+
+    size_t first = alloc_head;
+    alloc_head = (alloc_head + count) % capacity;
+    used_count = std::min(used_count + count, capacity);
+
+    return static_cast<int>(first);
+}
+
+void Trails::advance(int step_count, float time)
+{
+    if (step_count <= 0) {
+        return;
+    }
+
+    head = (head + static_cast<unsigned int>(step_count)) % LENGTH;
+    write_time = time;
+}
+
+unsigned int Trails::get_head(int steps_before_end) const
+{
+    return (head + LENGTH - static_cast<unsigned int>(steps_before_end) % LENGTH) % LENGTH;
+}
+
+void Trails::bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, HISTORY_BINDING, history_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INFO_BINDING, info_buffer);
+}
+
+void Trails::render(const Program& program, float time) const
+{
+    if (used_count == 0) {
+        return;
+    }
+
+    bind();
+
+    program.uniform(0, time);
+    program.uniform(1, head);
+    program.uniform(3, width);
+
+    glBindVertexArray(vao);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * LENGTH, used_count);
+}
+
+void Trails::clear()
+{
+    // last write = -inf - all trails are stale
+    std::vector<float> info(4 * capacity, 0.0f);
+    for (size_t i = 0; i < capacity; i++) {
+        info[i * 4 + 3] = -std::numeric_limits<float>::infinity();
+    }
+    glNamedBufferSubData(info_buffer, 0, 4 * sizeof(float) * capacity, info.data());
+
+    alloc_head = 0;
+    used_count = 0;
+    head = 0;
+    write_time = 0.0f;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "program.hpp"
+
+#include "../../common/program_cache.hpp"
+
+
+
+// trails of firework particles - last LENGTH positions of each particle in gpu ring buffers
+// fireworks.comp writes position of each particle after every simulation step into ring slot of the step, so history is never shifted or copied
+// trails are allocated from one shared pool (ring - when exhausted, oldest trails are overwritten), fireworks keep their first trail index
+// all trails are drawn with one instanced draw (ribbon per trail), trails which weren't written recently collapse in vertex shader
+struct Trails
+{
+    static const unsigned int LENGTH = 8; // has to match trail.vert
+
+    static const GLuint HISTORY_BINDING = 11; // fireworks.comp, trail.vert
+    static const GLuint INFO_BINDING = 12; // fireworks.comp, trail.vert
+
+    size_t capacity; // number of trails
+
+    GLuint history_buffer; // vec4 (position, intensity) * LENGTH per trail
+    GLuint info_buffer; // vec4 (color, time of last write) per trail
+
+    GLuint vao; // empty, trails are read from buffers
+
+    size_t alloc_head; // next trail to allocate
+    size_t used_count; // trails ever allocated (clamped to capacity), drawn instances
+    unsigned int head; // ring index of last simulation step
+    float write_time; // global time of last simulation step
+
+    float width;
+
+
+    Trails();
+    Trails(size_t capacity);
+
+    // returns first trail of count consecutive trails (indices wrap around capacity)
+    int allocate(size_t count);
+
+    // moves ring head by simulation steps of this frame (one sample per step), call before fireworks update
+    void advance(int step_count, float time);
+
+    // ring index of the step which is steps_before_end steps before the last step of this frame
+    unsigned int get_head(int steps_before_end) const;
+
+    // buffers for fireworks.comp, trail uniforms are set by caller
+    void bind() const;
+
+    void render(const Program& program, float time) const;
+
+    // forgets all trails
+    void clear();
+};
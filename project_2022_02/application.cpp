@@ -1,16 +1,27 @@
 #include "application.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <map>
+#include <thread>
 
 
 
 Application::Application(int initial_width, int initial_height, std::vector<std::string> arguments) : PV227Application(initial_width, initial_height, arguments)
 {
+    program_cache.set_folder(lecture_folder_path / "shader_cache");
     Application::compile_shaders();
+    program_cache.finish(); // first frame needs all programs
+
+    // one worker is left for render thread
+    unsigned int texture_thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    texture_streamer.emplace(texture_thread_count, lecture_folder_path / "texture_cache");
 
     reset_settings();
     do_reset_settings = false;
 
+    prepare_scene_fbo();
     prepare_snow_view();
     prepare_snow_accum();
     prepare_snow_shadowing();
@@ -19,9 +30,14 @@ Application::Application(int initial_width, int initial_height, std::vector<std:
     prepare_snow_plane_base();
     prepare_snow_particles();
     prepare_scene();
+    prepare_props();
     prepare_lights();
     prepare_camera();
 
+    show_profiler = false;
+    std::snprintf(profiler_trace_file, sizeof(profiler_trace_file), "trace.json");
+    std::snprintf(benchmark_file, sizeof(benchmark_file), "benchmark.csv");
+
     glEnable(GL_CULL_FACE);
 }
 
@@ -31,34 +47,113 @@ Application::~Application() {}
 //  ===============================================  init  ===============================================
 void Application::compile_shaders()
 {
-    default_unlit_program = ShaderProgram(lecture_shaders_path / "object.vert", lecture_shaders_path / "unlit.frag");
-    default_lit_program = ShaderProgram(lecture_shaders_path / "object.vert", lecture_shaders_path / "lit.frag");
+    // all programs are submitted first, misses compile in parallel, reload (not waiting) keeps old programs until new are linked
+    const std::filesystem::path& shaders = lecture_shaders_path;
+
+    program_cache.add(unlit_program, shaders / "object.vert", shaders / "unlit.frag");
+    program_cache.add(lit_program, shaders / "object.vert", shaders / "lit.frag");
+    program_cache.add(queue_lit_program, shaders / "object_queue.vert", shaders / "lit.frag");
+
+    program_cache.add(display_texture_program, shaders / "fullscreen_quad.vert", shaders / "display_texture.frag");
+
+    program_cache.add(snow_accum_update_program, shaders / "fullscreen_quad.vert", shaders / "update_snow.frag");
+    program_cache.add(snow_accum_blur_program, shaders / "fullscreen_quad.vert", shaders / "gauss_blur.frag");
+
+    program_cache.add(shadow_program, shaders / "no_frag.vert", shaders / "no_frag.frag");
+    program_cache.add(shadow_batch_program, shaders / "no_frag_batch.vert", shaders / "no_frag.frag");
+
+    program_cache.add(broom_pos_program, shaders / "object.vert", shaders / "1f.frag");
+
+    program_cache.add(snow_plane_program, { { GL_VERTEX_SHADER, shaders / "snow_plane.vert" },
+                                            { GL_TESS_CONTROL_SHADER, shaders / "snow_plane.tesc" },
+                                            { GL_TESS_EVALUATION_SHADER, shaders / "snow_plane.tese" },
+                                            { GL_FRAGMENT_SHADER, shaders / "snow_plane.frag" } });
 
-    display_texture_program = ShaderProgram(lecture_shaders_path / "fullscreen_quad.vert", lecture_shaders_path / "display_texture.frag");
+    program_cache.add(snow_particles_program, { { GL_VERTEX_SHADER, shaders / "snow.vert" },
+                                                { GL_GEOMETRY_SHADER, shaders / "snow.geom" },
+                                                { GL_FRAGMENT_SHADER, shaders / "snow.frag" } });
 
-    snow_accum_update_program = ShaderProgram(lecture_shaders_path / "fullscreen_quad.vert", lecture_shaders_path / "update_snow.frag");
-    snow_accum_blur_program = ShaderProgram(lecture_shaders_path / "fullscreen_quad.vert", lecture_shaders_path / "gauss_blur.frag");
+    program_cache.add_compute(snow_sort_keys_program, shaders / "snow_sort_keys.comp");
+    program_cache.add_compute(radix_histogram_program, shaders / "radix_histogram.comp");
+    program_cache.add_compute(radix_scan_program, shaders / "radix_scan.comp");
+    program_cache.add_compute(radix_scatter_program, shaders / "radix_scatter.comp");
 
-    shadow_program = ShaderProgram(lecture_shaders_path / "no_frag.vert", lecture_shaders_path / "no_frag.frag");
+    program_cache.add(snow_oit_composite_program, shaders / "fullscreen_quad.vert", shaders / "snow_oit_composite.frag");
+
+    program_cache.finish(false);
+}
 
-    broom_pos_program = ShaderProgram(lecture_shaders_path / "object.vert", lecture_shaders_path / "1f.frag");
 
-    snow_plane_program = ShaderProgram();
-    snow_plane_program.add_tess_control_shader(lecture_shaders_path / "snow_plane.tesc");
-    snow_plane_program.add_tess_evaluation_shader(lecture_shaders_path / "snow_plane.tese");
-    snow_plane_program.add_vertex_shader(lecture_shaders_path / "snow_plane.vert");
-    snow_plane_program.add_fragment_shader(lecture_shaders_path / "snow_plane.frag");
-    snow_plane_program.link();
+void Application::prepare_scene_fbo()
+{
+    glCreateFramebuffers(1, &scene_fbo);
+    glCreateFramebuffers(1, &snow_oit_fbo);
 
-    snow_particles_program = ShaderProgram();
-    snow_particles_program.add_vertex_shader(lecture_shaders_path / "snow.vert");
-    snow_particles_program.add_geometry_shader(lecture_shaders_path / "snow.geom");
-    snow_particles_program.add_fragment_shader(lecture_shaders_path / "snow.frag");
-    snow_particles_program.link();
+    scene_color_tex = 0;
+    scene_depth_tex = 0;
+    scene_depth_copy_tex = 0;
+    snow_oit_accum_tex = 0;
+    snow_oit_revealage_tex = 0;
 
-    std::cout << "shaders compiled\n";
+    resize_scene_fbo();
 }
 
+void Application::resize_scene_fbo()
+{
+    for (GLuint texture : { scene_color_tex, scene_depth_tex, scene_depth_copy_tex, snow_oit_accum_tex, snow_oit_revealage_tex }) {
+        gpu_resources().remove_texture(texture);
+    }
+
+    glDeleteTextures(1, &scene_color_tex);
+    glDeleteTextures(1, &scene_depth_tex);
+    glDeleteTextures(1, &scene_depth_copy_tex);
+    glDeleteTextures(1, &snow_oit_accum_tex);
+    glDeleteTextures(1, &snow_oit_revealage_tex);
+
+    // scene
+    glCreateTextures(GL_TEXTURE_2D, 1, &scene_color_tex);
+    glCreateTextures(GL_TEXTURE_2D, 1, &scene_depth_tex);
+
+    glTextureStorage2D(scene_color_tex, 1, GL_RGBA8, width, height);
+    glTextureStorage2D(scene_depth_tex, 1, GL_DEPTH_COMPONENT24, width, height);
+
+    TextureUtils::set_texture_2d_parameters(scene_color_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    TextureUtils::set_texture_2d_parameters(scene_depth_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+
+    gpu_resources().add_texture(scene_color_tex, "scene color");
+    gpu_resources().add_texture(scene_depth_tex, "scene depth");
+
+    glNamedFramebufferTexture(scene_fbo, GL_COLOR_ATTACHMENT0, scene_color_tex, 0);
+    glNamedFramebufferTexture(scene_fbo, GL_DEPTH_ATTACHMENT, scene_depth_tex, 0);
+    FBOUtils::check_framebuffer_status(scene_fbo, "scene framebuffer");
+
+    // soft particles - never attached, sampling an attachment of the bound framebuffer is a feedback loop
+    glCreateTextures(GL_TEXTURE_2D, 1, &scene_depth_copy_tex);
+    glTextureStorage2D(scene_depth_copy_tex, 1, GL_DEPTH_COMPONENT24, width, height);
+    TextureUtils::set_texture_2d_parameters(scene_depth_copy_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    gpu_resources().add_texture(scene_depth_copy_tex, "scene depth copy");
+
+    // weighted oit (depth tested against scene depth)
+    glCreateTextures(GL_TEXTURE_2D, 1, &snow_oit_accum_tex);
+    glCreateTextures(GL_TEXTURE_2D, 1, &snow_oit_revealage_tex);
+
+    glTextureStorage2D(snow_oit_accum_tex, 1, GL_RGBA16F, width, height);
+    glTextureStorage2D(snow_oit_revealage_tex, 1, GL_R16F, width, height);
+
+    TextureUtils::set_texture_2d_parameters(snow_oit_accum_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    TextureUtils::set_texture_2d_parameters(snow_oit_revealage_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+
+    gpu_resources().add_texture(snow_oit_accum_tex, "snow oit accumulation");
+    gpu_resources().add_texture(snow_oit_revealage_tex, "snow oit revealage");
+
+    glNamedFramebufferTexture(snow_oit_fbo, GL_COLOR_ATTACHMENT0, snow_oit_accum_tex, 0);
+    glNamedFramebufferTexture(snow_oit_fbo, GL_COLOR_ATTACHMENT1, snow_oit_revealage_tex, 0);
+    glNamedFramebufferTexture(snow_oit_fbo, GL_DEPTH_ATTACHMENT, scene_depth_tex, 0);
+
+    const GLenum oit_draw_buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glNamedFramebufferDrawBuffers(snow_oit_fbo, 2, oit_draw_buffers);
+    FBOUtils::check_framebuffer_status(snow_oit_fbo, "snow oit framebuffer");
+}
 
 void Application::prepare_snow_view()
 {
@@ -82,6 +177,9 @@ void Application::prepare_snow_accum()
     TextureUtils::set_texture_2d_parameters(snow_accum_tex_a, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
     TextureUtils::set_texture_2d_parameters(snow_accum_tex_b, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
 
+    gpu_resources().add_texture(snow_accum_tex_a, "snow accumulation");
+    gpu_resources().add_texture(snow_accum_tex_b, "snow accumulation");
+
     // snow accumulation framebuffers
     glCreateFramebuffers(1, &snow_accum_fbo_a);
     glCreateFramebuffers(1, &snow_accum_fbo_b);
@@ -99,6 +197,7 @@ void Application::prepare_snow_shadowing()
     glCreateTextures(GL_TEXTURE_2D, 1, &snow_shadow_tex);
     glTextureStorage2D(snow_shadow_tex, 1, GL_DEPTH_COMPONENT24, snow_view_tex_size, snow_view_tex_size);
     TextureUtils::set_texture_2d_parameters(snow_shadow_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    gpu_resources().add_texture(snow_shadow_tex, "snow shadow");
 
     glCreateFramebuffers(1, &snow_shadow_fbo);
     glNamedFramebufferTexture(snow_shadow_fbo, GL_DEPTH_ATTACHMENT, snow_shadow_tex, 0);
@@ -111,8 +210,7 @@ void Application::prepare_broom()
     broom_center = glm::vec2(0.0f);
 
     // broom object
-    broom_tex = TextureUtils::load_texture_2d(lecture_textures_path / "wood.jpg");
-    TextureUtils::set_texture_2d_parameters(broom_tex, GL_REPEAT, GL_REPEAT, GL_LINEAR, GL_LINEAR);
+    broom_tex = texture_streamer->load(lecture_textures_path / "wood.jpg", TextureFormat::BC1, glm::u8vec4(120, 80, 45, 255));
 
     Geometry broom = Geometry::from_file(lecture_folder_path / "models/broom.obj");
     broom_object = SceneObject(broom, ModelUBO(), white_material_ubo, broom_tex);
@@ -121,6 +219,7 @@ void Application::prepare_broom()
     glCreateTextures(GL_TEXTURE_2D, 1, &broom_pos_tex);
     glTextureStorage2D(broom_pos_tex, 1, GL_R32F, snow_view_tex_size, snow_view_tex_size);
     TextureUtils::set_texture_2d_parameters(broom_pos_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+    gpu_resources().add_texture(broom_pos_tex, "broom position");
 
     glCreateFramebuffers(1, &broom_pos_fbo);
     glNamedFramebufferTexture(broom_pos_fbo, GL_COLOR_ATTACHMENT0, broom_pos_tex, 0);
@@ -128,15 +227,18 @@ void Application::prepare_broom()
 
 void Application::prepare_snow_plane()
 {
-    snow_albedo_tex = TextureUtils::load_texture_2d(lecture_textures_path / "snow_albedo.png");
-    snow_normal_tex = TextureUtils::load_texture_2d(lecture_textures_path / "snow_normal.png");
-    snow_height_tex = TextureUtils::load_texture_2d(lecture_textures_path / "snow_height.png");
-    snow_roughness_tex = TextureUtils::load_texture_2d(lecture_textures_path / "snow_roughness.png");
+    // placeholders: white snow, flat normal (xy only, z is reconstructed in snow_plane.frag), zero height + mid roughness
+    snow_albedo_tex = texture_streamer->load(lecture_textures_path / "snow_albedo.png", TextureFormat::BC1, glm::u8vec4(235, 240, 245, 255));
+    snow_normal_tex = texture_streamer->load(lecture_textures_path / "snow_normal.png", TextureFormat::BC5, glm::u8vec4(128, 128, 255, 255));
+    snow_surface_tex = texture_streamer->load_packed({ lecture_textures_path / "snow_height.png", lecture_textures_path / "snow_roughness.png" },
+                                                     TextureFormat::BC5, glm::u8vec4(0, 128, 0, 255));
 
-    TextureUtils::set_texture_2d_parameters(snow_albedo_tex, GL_REPEAT, GL_REPEAT, GL_LINEAR, GL_LINEAR);
-    TextureUtils::set_texture_2d_parameters(snow_normal_tex, GL_REPEAT, GL_REPEAT, GL_LINEAR, GL_LINEAR);
-    TextureUtils::set_texture_2d_parameters(snow_height_tex, GL_REPEAT, GL_REPEAT, GL_LINEAR, GL_LINEAR);
-    TextureUtils::set_texture_2d_parameters(snow_roughness_tex, GL_REPEAT, GL_REPEAT, GL_LINEAR, GL_LINEAR);
+    // handles are written by update_snow_material
+    glCreateBuffers(1, &snow_material_buffer);
+    glNamedBufferStorage(snow_material_buffer, sizeof(GLuint64) * 3, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    gpu_resources().add_buffer(snow_material_buffer, "snow material handles");
+
+    snow_material_handles_ready = false;
 
     snow_material_ubo.set_material(PhongMaterialData(glm::vec3(0.1f), glm::vec3(0.9f), true, glm::vec3(0.1), 2.0f));
     snow_material_ubo.update_opengl_data();
@@ -150,6 +252,7 @@ void Application::prepare_snow_plane_base()
     glCreateTextures(GL_TEXTURE_2D, 1, &snow_plane_base_tex);
     glTextureStorage2D(snow_plane_base_tex, 1, GL_DEPTH_COMPONENT24, snow_view_tex_size, snow_view_tex_size);
     TextureUtils::set_texture_2d_parameters(snow_plane_base_tex, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+    gpu_resources().add_texture(snow_plane_base_tex, "snow plane base");
 
     glCreateFramebuffers(1, &snow_plane_base_fbo);
     glNamedFramebufferTexture(snow_plane_base_fbo, GL_DEPTH_ATTACHMENT, snow_plane_base_tex, 0);
@@ -164,8 +267,19 @@ void Application::prepare_snow_particles()
     reload_snow_particles(true);
 
     // snow particle texture
-    snow_particle_tex = TextureUtils::load_texture_2d(lecture_textures_path / "star.png");
-    TextureUtils::set_texture_2d_parameters(snow_particle_tex, GL_REPEAT, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR);
+    snow_particle_tex = texture_streamer->load(lecture_textures_path / "star.png", TextureFormat::BC4, glm::u8vec4(0, 0, 0, 255));
+
+    // timing
+    glCreateQueries(GL_TIMESTAMP, 4, snow_timer_queries);
+    snow_timers_issued = false;
+
+    snow_cpu_time_ms = 0.0f;
+    snow_sort_time_ms = 0.0f;
+    snow_draw_time_ms = 0.0f;
+    snow_composite_time_ms = 0.0f;
+
+    snow_benchmark_frame = -1;
+    snow_benchmark_done = false;
 }
 
 void Application::prepare_scene()
@@ -175,22 +289,63 @@ void Application::prepare_scene()
     brown_material_ubo.set_material(PhongMaterialData(brown_color * 0.1, brown_color * 0.9, true, glm::vec3(0.1), 2.0f));
     brown_material_ubo.update_opengl_data();
     
-    outer_terrain_object = SceneObject(cube, ModelUBO(glm::translate(glm::vec3(0.0f, -0.08f, 0.0f)) * glm::scale(glm::vec3(13.0f, 0.1f, 13.0f))), brown_material_ubo);
-    castel_base_object = SceneObject(cube, ModelUBO(glm::translate(glm::vec3(0.0f, 0.05f, 0.0f)) * glm::scale(glm::vec3(3.8f, 0.1f, 3.8f))), brown_material_ubo);
+    outer_terrain_model = glm::translate(glm::vec3(0.0f, -0.08f, 0.0f)) * glm::scale(glm::vec3(13.0f, 0.1f, 13.0f));
+    outer_terrain_object = SceneObject(cube, ModelUBO(outer_terrain_model), brown_material_ubo);
+    castel_base_model = glm::translate(glm::vec3(0.0f, 0.05f, 0.0f)) * glm::scale(glm::vec3(3.8f, 0.1f, 3.8f));
+    castel_base_object = SceneObject(cube, ModelUBO(castel_base_model), brown_material_ubo);
 
     // lake
-    ice_albedo_tex = TextureUtils::load_texture_2d(lecture_textures_path / "ice_albedo.png");
-    TextureUtils::set_texture_2d_parameters(ice_albedo_tex, GL_REPEAT, GL_REPEAT, GL_LINEAR, GL_LINEAR);
+    ice_albedo_tex = texture_streamer->load(lecture_textures_path / "ice_albedo.png", TextureFormat::BC1, glm::u8vec4(170, 200, 225, 255));
 
-    lake_object = SceneObject(cube, ModelUBO(glm::translate(glm::vec3(0.0f, -0.05f, 0.0f)) * glm::scale(glm::vec3(12.f, 0.1f, 12.f))), blue_material_ubo, ice_albedo_tex);
+    lake_model = glm::translate(glm::vec3(0.0f, -0.05f, 0.0f)) * glm::scale(glm::vec3(12.f, 0.1f, 12.f));
+    lake_object = SceneObject(cube, ModelUBO(lake_model), blue_material_ubo, ice_albedo_tex);
 
     // castle
     glm::vec3 castle_color = glm::vec3(0.95f, 0.75f, 0.55f);
     castle_material_ubo.set_material(PhongMaterialData(castle_color * 0.1, castle_color * 0.9, true, glm::vec3(0.1), 2.0f));
     castle_material_ubo.update_opengl_data();
 
-    Geometry castle = Geometry::from_file(lecture_folder_path / "models/castle.obj");
-    castle_object = SceneObject(castle, ModelUBO(glm::translate(glm::vec3(0.0f, 1.06f, 0.0f)) * glm::scale(glm::vec3(7.f, 7.f, 7.f))), castle_material_ubo);
+    castle_model = glm::translate(glm::vec3(0.0f, 1.06f, 0.0f)) * glm::scale(glm::vec3(7.f, 7.f, 7.f));
+
+    std::filesystem::path castle_path = lecture_folder_path / "models/castle.obj";
+    std::vector<MeshLod> lods = load_mesh_lods(castle_path, { 0.5f, 0.25f, 0.1f }, lecture_folder_path / "mesh_cache");
+
+    castle_lod_errors.assign(CASTLE_LOD_COUNT, 0.0f);
+    if (lods.size() == CASTLE_LOD_COUNT) {
+        for (int i = 0; i < CASTLE_LOD_COUNT; i++) {
+            Geometry castle = make_geometry(lods[i].mesh);
+            castle_lods[i] = SceneObject(castle, ModelUBO(castle_model), castle_material_ubo);
+            castle_lod_errors[i] = lods[i].error;
+            castle_lod_triangles[i] = castle.draw_elements_count / 3;
+            castle_lod_cache[i][0] = lods[i].cache_before;
+            castle_lod_cache[i][1] = lods[i].cache_after;
+        }
+    } else {
+        // all levels share the original (fallback loader)
+        Geometry castle = load_obj_geometry(castle_path);
+        for (int i = 0; i < CASTLE_LOD_COUNT; i++) {
+            castle_lods[i] = SceneObject(castle, ModelUBO(castle_model), castle_material_ubo);
+            castle_lod_triangles[i] = castle.draw_elements_count / 3;
+        }
+    }
+    castle_lod = 0;
+
+    // static batch
+    castle_batch_lod = -1;
+    reload_static_batch();
+}
+
+void Application::prepare_props()
+{
+    prop_objects[0] = SceneObject(cube, ModelUBO(), brown_material_ubo);
+    prop_objects[1] = SceneObject(cube, ModelUBO(), castle_material_ubo);
+    prop_objects[2] = SceneObject(cube, ModelUBO(), blue_material_ubo, ice_albedo_tex);
+    prop_objects[3] = SceneObject(sphere, ModelUBO(), white_material_ubo);
+
+    // scene objects + props
+    scene_queue = RenderQueue(MAX_PROP_COUNT + 4);
+
+    reload_props();
 }
 
 void Application::prepare_lights()
@@ -224,6 +379,17 @@ void Application::reset_settings()
     snow_plane_tess_factor = 100.0f;
     
     snow_particles_count_target = 2048;
+    snow_transparency = SnowTransparency::UNSORTED;
+    use_soft_particles = false;
+    soft_particles_distance = 1.5f;
+
+    prop_count_target = 0;
+    use_static_batch = true;
+    use_bindless_materials = true;
+
+    castle_forced_lod = -1;
+    castle_lod_max_pixels = 1.0f;
+    castle_depth_lod = 2;
 
     light_angle = glm::radians(180.0f);
 
@@ -249,12 +415,18 @@ void Application::reload_snow_particles(bool first)
     }
 
     if (!first) {
+        gpu_resources().remove_buffer(snow_particles_pos_buffer);
         glDeleteBuffers(1, &snow_particles_pos_buffer);
         glDeleteVertexArrays(1, &snow_particles_vao);
+        snow_sort.destroy();
     }
 
+    // sorted indices are used as element buffer
+    snow_sort = GpuRadixSort(snow_particles_count);
+
     glCreateBuffers(1, &snow_particles_pos_buffer);
     glNamedBufferStorage(snow_particles_pos_buffer, sizeof(float) * 3 * snow_particles_count, snow_particles_pos.data(), 0);
+    gpu_resources().add_buffer(snow_particles_pos_buffer, "snow particle positions");
 
     glCreateVertexArrays(1, &snow_particles_vao);
     glVertexArrayVertexBuffer(snow_particles_vao, Geometry_Base::DEFAULT_POSITION_LOC, snow_particles_pos_buffer, 0, 3 * sizeof(float));
@@ -262,17 +434,75 @@ void Application::reload_snow_particles(bool first)
     glEnableVertexArrayAttrib(snow_particles_vao, Geometry_Base::DEFAULT_POSITION_LOC);
     glVertexArrayAttribFormat(snow_particles_vao, Geometry_Base::DEFAULT_POSITION_LOC, 3, GL_FLOAT, GL_FALSE, 0);
     glVertexArrayAttribBinding(snow_particles_vao, Geometry_Base::DEFAULT_POSITION_LOC, Geometry_Base::DEFAULT_POSITION_LOC);
+
+    glVertexArrayElementBuffer(snow_particles_vao, snow_sort.get_values());
+}
+
+void Application::reload_static_batch()
+{
+    if (castle_batch_lod >= 0) {
+        static_batch.destroy();
+    }
+
+    castle_batch_lod = castle_depth_lod;
+    static_batch = StaticBatch({ &cube, &cube, &cube, &castle_lods[castle_batch_lod].get_geometry() }, { outer_terrain_model, lake_model, castel_base_model, castle_model });
+}
+
+void Application::reload_props()
+{
+    prop_count = prop_count_target;
+
+    prop_kinds.resize(prop_count);
+    prop_models.resize(prop_count);
+
+    float rand_max = static_cast<float>(RAND_MAX);
+
+    for (int i = 0; i < prop_count; i++) {
+        float r1 = static_cast<float>(rand()) / rand_max;
+        float r2 = static_cast<float>(rand()) / rand_max;
+        float r3 = static_cast<float>(rand()) / rand_max;
+        float r4 = static_cast<float>(rand()) / rand_max;
+
+        // outside of castle base, on top of lake / terrain
+        glm::vec3 position((r1 - 0.5f) * 25.0f, 0.0f, (r2 - 0.5f) * 25.0f);
+        if (glm::abs(position.x) < 4.0f && glm::abs(position.z) < 4.0f) {
+            position.x = glm::sign(position.x) * (4.0f + glm::abs(position.x));
+        }
+
+        float size = 0.05f + 0.15f * r3;
+        position.y = 0.05f + size;
+
+        prop_kinds[i] = rand() % PROP_KIND_COUNT;
+        prop_models[i] = glm::translate(position) * glm::rotate(glm::radians(360.0f * r4), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::scale(glm::vec3(size));
+    }
 }
 
 //  ===============================================  update  ===============================================
 void Application::update(float delta)
 {
+    // frame = update + render
+    profiler.begin_frame();
+
+    // streamed textures (binds pixel unpack buffer, so before state cache is reset)
+    texture_streamer->update();
+
+    // ImGui changed state since last frame
+    gl_state.invalidate();
+    gl_state.reset_counters();
+
+    // reloaded programs compiled in background
+    if (program_cache.is_pending()) {
+        program_cache.finish(false);
+    }
+
     if (do_reset_settings) {
         reset_settings();
     }
 
     PV227Application::update(delta);
 
+    update_snow_material();
+
     // camera
     glm::vec3 eye_position = camera.get_eye_position();
     camera_ubo.set_view(glm::lookAt(eye_position, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
@@ -307,18 +537,31 @@ void Application::update(float delta)
             reload_snow_particles();
         }
     }
+
+    if (prop_count != prop_count_target) {
+        reload_props();
+    }
+
+    if (castle_batch_lod != castle_depth_lod) {
+        reload_static_batch();
+        do_update_snow_shadow = true;
+    }
 }
 
 void Application::update_snow_accum(float delta)
 {
+    ProfilerScope scope(profiler, "update_snow_accum");
+
     // broom position texture
+    int zone = profiler.begin_zone("broom_position", true, true);
+
     glBindFramebuffer(GL_FRAMEBUFFER, broom_pos_fbo);
     glViewport(0, 0, snow_view_tex_size, snow_view_tex_size);
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    gl_state.disable(GL_DEPTH_TEST);
+    gl_state.disable(GL_BLEND);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl_state.polygon_mode(GL_FILL);
 
     if (broom_permanent && !clear_snow_accum) {
         glClear(0);
@@ -327,29 +570,33 @@ void Application::update_snow_accum(float delta)
         glClear(GL_COLOR_BUFFER_BIT);
     }
 
-    broom_pos_program.use();
+    gl_state.use_program(broom_pos_program);
 
-    top_camera_ubo.bind_buffer_base(CameraUBO::DEFAULT_CAMERA_BINDING);
-    broom_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
+    gl_state.bind_uniform_buffer(top_camera_ubo, CameraUBO::DEFAULT_CAMERA_BINDING);
+    gl_state.bind_uniform_buffer(broom_object.get_model_ubo(), ModelUBO::DEFAULT_MODEL_BINDING);
 
-    broom_object.get_geometry().bind_vao();
+    gl_state.bind_geometry(broom_object.get_geometry());
     broom_object.get_geometry().draw();
 
-    glEnable(GL_DEPTH_TEST);
+    gl_state.enable(GL_DEPTH_TEST);
+
+    profiler.end_zone(zone);
 
     // snow accumulation
+    zone = profiler.begin_zone("snow_accumulation", true, true);
+
     snow_accum_output_a = !snow_accum_output_a;
 
     glBindFramebuffer(GL_FRAMEBUFFER, snow_accum_output_a ? snow_accum_fbo_a : snow_accum_fbo_b);
     glViewport(0, 0, snow_view_tex_size, snow_view_tex_size);
 
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    gl_state.disable(GL_CULL_FACE);
+    gl_state.disable(GL_DEPTH_TEST);
+    gl_state.disable(GL_BLEND);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl_state.polygon_mode(GL_FILL);
 
-    snow_accum_update_program.use();
+    gl_state.use_program(snow_accum_update_program);
 
     size_t snow_particles_count_exp = static_cast<size_t>(log2(snow_particles_count) - 8);
     float snow_accum_vel = (0.04f + 0.05f * snow_particles_count_exp) / 1000.0f; // [todo]
@@ -358,104 +605,125 @@ void Application::update_snow_accum(float delta)
     snow_accum_update_program.uniform(1, clear_snow_accum);
     snow_accum_update_program.uniform(2, delta);
 
-    glBindTextureUnit(0, snow_accum_output_a ? snow_accum_tex_b : snow_accum_tex_a);
-    glBindTextureUnit(1, broom_pos_tex);
+    gl_state.bind_texture_unit(0, snow_accum_output_a ? snow_accum_tex_b : snow_accum_tex_a);
+    gl_state.bind_texture_unit(1, broom_pos_tex);
 
-    glBindVertexArray(empty_vao);
+    gl_state.bind_vertex_array(empty_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_DEPTH_TEST);
+    gl_state.enable(GL_CULL_FACE);
+    gl_state.enable(GL_DEPTH_TEST);
+
+    profiler.end_zone(zone);
 
     // snow accumulation blur
+    zone = profiler.begin_zone("snow_blur", true, true);
+
     snow_accum_output_a = !snow_accum_output_a;
 
     glBindFramebuffer(GL_FRAMEBUFFER, snow_accum_output_a ? snow_accum_fbo_a : snow_accum_fbo_b);
     glViewport(0, 0, snow_view_tex_size, snow_view_tex_size);
 
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    gl_state.disable(GL_CULL_FACE);
+    gl_state.disable(GL_DEPTH_TEST);
+    gl_state.disable(GL_BLEND);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl_state.polygon_mode(GL_FILL);
 
-    snow_accum_blur_program.use();
+    gl_state.use_program(snow_accum_blur_program);
 
     snow_accum_blur_program.uniform(0, snow_accum_blur_radius);
 
-    glBindTextureUnit(0, snow_accum_output_a ? snow_accum_tex_b : snow_accum_tex_a);
+    gl_state.bind_texture_unit(0, snow_accum_output_a ? snow_accum_tex_b : snow_accum_tex_a);
 
-    glBindVertexArray(empty_vao);
+    gl_state.bind_vertex_array(empty_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_DEPTH_TEST);
+    gl_state.enable(GL_CULL_FACE);
+    gl_state.enable(GL_DEPTH_TEST);
+
+    profiler.end_zone(zone);
 }
 
 void Application::update_snow_shadow()
 {
+    ProfilerScope scope(profiler, "update_snow_shadow", true, true);
+
     glBindFramebuffer(GL_FRAMEBUFFER, snow_shadow_fbo);
     glViewport(0, 0, snow_view_tex_size, snow_view_tex_size);
 
-    glEnable(GL_DEPTH_TEST);
+    gl_state.enable(GL_DEPTH_TEST);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl_state.polygon_mode(GL_FILL);
 
     glClearDepth(1.0);
     glClear(GL_DEPTH_BUFFER_BIT);
 
-    shadow_program.use();
-
-    top_camera_ubo.bind_buffer_base(CameraUBO::DEFAULT_CAMERA_BINDING);
-
-    outer_terrain_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    outer_terrain_object.get_geometry().bind_vao();
-    outer_terrain_object.get_geometry().draw();
-
-    lake_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    lake_object.get_geometry().bind_vao();
-    lake_object.get_geometry().draw();
+    gl_state.bind_uniform_buffer(top_camera_ubo, CameraUBO::DEFAULT_CAMERA_BINDING);
 
-    castel_base_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    castel_base_object.get_geometry().bind_vao();
-    castel_base_object.get_geometry().draw();
-
-    castle_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    castle_object.get_geometry().bind_vao();
-    castle_object.get_geometry().draw();
+    render_static_depth(static_batch.mesh_count);
 }
 
 void Application::update_snow_plane_base()
 {
+    ProfilerScope scope(profiler, "update_snow_plane_base", true, true);
+
     glBindFramebuffer(GL_FRAMEBUFFER, snow_plane_base_fbo);
     glViewport(0, 0, snow_view_tex_size, snow_view_tex_size);
 
-    glEnable(GL_DEPTH_TEST);
+    gl_state.enable(GL_DEPTH_TEST);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl_state.polygon_mode(GL_FILL);
 
     glClearDepth(1.0);
     glClear(GL_DEPTH_BUFFER_BIT);
 
-    shadow_program.use();
+    gl_state.bind_uniform_buffer(top_camera_ubo, CameraUBO::DEFAULT_CAMERA_BINDING);
 
-    top_camera_ubo.bind_buffer_base(CameraUBO::DEFAULT_CAMERA_BINDING);
+    render_static_depth(STATIC_GROUND_COUNT);
+}
 
-    outer_terrain_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    outer_terrain_object.get_geometry().bind_vao();
-    outer_terrain_object.get_geometry().draw();
+void Application::update_snow_material()
+{
+    if (snow_material_handles_ready || !texture_streamer->is_bindless_supported()) {
+        return;
+    }
 
-    lake_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    lake_object.get_geometry().bind_vao();
-    lake_object.get_geometry().draw();
+    // order has to match SnowMaterialBuffer (snow_plane.tese, snow_plane.frag)
+    GLuint64 handles[3] = { texture_streamer->get_handle(snow_albedo_tex), texture_streamer->get_handle(snow_normal_tex),
+                            texture_streamer->get_handle(snow_surface_tex) };
+    if (handles[0] == 0 || handles[1] == 0 || handles[2] == 0) {
+        return; // still streaming
+    }
 
-    castel_base_object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    castel_base_object.get_geometry().bind_vao();
-    castel_base_object.get_geometry().draw();
+    glNamedBufferSubData(snow_material_buffer, 0, sizeof(handles), handles);
+    snow_material_handles_ready = true;
+}
+
+void Application::render_static_depth(size_t count)
+{
+    if (use_static_batch) {
+        gl_state.use_program(shadow_batch_program);
+        static_batch.draw(gl_state, 0, count);
+        return;
+    }
+
+    // one draw per object (for comparison)
+    gl_state.use_program(shadow_program);
+
+    const SceneObject* objects[] = { &outer_terrain_object, &lake_object, &castel_base_object, &castle_lods[castle_depth_lod] };
+    for (size_t i = 0; i < count; i++) {
+        gl_state.bind_uniform_buffer(objects[i]->get_model_ubo(), ModelUBO::DEFAULT_MODEL_BINDING);
+        gl_state.bind_geometry(objects[i]->get_geometry());
+        objects[i]->get_geometry().draw();
+    }
 }
 
 void Application::update_broom_location()
 {
+    // reads depth back (synchronizes with gpu)
+    ProfilerScope scope(profiler, "update_broom_location");
+
     float clip_z = 0;
     glReadPixels(broom_center.x, broom_center.y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &clip_z);
 
@@ -477,59 +745,68 @@ void Application::render()
     glBeginQuery(GL_TIME_ELAPSED, render_time_query);
 
     // fbo
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_fbo);
     glViewport(0, 0, width, height);
 
-    glEnable(GL_DEPTH_TEST);
+    gl_state.enable(GL_DEPTH_TEST);
 
-    glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+    gl_state.polygon_mode(wireframe ? GL_LINE : GL_FILL);
 
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClearDepth(1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // uniforms
-    phong_lights_ubo.bind_buffer_base(PhongLightsUBO::DEFAULT_LIGHTS_BINDING);
-    camera_ubo.bind_buffer_base(CameraUBO::DEFAULT_CAMERA_BINDING);
-    top_camera_ubo.bind_buffer_base(4);
+    gl_state.bind_uniform_buffer(phong_lights_ubo, PhongLightsUBO::DEFAULT_LIGHTS_BINDING);
+    gl_state.bind_uniform_buffer(camera_ubo, CameraUBO::DEFAULT_CAMERA_BINDING);
+    gl_state.bind_uniform_buffer(top_camera_ubo, 4);
 
-    glBindTextureUnit(1, snow_accum_output_a ? snow_accum_tex_a : snow_accum_tex_b);
-    glBindTextureUnit(2, snow_shadow_tex);
+    gl_state.bind_texture_unit(1, snow_accum_output_a ? snow_accum_tex_a : snow_accum_tex_b);
+    gl_state.bind_texture_unit(2, snow_shadow_tex);
 
     // render objects
-    render_object(default_lit_program, outer_terrain_object);
-    render_object(default_lit_program, lake_object, 10);
-    render_object(default_lit_program, castel_base_object);
-    render_object(default_lit_program, castle_object);
+    int zone = profiler.begin_zone("render_objects", true, true);
+    render_scene_queue();
+    profiler.end_zone(zone);
 
     if (use_snow && show_snow_plane) {
         render_snow_plane();
     }
 
     update_broom_location();
-    render_object(default_lit_program, broom_object, 1.0f, false);
+    render_object(lit_program, broom_object, 1.0f, false);
 
-    render_object(default_unlit_program, light_object, 1.0f, false);
+    render_object(unlit_program, light_object, 1.0f, false);
 
+    snow_timers_issued = use_snow;
     if (use_snow) {
         render_snow_particles();
     }
 
+    // output
+    glBlitNamedFramebuffer(scene_fbo, 0, 0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
     // timing - end
     glEndQuery(GL_TIME_ELAPSED);
 
     // finish opengl
     glFinish();
 
+    read_snow_timers();
+    update_snow_benchmark();
+
     // timing
     GLuint64 render_time;
     glGetQueryObjectui64v(render_time_query, GL_QUERY_RESULT, &render_time);
     fps_gpu = 1000.f / (static_cast<float>(render_time) * 1e-6f);
+
+    profiler.end_frame();
 }
 
-void Application::render_object(const ShaderProgram& program, const SceneObject& object, float uv_multiplier, bool apply_snow)
+void Application::render_object(const Program& program, const SceneObject& object, float uv_multiplier, bool apply_snow)
 {
-    program.use();
+    gl_state.use_program(program);
     program.uniform(1, uv_multiplier);
     program.uniform(2, apply_snow && use_snow);
     bind_object(program, object);    
@@ -537,25 +814,60 @@ void Application::render_object(const ShaderProgram& program, const SceneObject&
     object.get_geometry().draw();
 }
 
+void Application::render_scene_queue()
+{
+    scene_queue.begin(camera.get_eye_position(), 100.0f);
+
+    scene_queue.add(queue_lit_program, outer_terrain_object, outer_terrain_model, 1.0f, use_snow);
+    scene_queue.add(queue_lit_program, lake_object, lake_model, 10.0f, use_snow);
+    scene_queue.add(queue_lit_program, castel_base_object, castel_base_model, 1.0f, use_snow);
+
+    // castle lod by screen space error (pixels per world unit at distance 1 from vertical fov)
+    if (castle_forced_lod >= 0) {
+        castle_lod = castle_forced_lod;
+    } else {
+        float pixels_per_unit = 0.5f * static_cast<float>(height) * projection_matrix[1][1];
+        float distance = glm::length(camera.get_eye_position() - glm::vec3(castle_model[3]));
+        float scale = glm::length(glm::vec3(castle_model[0]));
+        castle_lod = static_cast<int>(select_mesh_lod(castle_lod_errors, scale, distance, pixels_per_unit, castle_lod_max_pixels));
+    }
+    scene_queue.add(queue_lit_program, castle_lods[castle_lod], castle_model, 1.0f, use_snow);
+
+    for (int i = 0; i < prop_count; i++) {
+        scene_queue.add(queue_lit_program, prop_objects[prop_kinds[i]], prop_models[i], 1.0f, use_snow);
+    }
+
+    scene_queue.submit(gl_state);
+}
+
 void Application::render_snow_plane()
 {
-    glDisable(GL_CULL_FACE);
+    ProfilerScope scope(profiler, "render_snow_plane", true, true);
+
+    gl_state.disable(GL_CULL_FACE);
 
-    snow_plane_program.use();
+    gl_state.use_program(snow_plane_program);
     
-    top_camera_ubo.bind_buffer_base(5);
+    gl_state.bind_uniform_buffer(top_camera_ubo, 5);
 
     snow_plane_program.uniform(1, 1.0f);
     snow_plane_program.uniform(2, snow_height_max);
     snow_plane_program.uniform(3, snow_plane_tess_factor);
     snow_plane_program.uniform(4, pbr);
     
-    glBindTextureUnit(3, snow_plane_base_tex);
-    glBindTextureUnit(4, snow_height_tex);
-    glBindTextureUnit(5, snow_normal_tex);
-    glBindTextureUnit(6, snow_roughness_tex);
+    gl_state.bind_texture_unit(3, snow_plane_base_tex);
+
+    // material maps: one buffer with handles (binding is kept between frames by gl_state), or texture units
+    bool bindless = use_bindless_materials && snow_material_handles_ready;
+    snow_plane_program.uniform(5, bindless);
+    if (bindless) {
+        gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 8, snow_material_buffer);
+    } else {
+        gl_state.bind_texture_unit(4, snow_surface_tex);
+        gl_state.bind_texture_unit(5, snow_normal_tex);
+    }
     
-    bind_object(snow_plane_program, snow_plane_object);
+    bind_object(snow_plane_program, snow_plane_object, !bindless);
 
     glPatchParameteri(GL_PATCH_VERTICES, 3);
     if (snow_plane_object.get_geometry().draw_elements_count > 0) {
@@ -564,26 +876,204 @@ void Application::render_snow_plane()
         glDrawArrays(GL_PATCHES, 0, snow_plane_object.get_geometry().draw_arrays_count);
     }
 
-    glEnable(GL_CULL_FACE);
+    gl_state.enable(GL_CULL_FACE);
 }
 
 void Application::render_snow_particles()
 {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // statistics include sorting and composition (nested zones don't collect)
+    ProfilerScope scope(profiler, "render_snow_particles", true, true);
+
+    auto cpu_start = std::chrono::steady_clock::now();
+
+    glQueryCounter(snow_timer_queries[0], GL_TIMESTAMP);
+
+    if (snow_transparency == SnowTransparency::SORTED) {
+        sort_snow_particles();
+    }
+
+    glQueryCounter(snow_timer_queries[1], GL_TIMESTAMP);
+
+    gl_state.enable(GL_BLEND);
+    gl_state.depth_mask(false);
+
+    bool weighted_oit = snow_transparency == SnowTransparency::WEIGHTED_OIT;
+    if (weighted_oit) {
+        glBindFramebuffer(GL_FRAMEBUFFER, snow_oit_fbo);
 
-    glDepthMask(GL_FALSE);
+        const float accum_clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const float revealage_clear[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glClearNamedFramebufferfv(snow_oit_fbo, GL_COLOR, 0, accum_clear);
+        glClearNamedFramebufferfv(snow_oit_fbo, GL_COLOR, 1, revealage_clear);
 
-    snow_particles_program.use();
+        glBlendFunci(0, GL_ONE, GL_ONE);
+        glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    } else {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    gl_state.use_program(snow_particles_program);
 
     snow_particles_program.uniform(0, static_cast<float>(elapsed_time) * 1e-3f);
-    glBindTextureUnit(0, snow_particle_tex);
+    snow_particles_program.uniform(1, weighted_oit);
+    snow_particles_program.uniform(2, use_soft_particles);
+    snow_particles_program.uniform(3, soft_particles_distance);
+    gl_state.bind_texture_unit(0, snow_particle_tex);
+
+    // soft particles - copy of opaque depth (scene_depth_tex stays attached for depth test)
+    if (use_soft_particles) {
+        glCopyImageSubData(scene_depth_tex, GL_TEXTURE_2D, 0, 0, 0, 0, scene_depth_copy_tex, GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+        gl_state.bind_texture_unit(1, scene_depth_copy_tex);
+    }
 
-    glBindVertexArray(snow_particles_vao);
-    glDrawArrays(GL_POINTS, 0, snow_particles_count);
+    gl_state.bind_vertex_array(snow_particles_vao);
+    if (snow_transparency == SnowTransparency::SORTED) {
+        glMemoryBarrier(GL_ELEMENT_ARRAY_BARRIER_BIT);
+        glDrawElements(GL_POINTS, snow_particles_count, GL_UNSIGNED_INT, nullptr);
+    } else {
+        glDrawArrays(GL_POINTS, 0, snow_particles_count);
+    }
+
+    glQueryCounter(snow_timer_queries[2], GL_TIMESTAMP);
+
+    if (weighted_oit) {
+        glBindFramebuffer(GL_FRAMEBUFFER, scene_fbo);
+        composite_snow_oit();
+    }
+
+    glQueryCounter(snow_timer_queries[3], GL_TIMESTAMP);
 
-    glDisable(GL_BLEND);
-    glDepthMask(GL_TRUE);
+    gl_state.disable(GL_BLEND);
+    gl_state.depth_mask(true);
+
+    snow_cpu_time_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpu_start).count();
+}
+
+void Application::sort_snow_particles()
+{
+    ProfilerScope scope(profiler, "sort_snow_particles");
+
+    // keys (view depth) + values (flake indices)
+    gl_state.use_program(snow_sort_keys_program);
+
+    snow_sort_keys_program.uniform(0, static_cast<float>(elapsed_time) * 1e-3f);
+    snow_sort_keys_program.uniform(1, static_cast<unsigned int>(snow_particles_count));
+
+    gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 5, snow_particles_pos_buffer);
+    gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, snow_sort.keys_buffer[0]);
+    gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 1, snow_sort.values_buffer[0]);
+
+    glDispatchCompute((snow_particles_count + GpuRadixSort::LOCAL_SIZE - 1) / GpuRadixSort::LOCAL_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    snow_sort.sort(radix_histogram_program, radix_scan_program, radix_scatter_program, snow_particles_count);
+
+    // radix sort binds its programs and storage buffers directly
+    gl_state.invalidate();
+}
+
+void Application::composite_snow_oit()
+{
+    ProfilerScope scope(profiler, "composite_snow_oit");
+
+    gl_state.disable(GL_DEPTH_TEST);
+    gl_state.polygon_mode(GL_FILL);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    gl_state.use_program(snow_oit_composite_program);
+
+    gl_state.bind_texture_unit(0, snow_oit_accum_tex);
+    gl_state.bind_texture_unit(1, snow_oit_revealage_tex);
+
+    gl_state.bind_vertex_array(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    gl_state.enable(GL_DEPTH_TEST);
+    gl_state.polygon_mode(wireframe ? GL_LINE : GL_FILL);
+}
+
+void Application::read_snow_timers()
+{
+    if (!snow_timers_issued) {
+        return;
+    }
+
+    GLuint64 timestamps[4];
+    for (int i = 0; i < 4; i++) {
+        glGetQueryObjectui64v(snow_timer_queries[i], GL_QUERY_RESULT, &timestamps[i]);
+    }
+
+    snow_sort_time_ms = static_cast<float>(timestamps[1] - timestamps[0]) * 1e-6f;
+    snow_draw_time_ms = static_cast<float>(timestamps[2] - timestamps[1]) * 1e-6f;
+    snow_composite_time_ms = static_cast<float>(timestamps[3] - timestamps[2]) * 1e-6f;
+}
+
+void Application::start_snow_benchmark()
+{
+    snow_benchmark_restore_transparency = snow_transparency;
+    snow_benchmark_restore_count = snow_particles_count_target;
+    snow_benchmark_restore_use_snow = use_snow;
+
+    use_snow = true;
+    snow_particles_count_target = SNOW_BENCHMARK_COUNT;
+    snow_transparency = SnowTransparency::UNSORTED;
+
+    for (int mode = 0; mode < 3; mode++) {
+        snow_benchmark_samples[mode] = 0;
+        for (float& result : snow_benchmark_results[mode]) {
+            result = 0.0f;
+        }
+    }
+
+    snow_benchmark_done = false;
+    snow_benchmark_frame = 0;
+}
+
+void Application::update_snow_benchmark()
+{
+    if (snow_benchmark_frame < 0) {
+        return;
+    }
+
+    // modes run one after another, timers of this frame belong to the mode set before it
+    const int mode_frames = SNOW_BENCHMARK_WARMUP_FRAMES + SNOW_BENCHMARK_FRAMES;
+    int mode = snow_benchmark_frame / mode_frames;
+    int mode_frame = snow_benchmark_frame % mode_frames;
+
+    if (mode_frame >= SNOW_BENCHMARK_WARMUP_FRAMES && snow_particles_count == SNOW_BENCHMARK_COUNT && snow_timers_issued) {
+        float* results = snow_benchmark_results[mode];
+        results[0] += snow_cpu_time_ms;
+        results[1] += snow_sort_time_ms;
+        results[2] += snow_draw_time_ms;
+        results[3] += snow_composite_time_ms;
+        snow_benchmark_samples[mode]++;
+    }
+
+    snow_benchmark_frame++;
+    if (snow_benchmark_frame < 3 * mode_frames) {
+        snow_transparency = static_cast<SnowTransparency>(snow_benchmark_frame / mode_frames);
+        return;
+    }
+
+    // done - averages
+    const char* mode_names[3] = { "unsorted", "sorted", "weighted oit" };
+    std::printf("snow transparency benchmark: %d flakes, %d frames per mode\n", SNOW_BENCHMARK_COUNT, SNOW_BENCHMARK_FRAMES);
+    std::printf("mode, cpu ms, sort ms, draw ms, composite ms, gpu total ms\n");
+    for (int m = 0; m < 3; m++) {
+        float* results = snow_benchmark_results[m];
+        for (int i = 0; i < 4; i++) {
+            results[i] /= static_cast<float>(std::max(snow_benchmark_samples[m], 1));
+        }
+        std::printf("%s, %.3f, %.3f, %.3f, %.3f, %.3f\n", mode_names[m], results[0], results[1], results[2], results[3], results[1] + results[2] + results[3]);
+    }
+
+    snow_transparency = snow_benchmark_restore_transparency;
+    snow_particles_count_target = snow_benchmark_restore_count;
+    use_snow = snow_benchmark_restore_use_snow;
+
+    snow_benchmark_done = true;
+    snow_benchmark_frame = -1;
 }
 
 void Application::render_texture(GLuint texture)
@@ -594,31 +1084,33 @@ void Application::render_texture(GLuint texture)
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    gl_state.disable(GL_DEPTH_TEST);
+    gl_state.disable(GL_BLEND);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    gl_state.polygon_mode(GL_FILL);
 
-    display_texture_program.use();
+    gl_state.use_program(display_texture_program);
 
-    glBindTextureUnit(0, texture);
+    gl_state.bind_texture_unit(0, texture);
 
-    glBindVertexArray(empty_vao);
+    gl_state.bind_vertex_array(empty_vao);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 
-    glEnable(GL_DEPTH_TEST);
+    gl_state.enable(GL_DEPTH_TEST);
 }
 
-void Application::bind_object(const ShaderProgram& program, const SceneObject& object)
+void Application::bind_object(const Program& program, const SceneObject& object, bool bind_texture)
 {
-    object.get_model_ubo().bind_buffer_base(ModelUBO::DEFAULT_MODEL_BINDING);
-    object.get_material().bind_buffer_base(PhongMaterialUBO::DEFAULT_MATERIAL_BINDING);
+    gl_state.bind_uniform_buffer(object.get_model_ubo(), ModelUBO::DEFAULT_MODEL_BINDING);
+    gl_state.bind_uniform_buffer(object.get_material(), PhongMaterialUBO::DEFAULT_MATERIAL_BINDING);
 
     program.uniform(0, object.has_texture());
     
-    glBindTextureUnit(0, object.has_texture() ? object.get_texture() : 0);
+    if (bind_texture) {
+        gl_state.bind_texture_unit(0, object.has_texture() ? object.get_texture() : 0);
+    }
 
-    object.get_geometry().bind_vao();
+    gl_state.bind_geometry(object.get_geometry());
 }
 
 
@@ -667,6 +1159,31 @@ void Application::render_ui()
         snow_particles_count_target = static_cast<int>(glm::pow(2, exponent + 8));
     }
 
+    const char* transparency_labels[3] = {"unsorted", "sorted (gpu radix sort)", "weighted oit"};
+    int transparency = static_cast<int>(snow_transparency);
+    if (ImGui::Combo("transparency", &transparency, transparency_labels, IM_ARRAYSIZE(transparency_labels))) {
+        snow_transparency = static_cast<SnowTransparency>(transparency);
+    }
+
+    ImGui::Checkbox("soft particles", &use_soft_particles);
+    ImGui::SliderFloat(" > distance##soft", &soft_particles_distance, 0.1f, 10.0f, "%.2f");
+
+    ImGui::Text("snow (cpu): %.3f ms", snow_cpu_time_ms);
+    ImGui::Text("snow (gpu): sort %.3f ms, draw %.3f ms, composite %.3f ms", snow_sort_time_ms, snow_draw_time_ms, snow_composite_time_ms);
+
+    if (snow_benchmark_frame >= 0) {
+        int mode_frames = SNOW_BENCHMARK_WARMUP_FRAMES + SNOW_BENCHMARK_FRAMES;
+        ImGui::Text("transparency benchmark: %d / %d frames", snow_benchmark_frame, 3 * mode_frames);
+    } else if (ImGui::Button("benchmark transparency (131072 flakes)")) {
+        start_snow_benchmark();
+    }
+    if (snow_benchmark_done) {
+        for (int mode = 0; mode < 3; mode++) {
+            const float* results = snow_benchmark_results[mode];
+            ImGui::Text(" > %s: cpu %.3f ms, gpu sort %.3f, draw %.3f, composite %.3f ms", transparency_labels[mode], results[0], results[1], results[2], results[3]);
+        }
+    }
+
     clear_snow_accum = ImGui::Button("clear snow");
 
     ImGui::Dummy(spacing_size);
@@ -678,8 +1195,110 @@ void Application::render_ui()
     ImGui::Checkbox("wireframe", &wireframe);
     ImGui::Checkbox("pbr", &pbr);
 
+    if (texture_streamer->is_bindless_supported()) {
+        ImGui::Checkbox(snow_material_handles_ready ? "bindless snow material" : "bindless snow material (streaming)", &use_bindless_materials);
+    } else {
+        ImGui::Text("bindless textures not supported");
+    }
+
+    ImGui::SliderInt("props", &prop_count_target, 0, MAX_PROP_COUNT);
+
+    if (ImGui::Checkbox("static batch (multi draw)", &use_static_batch)) {
+        do_update_snow_shadow = true;
+        do_update_snow_plane_base = true;
+    }
+
+    ImGui::SliderInt("castle lod", &castle_forced_lod, -1, CASTLE_LOD_COUNT - 1, castle_forced_lod < 0 ? "by screen error" : "%d");
+    ImGui::SliderFloat(" > max error (px)", &castle_lod_max_pixels, 0.25f, 8.0f, "%.2f");
+    ImGui::SliderInt(" > depth maps", &castle_depth_lod, 0, CASTLE_LOD_COUNT - 1);
+    ImGui::Text(" > drawn %d: %zu triangles (error %.4f)", castle_lod, castle_lod_triangles[castle_lod], castle_lod_errors[castle_lod]);
+    const VertexCacheStatistics(&castle_cache)[2] = castle_lod_cache[castle_lod];
+    ImGui::Text(" > vertex cache: acmr %.2f -> %.2f, atvr %.2f -> %.2f", castle_cache[0].acmr, castle_cache[1].acmr, castle_cache[0].atvr, castle_cache[1].atvr);
+
+    ImGui::Checkbox("sort render queue", &scene_queue.sort_items);
+    ImGui::Checkbox("instancing", &scene_queue.instancing);
+
+    const RenderQueue::Statistics& queue_statistics = scene_queue.statistics;
+    ImGui::Text(" > %zu items, %zu draw calls", queue_statistics.items, queue_statistics.batches);
+    ImGui::Text(" > changes: %zu program, %zu material, %zu texture, %zu geometry", queue_statistics.program_changes, queue_statistics.material_changes,
+                queue_statistics.texture_changes, queue_statistics.geometry_changes);
+
+    ImGui::Checkbox("gl state cache", &gl_state.enabled);
+    for (int i = 0; i < GlStateCache::CATEGORY_COUNT; i++) {
+        const GlStateCache::Counter& counter = gl_state.counters[i];
+        ImGui::Text(" > %s: %zu issued, %zu filtered", GlStateCache::CATEGORY_NAMES[i], counter.issued, counter.filtered);
+    }
+
     do_reset_settings = ImGui::Button("reset setting");
 
+    ImGui::Dummy(spacing_size);
+    ImGui::Text("  ========  profiler  ========");
+    ImGui::Dummy(spacing_size);
+
+    ImGui::Checkbox("enabled##profiler", &profiler.enabled);
+    ImGui::Checkbox("show timeline", &show_profiler);
+
+    if (profiler.is_statistics_supported()) {
+        ImGui::Checkbox("pipeline statistics", &profiler.collect_statistics);
+    } else {
+        ImGui::Text("pipeline statistics not supported");
+    }
+
+    ImGui::InputText("file##trace", profiler_trace_file, sizeof(profiler_trace_file));
+    if (ImGui::Button("export trace")) {
+        profiler.export_chrome_trace(lecture_folder_path / profiler_trace_file);
+    }
+
+    ImGui::InputText("file##benchmark", benchmark_file, sizeof(benchmark_file));
+    if (ImGui::Button("export benchmark csv")) {
+        profiler.export_csv(lecture_folder_path / benchmark_file, gpu_resources());
+    }
+
+    const ProgramCache::Statistics& program_statistics = program_cache.statistics;
+    ImGui::Text("programs: %zu cached, %zu compiled, %zu failed, %.1f ms%s", program_statistics.hits, program_statistics.compiled, program_statistics.failed,
+                program_statistics.time_ms, program_cache.is_parallel_supported() ? " (parallel)" : "");
+    ImGui::Checkbox("program binaries", &program_cache.use_binaries);
+    if (ImGui::Button("clear program binaries")) {
+        program_cache.clear();
+    }
+
+    ImGui::Dummy(spacing_size);
+    ImGui::Text("  ========  textures  ========");
+    ImGui::Dummy(spacing_size);
+
+    int upload_budget_kb = static_cast<int>(texture_streamer->upload_budget / 1024);
+    if (ImGui::SliderInt("upload KB / frame", &upload_budget_kb, 64, static_cast<int>(TextureStreamer::STAGING_SLOT_SIZE / 1024))) {
+        texture_streamer->upload_budget = static_cast<size_t>(upload_budget_kb) * 1024;
+    }
+    texture_streamer->render_ui();
+    if (ImGui::Button("clear texture cache")) {
+        texture_streamer->clear_cache();
+    }
+
+    ImGui::End();
+
+    if (show_profiler) {
+        render_profiler_ui();
+    }
+}
+
+void Application::render_profiler_ui()
+{
+    const float unit = ImGui::GetFontSize();
+
+    ImGui::Begin("profiler", nullptr, ImGuiWindowFlags_NoDecoration);
+
+    ImGui::SetWindowSize(ImVec2(30 * unit, 0.0f));
+    ImGui::SetWindowPos(ImVec2(23 * unit, 2 * unit));
+
+    profiler.render_ui();
+
+    ImGui::Dummy(ImVec2(10.0f, unit * 0.2f));
+    ImGui::Text("  ========  gpu memory  ========");
+    ImGui::Dummy(ImVec2(10.0f, unit * 0.2f));
+
+    gpu_resources().render_ui();
+
     ImGui::End();
 }
 
@@ -688,6 +1307,7 @@ void Application::render_ui()
 void Application::on_resize(int width, int height)
 {
     PV227Application::on_resize(width, height);
+    resize_scene_fbo();
 }
 
 void Application::on_mouse_move(double x, double y)
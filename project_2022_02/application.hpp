@@ -11,14 +11,50 @@
 #include "pv227_application.hpp"
 #include "scene_object.hpp"
 
+#include "src/gl_state_cache.hpp"
+#include "src/radix_sort.hpp"
+#include "src/render_queue.hpp"
+#include "src/static_batch.hpp"
+#include "src/texture_streamer.hpp"
+
+#include "../common/mesh_lod.hpp"
+#include "../common/obj_loader.hpp"
+#include "../common/profiler.hpp"
+#include "../common/program_cache.hpp"
+
+#include <optional>
+
+
+
+// transparency of snow particles
+enum class SnowTransparency : int {
+    UNSORTED = 0, // submission order
+    SORTED = 1, // back to front (gpu radix sort of view depth)
+    WEIGHTED_OIT = 2, // weighted blended order independent transparency
+};
 
 
 class Application : public PV227Application {
 protected:
+    // programs (built through program_cache, binaries are stored in lecture_folder_path / "shader_cache")
+    ProgramCache program_cache;
+
+    Program lit_program;
+    Program unlit_program;
+
+    // image textures (decoded and compressed by worker threads, uploaded over several frames, see TextureStreamer)
+    std::optional<TextureStreamer> texture_streamer;
+
     // camera
     glm::mat4 projection_matrix;
     CameraUBO camera_ubo;
 
+    // scene framebuffer (depth is available as texture)
+    GLuint scene_fbo;
+    GLuint scene_color_tex;
+    GLuint scene_depth_tex;
+    GLuint scene_depth_copy_tex; // opaque depth sampled by soft particles (scene_depth_tex stays attached for depth test)
+
     // snow view
     CameraUBO top_camera_ubo;
 
@@ -36,12 +72,12 @@ protected:
     GLuint snow_accum_fbo_a;
     GLuint snow_accum_fbo_b;
 
-    ShaderProgram snow_accum_update_program;    
+    Program snow_accum_update_program;    
 
     // snow accumulation - blur
     float snow_accum_blur_radius;
 
-    ShaderProgram snow_accum_blur_program;
+    Program snow_accum_blur_program;
 
     // snow accumulation - shadow
     GLuint snow_shadow_tex;
@@ -60,7 +96,7 @@ protected:
     // broom - position texture
     GLuint broom_pos_tex;
     GLuint broom_pos_fbo;
-    ShaderProgram broom_pos_program;
+    Program broom_pos_program;
 
     // snow plane
     bool show_snow_plane;
@@ -74,10 +110,15 @@ protected:
 
     GLuint snow_albedo_tex;
     GLuint snow_normal_tex;
-    GLuint snow_height_tex;
-    GLuint snow_roughness_tex;
+    GLuint snow_surface_tex; // r = height, g = roughness (channel packed)
 
-    ShaderProgram snow_plane_program;
+    Program snow_plane_program;
+
+    // snow plane - material maps as bindless handles (albedo, normal, surface), set once all maps are resident
+    // without ARB_bindless_texture (or while streaming) the maps are bound to texture units
+    bool use_bindless_materials;
+    bool snow_material_handles_ready;
+    GLuint snow_material_buffer;
 
     // snow plane - base
     GLuint snow_plane_base_tex;
@@ -94,19 +135,102 @@ protected:
 
     GLuint snow_particle_tex;
 
-    ShaderProgram snow_particles_program;
+    Program snow_particles_program;
+
+    // snow particles - transparency
+    SnowTransparency snow_transparency;
+
+    bool use_soft_particles; // fade flakes near scene geometry (scene_depth_copy_tex)
+    float soft_particles_distance;
+
+    GpuRadixSort snow_sort;
+
+    Program snow_sort_keys_program;
+    Program radix_histogram_program;
+    Program radix_scan_program;
+    Program radix_scatter_program;
+
+    GLuint snow_oit_accum_tex;
+    GLuint snow_oit_revealage_tex;
+    GLuint snow_oit_fbo;
+
+    Program snow_oit_composite_program;
+
+    // snow particles - timing (gpu timestamps: start, sorted, drawn, composited)
+    GLuint snow_timer_queries[4];
+    bool snow_timers_issued;
+
+    float snow_cpu_time_ms; // render_snow_particles (submission)
+    float snow_sort_time_ms;
+    float snow_draw_time_ms;
+    float snow_composite_time_ms;
 
-    // scene
+    // snow particles - transparency benchmark, every mode at SNOW_BENCHMARK_COUNT flakes (printed and shown in gui)
+    static const int SNOW_BENCHMARK_COUNT = 131072;
+    static const int SNOW_BENCHMARK_WARMUP_FRAMES = 30; // count change, profiler lag
+    static const int SNOW_BENCHMARK_FRAMES = 300; // per mode
+
+    int snow_benchmark_frame; // -1 - not running
+    SnowTransparency snow_benchmark_restore_transparency;
+    int snow_benchmark_restore_count;
+    bool snow_benchmark_restore_use_snow;
+
+    bool snow_benchmark_done;
+    int snow_benchmark_samples[3];
+    float snow_benchmark_results[3][4]; // per mode: cpu, sort, draw, composite (ms, averages)
+
+    // scene (drawn through scene_queue, which takes model matrices from its draw buffer)
     SceneObject outer_terrain_object;
     SceneObject lake_object;
     SceneObject castel_base_object;
-    SceneObject castle_object;
+
+    glm::mat4 outer_terrain_model;
+    glm::mat4 lake_model;
+    glm::mat4 castel_base_model;
+    glm::mat4 castle_model;
+
+    // scene - castle lods (0 = original, then 50 / 25 / 10 % of triangles, cached in mesh_cache)
+    // main camera picks lod by error projected to the screen, depth maps of top view use one coarse lod
+    static const int CASTLE_LOD_COUNT = 4;
+
+    SceneObject castle_lods[CASTLE_LOD_COUNT];
+    std::vector<float> castle_lod_errors; // model space
+    size_t castle_lod_triangles[CASTLE_LOD_COUNT];
+    VertexCacheStatistics castle_lod_cache[CASTLE_LOD_COUNT][2]; // index order of obj, optimized
+
+    int castle_lod; // of main camera in last frame
+    int castle_forced_lod; // -1 = by screen error
+    float castle_lod_max_pixels;
+    int castle_depth_lod;
+    int castle_batch_lod; // castle_depth_lod the static batch was built with
+
+    // scene - static batch of the objects above (same order), ground = first 3 (without castle)
+    static const size_t STATIC_GROUND_COUNT = 3;
+
+    bool use_static_batch; // depth passes of top view draw the batch by one multi draw
+    StaticBatch static_batch;
 
     PhongMaterialUBO brown_material_ubo;
     PhongMaterialUBO castle_material_ubo;
 
     GLuint ice_albedo_tex;
 
+    // scene - props (many small objects scattered over lake and terrain, stress test of render queue)
+    static const int MAX_PROP_COUNT = 8192;
+    static const int PROP_KIND_COUNT = 4;
+
+    int prop_count;
+    int prop_count_target;
+
+    SceneObject prop_objects[PROP_KIND_COUNT]; // kinds (geometry + material + texture), model is ignored
+    std::vector<int> prop_kinds;
+    std::vector<glm::mat4> prop_models;
+
+    // scene - render queue
+    RenderQueue scene_queue;
+
+    Program queue_lit_program;
+
     // lights
     PhongLightsUBO phong_lights_ubo;
 
@@ -114,11 +238,21 @@ protected:
 
     SceneObject light_object;
 
+    // gl state of passes (redundant changes are filtered)
+    GlStateCache gl_state;
+
     // general shadow program
-    ShaderProgram shadow_program;
+    Program shadow_program;
+    Program shadow_batch_program; // models from static batch
 
     // debug
-    ShaderProgram display_texture_program;
+    Program display_texture_program;
+
+    // profiling (cpu + gpu zones of snow passes)
+    Profiler profiler;
+    bool show_profiler;
+    char profiler_trace_file[128]; // exported into lecture_folder_path
+    char benchmark_file[128]; // zone averages, pipeline statistics and gpu memory (csv)
 
     // general settings
     bool use_snow;
@@ -136,6 +270,9 @@ public:
     // init
     void compile_shaders() override;
 
+    void prepare_scene_fbo();
+    void resize_scene_fbo();
+
     void prepare_snow_view();
     void prepare_snow_accum();
     void prepare_snow_shadowing();
@@ -144,6 +281,7 @@ public:
     void prepare_snow_plane_base();
     void prepare_snow_particles();
     void prepare_scene();
+    void prepare_props();
     void prepare_lights();
     void prepare_camera();
 
@@ -151,28 +289,42 @@ public:
     void reset_settings();
 
     void reload_snow_particles(bool first = false);
+    void reload_props();
+    void reload_static_batch();
 
     // update
     void update(float delta) override;
     void update_snow_accum(float delta);
     void update_snow_shadow();
     void update_snow_plane_base();
+    void update_snow_material();
+    void render_static_depth(size_t count);
 
     void update_broom_location();
 
     // render
     void render() override;
 
-    void render_object(const ShaderProgram& program, const SceneObject& object, float uv_multiplier = 1.0f, bool apply_snow = true);
+    void render_object(const Program& program, const SceneObject& object, float uv_multiplier = 1.0f, bool apply_snow = true);
+    void render_scene_queue();
     void render_snow_plane();
     void render_snow_particles();
+    void sort_snow_particles();
+    void composite_snow_oit();
+
+    void read_snow_timers();
+
+    void start_snow_benchmark();
+    void update_snow_benchmark(); // after read_snow_timers
 
     void render_texture(GLuint texture);
 
-    void bind_object(const ShaderProgram& program, const SceneObject& object);
+    // bind_texture = false - albedo is sampled through bindless handle, unit 0 is left as is
+    void bind_object(const Program& program, const SceneObject& object, bool bind_texture = true);
 
     // render gui
     void render_ui() override;
+    void render_profiler_ui();
 
     // input
     void on_resize(int width, int height) override;
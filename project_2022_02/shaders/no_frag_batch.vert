@@ -0,0 +1,34 @@
+#version 450 core
+
+
+
+// vertex input
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 tex_coord;
+
+layout (location = 7) in uint draw_id; // per instance, see StaticBatch
+
+
+// uniform input
+layout (std140, binding = 0) uniform CameraBuffer
+{
+	mat4 projection;
+	mat4 projection_inv;
+	mat4 view;
+	mat4 view_inv;
+	mat3 view_it;
+	vec3 eye_position;
+};
+
+layout (std430, binding = 7) readonly buffer ModelBuffer
+{
+	mat4 models[];
+};
+
+
+
+void main()
+{
+	gl_Position = projection * view * models[draw_id] * position;
+}
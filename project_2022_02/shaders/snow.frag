@@ -6,6 +6,7 @@ in VertexData
 {
 	vec2 tex_coord;
 	vec3 position_ws;
+	float depth_vs;
 } in_data;
 
 
@@ -30,15 +31,37 @@ layout (std140, binding = 3) uniform PhongMaterialBuffer
 } material;
 
 layout (binding = 0) uniform sampler2D particle_texture;
+layout (binding = 1) uniform sampler2D scene_depth_tex; // copy of opaque scene depth (not attached to current framebuffer)
+
+layout (location = 1) uniform bool weighted_oit;
+layout (location = 2) uniform bool soft_particles;
+layout (location = 3) uniform float soft_particles_distance;
 
 
 // output
-layout (location = 0) out vec4 final_color;
+layout (location = 0) out vec4 final_color; // weighted oit - accumulation
+layout (location = 1) out vec4 oit_revealage; // weighted oit only
 
 
 
 void main()
 {
 	float intensity = texture(particle_texture, in_data.tex_coord).r;
-	final_color = vec4(1.0f, 1.0f, 1.0f, 0.2 * intensity);
+	vec4 color = vec4(1.0f, 1.0f, 1.0f, 0.2 * intensity);
+
+	// soft particles - fade out near opaque geometry (only read here, opaque passes keep early-z)
+	if (soft_particles) {
+		float scene_depth = texelFetch(scene_depth_tex, ivec2(gl_FragCoord.xy), 0).r;
+		float scene_depth_vs = projection[3][2] / (scene_depth * 2.0 - 1.0 + projection[2][2]);
+		color.a *= clamp((scene_depth_vs - in_data.depth_vs) / soft_particles_distance, 0.0, 1.0);
+	}
+
+	if (weighted_oit) {
+		// weighted blended order independent transparency (McGuire, Bavoil 2013), depth based weight
+		float weight = clamp(color.a * max(1e-2, 3e3 * pow(1.0 - gl_FragCoord.z, 3.0)), 1e-2, 3e3);
+		final_color = vec4(color.rgb * color.a, color.a) * weight;
+		oit_revealage = vec4(color.a);
+	} else {
+		final_color = color;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 450 core
+
+
+// fragment input
+in VertexData
+{
+	vec2 tex_coord;
+} in_data;
+
+
+// uniform input
+layout (binding = 0) uniform sampler2D accum_tex;
+layout (binding = 1) uniform sampler2D revealage_tex;
+
+
+// output
+layout (location = 0) out vec4 final_color;
+
+
+
+void main()
+{
+	ivec2 coord = ivec2(gl_FragCoord.xy);
+
+	float revealage = texelFetch(revealage_tex, coord, 0).r;
+	if (revealage >= 1.0) {
+		discard; // no flakes
+	}
+
+	vec4 accum = texelFetch(accum_tex, coord, 0);
+	vec3 average_color = accum.rgb / max(accum.a, 1e-5);
+
+	// blended with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+	final_color = vec4(average_color, 1.0 - revealage);
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 450 core
+#extension GL_ARB_bindless_texture : enable
 
 
 // fragment input
@@ -66,13 +67,33 @@ layout (location = 1) uniform float uv_mult;
 layout (location = 2) uniform float snow_height_max;
 
 layout (location = 4) uniform bool pbr;
+layout (location = 5) uniform bool use_material_handles;
 
 layout (binding = 0) uniform sampler2D material_diffuse_tex;
 layout (binding = 1) uniform sampler2D snow_accum_tex;
 layout (binding = 2) uniform sampler2D snow_shadow_tex;
 
+layout (binding = 4) uniform sampler2D snow_surface_tex; // r = height, g = roughness
 layout (binding = 5) uniform sampler2D snow_normal_tex;
-layout (binding = 6) uniform sampler2D snow_roughness_tex;
+
+#ifdef GL_ARB_bindless_texture
+// handles of albedo, normal, surface maps (Application::update_snow_material)
+layout (std430, binding = 8) readonly buffer SnowMaterialBuffer
+{
+	uvec2 snow_material_handles[3];
+};
+#endif
+
+// material map through its handle, or through bound unit
+vec4 sample_snow_map(int map, sampler2D bound_tex, vec2 uv)
+{
+#ifdef GL_ARB_bindless_texture
+	if (use_material_handles) {
+		return texture(sampler2D(snow_material_handles[map]), uv);
+	}
+#endif
+	return texture(bound_tex, uv);
+}
 
 
 // output
@@ -132,7 +153,9 @@ void main()
 
 	vec3 n = normalize(cross(tx, ty));
 
-	vec3 normal_map = texture(snow_normal_tex, top_pos_ndc.xy).xyz * 2.0 - 1.0;
+	// two channel (bc5) normal map, z is reconstructed
+	vec2 normal_xy = sample_snow_map(1, snow_normal_tex, top_pos_ndc.xy).xy * 2.0 - 1.0;
+	vec3 normal_map = vec3(normal_xy, sqrt(max(0.0, 1.0 - dot(normal_xy, normal_xy))));
 
 	// vec3 N = n;
 	vec3 N = normalize(tx * normal_map.x + ty * normal_map.y + n * normal_map.z);
@@ -140,7 +163,7 @@ void main()
 
 	// lighting
 	vec3 fresnel0 = vec3(0.1);
-	float roughness = texture(snow_roughness_tex, top_pos_ndc.xy).r;
+	float roughness = sample_snow_map(2, snow_surface_tex, top_pos_ndc.xy).g;
 
 	vec3 V = normalize(eye_position - in_data.position_ws);
 	
@@ -194,8 +217,8 @@ void main()
 	}
 
 	// material
-	vec3 mat_ambient = has_tex ? texture(material_diffuse_tex, in_data.tex_coord * uv_mult).rgb :  material.ambient;
-	vec3 mat_diffuse = has_tex ? texture(material_diffuse_tex, in_data.tex_coord * uv_mult).rgb :  material.diffuse;
+	vec3 mat_ambient = has_tex ? sample_snow_map(0, material_diffuse_tex, in_data.tex_coord * uv_mult).rgb :  material.ambient;
+	vec3 mat_diffuse = has_tex ? sample_snow_map(0, material_diffuse_tex, in_data.tex_coord * uv_mult).rgb :  material.diffuse;
 	vec3 mat_specular = pbr ? vec3(1.0) : material.specular;
 
 	// final color
@@ -0,0 +1,259 @@
+#include "block_compression.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+namespace {
+    const TextureFormatInfo FORMAT_INFOS[4] = {
+        { "rgba8", GL_RGBA8, 1, 4 },
+        { "bc1", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4, 8 },
+        { "bc4", GL_COMPRESSED_RED_RGTC1, 4, 8 },
+        { "bc5", GL_COMPRESSED_RG_RGTC2, 4, 16 },
+    };
+
+    uint16_t pack_565(const int color[3])
+    {
+        return static_cast<uint16_t>(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+    }
+
+    void unpack_565(uint16_t packed, int color[3])
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // block: 16 rgba pixels
+    void compress_bc1_block(const uint8_t block[16][4], uint8_t* output)
+    {
+        int min[3] = { 255, 255, 255 };
+        int max[3] = { 0, 0, 0 };
+        int mean[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 3; c++) {
+                min[c] = std::min(min[c], static_cast<int>(block[i][c]));
+                max[c] = std::max(max[c], static_cast<int>(block[i][c]));
+                mean[c] += block[i][c];
+            }
+        }
+
+        // box diagonal follows sign of covariance of red / blue with green
+        int covariance_rg = 0;
+        int covariance_bg = 0;
+        for (int i = 0; i < 16; i++) {
+            int g = block[i][1] * 16 - mean[1];
+            covariance_rg += (block[i][0] * 16 - mean[0]) * g;
+            covariance_bg += (block[i][2] * 16 - mean[2]) * g;
+        }
+        if (covariance_rg < 0) {
+            std::swap(min[0], max[0]);
+        }
+        if (covariance_bg < 0) {
+            std::swap(min[2], max[2]);
+        }
+
+        // inset endpoints (box corners are rarely hit exactly)
+        for (int c = 0; c < 3; c++) {
+            int inset = (max[c] - min[c]) / 16;
+            max[c] -= inset;
+            min[c] += inset;
+        }
+
+        uint16_t color0 = pack_565(max);
+        uint16_t color1 = pack_565(min);
+        if (color0 < color1) {
+            std::swap(color0, color1);
+        }
+
+        // color0 > color1: 4 color mode, color0 == color1: single color
+        int palette[4][3];
+        unpack_565(color0, palette[0]);
+        unpack_565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        uint32_t indices = 0;
+        if (color0 != color1) {
+            for (int i = 0; i < 16; i++) {
+                int best = 0;
+                int best_distance = 1 << 30;
+                for (int p = 0; p < 4; p++) {
+                    int distance = 0;
+                    for (int c = 0; c < 3; c++) {
+                        int d = block[i][c] - palette[p][c];
+                        distance += d * d;
+                    }
+                    if (distance < best_distance) {
+                        best = p;
+                        best_distance = distance;
+                    }
+                }
+                indices |= static_cast<uint32_t>(best) << (2 * i);
+            }
+        }
+
+        output[0] = static_cast<uint8_t>(color0 & 0xff);
+        output[1] = static_cast<uint8_t>(color0 >> 8);
+        output[2] = static_cast<uint8_t>(color1 & 0xff);
+        output[3] = static_cast<uint8_t>(color1 >> 8);
+        for (int i = 0; i < 4; i++) {
+            output[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    // channel of 16 rgba pixels
+    void compress_bc4_block(const uint8_t block[16][4], int channel, uint8_t* output)
+    {
+        int min = 255;
+        int max = 0;
+        for (int i = 0; i < 16; i++) {
+            min = std::min(min, static_cast<int>(block[i][channel]));
+            max = std::max(max, static_cast<int>(block[i][channel]));
+        }
+
+        // max > min: 8 value mode (0 = max, 1 = min, 2..7 interpolated from max to min)
+        uint64_t indices = 0;
+        if (max > min) {
+            int palette[8];
+            palette[0] = max;
+            palette[1] = min;
+            for (int p = 1; p < 7; p++) {
+                palette[p + 1] = ((7 - p) * max + p * min) / 7;
+            }
+
+            for (int i = 0; i < 16; i++) {
+                int best = 0;
+                int best_distance = 1 << 30;
+                for (int p = 0; p < 8; p++) {
+                    int distance = std::abs(block[i][channel] - palette[p]);
+                    if (distance < best_distance) {
+                        best = p;
+                        best_distance = distance;
+                    }
+                }
+                indices |= static_cast<uint64_t>(best) << (3 * i);
+            }
+        }
+
+        output[0] = static_cast<uint8_t>(max);
+        output[1] = static_cast<uint8_t>(min);
+        for (int i = 0; i < 6; i++) {
+            output[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    std::vector<uint8_t> compress_level(const std::vector<uint8_t>& rgba, int width, int height, TextureFormat format)
+    {
+        const TextureFormatInfo& info = get_texture_format_info(format);
+        if (format == TextureFormat::RGBA8) {
+            return rgba;
+        }
+
+        int blocks_x = (width + 3) / 4;
+        int blocks_y = (height + 3) / 4;
+        std::vector<uint8_t> output(static_cast<size_t>(blocks_x) * blocks_y * info.block_bytes);
+
+        uint8_t block[16][4];
+        for (int by = 0; by < blocks_y; by++) {
+            for (int bx = 0; bx < blocks_x; bx++) {
+                // pixels outside of small levels repeat the edge
+                for (int i = 0; i < 16; i++) {
+                    int x = std::min(bx * 4 + i % 4, width - 1);
+                    int y = std::min(by * 4 + i / 4, height - 1);
+                    const uint8_t* pixel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                    std::copy(pixel, pixel + 4, block[i]);
+                }
+
+                uint8_t* out = &output[(static_cast<size_t>(by) * blocks_x + bx) * info.block_bytes];
+                switch (format) {
+                case TextureFormat::BC1:
+                    compress_bc1_block(block, out);
+                    break;
+                case TextureFormat::BC4:
+                    compress_bc4_block(block, 0, out);
+                    break;
+                case TextureFormat::BC5:
+                    compress_bc4_block(block, 0, out);
+                    compress_bc4_block(block, 1, out + 8);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+        return output;
+    }
+
+    // 2x2 box filter, odd sizes repeat the edge
+    std::vector<uint8_t> downsample(const std::vector<uint8_t>& rgba, int width, int height)
+    {
+        int out_width = std::max(width / 2, 1);
+        int out_height = std::max(height / 2, 1);
+        std::vector<uint8_t> output(static_cast<size_t>(out_width) * out_height * 4);
+
+        for (int y = 0; y < out_height; y++) {
+            for (int x = 0; x < out_width; x++) {
+                int x0 = std::min(2 * x, width - 1);
+                int x1 = std::min(2 * x + 1, width - 1);
+                int y0 = std::min(2 * y, height - 1);
+                int y1 = std::min(2 * y + 1, height - 1);
+                for (int c = 0; c < 4; c++) {
+                    int sum = rgba[(static_cast<size_t>(y0) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+                              + rgba[(static_cast<size_t>(y1) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+                    output[(static_cast<size_t>(y) * out_width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        return output;
+    }
+} // namespace
+
+
+
+const TextureFormatInfo& get_texture_format_info(TextureFormat format)
+{
+    return FORMAT_INFOS[static_cast<int>(format)];
+}
+
+int get_mip_level_count(int width, int height)
+{
+    int count = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        count++;
+    }
+    return count;
+}
+
+CompressedImage compress_image(const uint8_t* rgba, int width, int height, TextureFormat format)
+{
+    CompressedImage image{ format, width, height, {} };
+
+    std::vector<uint8_t> level(rgba, rgba + static_cast<size_t>(width) * height * 4);
+    int level_width = width;
+    int level_height = height;
+
+    int level_count = get_mip_level_count(width, height);
+    for (int i = 0; i < level_count; i++) {
+        image.levels.push_back(compress_level(level, level_width, level_height, format));
+
+        if (i + 1 < level_count) {
+            level = downsample(level, level_width, level_height);
+            level_width = std::max(level_width / 2, 1);
+            level_height = std::max(level_height / 2, 1);
+        }
+    }
+    return image;
+}
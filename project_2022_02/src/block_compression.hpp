@@ -0,0 +1,44 @@
+#pragma once
+
+#include "program.hpp"
+
+#include <cstdint>
+#include <vector>
+
+
+
+// formats of streamed textures
+enum class TextureFormat : int {
+    RGBA8 = 0, // uncompressed (fallback)
+    BC1 = 1, // rgb, 4 bpp (EXT_texture_compression_s3tc)
+    BC4 = 2, // r, 4 bpp (RGTC, core)
+    BC5 = 3, // rg, 8 bpp (RGTC, core), normal maps (z is reconstructed in shader)
+};
+
+
+struct TextureFormatInfo
+{
+    const char* name;
+    GLenum internal_format;
+    int block_size; // pixels (width = height), 1 for uncompressed
+    int block_bytes;
+};
+
+const TextureFormatInfo& get_texture_format_info(TextureFormat format);
+
+
+// mip chain of one image, level 0 first, each level is tightly packed blocks (row major)
+struct CompressedImage
+{
+    TextureFormat format;
+    int width;
+    int height;
+    std::vector<std::vector<uint8_t>> levels;
+};
+
+
+// rgba8 image with full mip chain (box filter), each level is compressed into format
+// simple endpoint fitting: bounding box of the block (bc1 along its dominant diagonal), nearest palette entry per pixel
+CompressedImage compress_image(const uint8_t* rgba, int width, int height, TextureFormat format);
+
+int get_mip_level_count(int width, int height);
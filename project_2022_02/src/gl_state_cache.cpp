@@ -0,0 +1,133 @@
+#include "gl_state_cache.hpp"
+
+#include <algorithm>
+
+
+
+//  ===============================================  GlStateCache  ===============================================
+
+const char* const GlStateCache::CATEGORY_NAMES[CATEGORY_COUNT] = { "capability", "raster", "program", "vertex array", "texture", "buffer" };
+
+GlStateCache::GlStateCache()
+{
+    invalidate();
+}
+
+void GlStateCache::invalidate()
+{
+    capabilities.clear();
+    polygon_mode_value = UNKNOWN;
+    depth_mask_value = UNKNOWN;
+
+    program = UNKNOWN;
+    vertex_array = { nullptr, UNKNOWN };
+    std::fill(std::begin(textures), std::end(textures), UNKNOWN);
+    buffers.clear();
+}
+
+void GlStateCache::reset_counters()
+{
+    std::fill(std::begin(counters), std::end(counters), Counter{});
+}
+
+void GlStateCache::set_capability(GLenum capability, bool value)
+{
+    auto it = capabilities.find(capability);
+    if (filter(CAPABILITY, it != capabilities.end() && it->second == value)) {
+        return;
+    }
+
+    if (value) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+    capabilities[capability] = value;
+}
+
+void GlStateCache::enable(GLenum capability)
+{
+    set_capability(capability, true);
+}
+
+void GlStateCache::disable(GLenum capability)
+{
+    set_capability(capability, false);
+}
+
+void GlStateCache::polygon_mode(GLenum mode)
+{
+    if (filter(RASTER, polygon_mode_value == mode)) {
+        return;
+    }
+
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    polygon_mode_value = mode;
+}
+
+void GlStateCache::depth_mask(bool mask)
+{
+    GLuint value = mask ? GL_TRUE : GL_FALSE;
+    if (filter(RASTER, depth_mask_value == value)) {
+        return;
+    }
+
+    glDepthMask(mask ? GL_TRUE : GL_FALSE);
+    depth_mask_value = value;
+}
+
+void GlStateCache::use_program(const Program& program)
+{
+    if (filter(PROGRAM, this->program == program.get_id())) {
+        return;
+    }
+
+    program.use();
+    this->program = program.get_id();
+}
+
+void GlStateCache::bind_vertex_array(GLuint vao)
+{
+    if (filter(VERTEX_ARRAY, vertex_array == Binding{ nullptr, vao })) {
+        return;
+    }
+
+    glBindVertexArray(vao);
+    vertex_array = { nullptr, vao };
+}
+
+void GlStateCache::bind_texture_unit(GLuint unit, GLuint texture)
+{
+    bool cached = unit < MAX_TEXTURE_UNITS;
+    if (filter(TEXTURE, cached && textures[unit] == texture)) {
+        return;
+    }
+
+    glBindTextureUnit(unit, texture);
+    if (cached) {
+        textures[unit] = texture;
+    }
+}
+
+void GlStateCache::bind_buffer_base(GLenum target, GLuint index, GLuint buffer)
+{
+    Binding binding{ nullptr, buffer };
+    auto it = buffers.find({ target, index });
+    if (filter(BUFFER, it != buffers.end() && it->second == binding)) {
+        return;
+    }
+
+    glBindBufferBase(target, index, buffer);
+    buffers[{ target, index }] = binding;
+}
+
+bool GlStateCache::filter(Category category, bool redundant)
+{
+    bool skip = enabled && redundant;
+    if (skip) {
+        counters[category].filtered++;
+    } else {
+        counters[category].issued++;
+    }
+    return skip;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "program.hpp"
+
+#include "../../common/program_cache.hpp"
+
+#include <map>
+#include <utility>
+
+
+
+// shadow of gl state which passes change, calls which wouldn't change anything are filtered (not issued)
+// the cache assumes state is changed only through it, after foreign code (framework, ImGui, radix sort) call invalidate()
+// framework objects (geometry, UBOs) are tracked by address, raw gl objects and programs by name (programs can be reloaded)
+struct GlStateCache
+{
+    enum Category : int {
+        CAPABILITY = 0, // glEnable / glDisable
+        RASTER = 1, // glPolygonMode, glDepthMask
+        PROGRAM = 2,
+        VERTEX_ARRAY = 3,
+        TEXTURE = 4, // glBindTextureUnit
+        BUFFER = 5, // glBindBufferBase, UBO bind_buffer_base
+        CATEGORY_COUNT = 6,
+    };
+
+    static const char* const CATEGORY_NAMES[CATEGORY_COUNT];
+
+    static const GLuint MAX_TEXTURE_UNITS = 16; // higher units are not cached
+
+    struct Counter
+    {
+        size_t issued = 0;
+        size_t filtered = 0;
+    };
+
+    // disabled cache issues every call (for comparison), calls are still counted
+    bool enabled = true;
+
+    Counter counters[CATEGORY_COUNT];
+
+
+    GlStateCache();
+
+    // state is unknown, next call of each kind is issued
+    void invalidate();
+
+    void reset_counters();
+
+    void set_capability(GLenum capability, bool value);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+
+    void polygon_mode(GLenum mode);
+    void depth_mask(bool mask);
+
+    void use_program(const Program& program);
+
+    void bind_vertex_array(GLuint vao);
+
+    template <typename G>
+    void bind_geometry(const G& geometry)
+    {
+        if (!filter(VERTEX_ARRAY, vertex_array == Binding{ &geometry, 0 })) {
+            geometry.bind_vao();
+            vertex_array = { &geometry, 0 };
+        }
+    }
+
+    void bind_texture_unit(GLuint unit, GLuint texture);
+
+    void bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+
+    template <typename U>
+    void bind_uniform_buffer(const U& ubo, GLuint index)
+    {
+        Binding binding{ &ubo, 0 };
+        auto it = buffers.find({ GL_UNIFORM_BUFFER, index });
+        if (!filter(BUFFER, it != buffers.end() && it->second == binding)) {
+            ubo.bind_buffer_base(index);
+            buffers[{ GL_UNIFORM_BUFFER, index }] = binding;
+        }
+    }
+
+private:
+    // object (framework wrapper) or gl name, unknown state is represented by missing entry / UNKNOWN
+    struct Binding
+    {
+        const void* object;
+        GLuint name;
+
+        bool operator==(const Binding& other) const { return object == other.object && name == other.name; }
+    };
+
+    static constexpr GLuint UNKNOWN = ~0u;
+
+    std::map<GLenum, bool> capabilities;
+    GLenum polygon_mode_value;
+    GLuint depth_mask_value; // GL_TRUE, GL_FALSE or UNKNOWN
+
+    GLuint program;
+    Binding vertex_array;
+    GLuint textures[MAX_TEXTURE_UNITS];
+    std::map<std::pair<GLenum, GLuint>, Binding> buffers;
+
+    // counts the call, returns true if it should be skipped
+    bool filter(Category category, bool redundant);
+};
@@ -0,0 +1,93 @@
+#include "radix_sort.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+
+
+//  ===============================================  GpuRadixSort  ===============================================
+
+GpuRadixSort::GpuRadixSort() : max_count(0), max_group_count(0), keys_buffer{0, 0}, values_buffer{0, 0}, histogram_buffer(0) {}
+
+GpuRadixSort::GpuRadixSort(size_t max_count) : max_count(max_count)
+{
+    max_group_count = (max_count + LOCAL_SIZE - 1) / LOCAL_SIZE;
+
+    glCreateBuffers(2, keys_buffer);
+    glCreateBuffers(2, values_buffer);
+    glCreateBuffers(1, &histogram_buffer);
+
+    for (int i = 0; i < 2; i++) {
+        glNamedBufferStorage(keys_buffer[i], sizeof(GLuint) * max_count, nullptr, 0);
+        glNamedBufferStorage(values_buffer[i], sizeof(GLuint) * max_count, nullptr, 0);
+    }
+    glNamedBufferStorage(histogram_buffer, sizeof(GLuint) * RADIX * max_group_count, nullptr, 0);
+
+    for (int i = 0; i < 2; i++) {
+        gpu_resources().add_buffer(keys_buffer[i], "radix sort keys");
+        gpu_resources().add_buffer(values_buffer[i], "radix sort values");
+    }
+    gpu_resources().add_buffer(histogram_buffer, "radix sort histogram");
+}
+
+void GpuRadixSort::destroy()
+{
+    for (int i = 0; i < 2; i++) {
+        gpu_resources().remove_buffer(keys_buffer[i]);
+        gpu_resources().remove_buffer(values_buffer[i]);
+    }
+    gpu_resources().remove_buffer(histogram_buffer);
+
+    glDeleteBuffers(2, keys_buffer);
+    glDeleteBuffers(2, values_buffer);
+    glDeleteBuffers(1, &histogram_buffer);
+
+    *this = GpuRadixSort();
+}
+
+void GpuRadixSort::sort(const Program& histogram_program, const Program& scan_program, const Program& scatter_program, size_t count) const
+{
+    GLuint group_count = static_cast<GLuint>((count + LOCAL_SIZE - 1) / LOCAL_SIZE);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, histogram_buffer);
+
+    for (unsigned int pass = 0; pass < PASS_COUNT; pass++) {
+        int src = pass % 2;
+        int dst = 1 - src;
+        unsigned int shift = 8 * pass;
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keys_buffer[src]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, values_buffer[src]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, keys_buffer[dst]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, values_buffer[dst]);
+
+        // per group digit counts
+        histogram_program.use();
+        histogram_program.uniform(0, static_cast<unsigned int>(count));
+        histogram_program.uniform(1, shift);
+        glDispatchCompute(group_count, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // exclusive prefix sum -> destination offset of each (digit, group)
+        scan_program.use();
+        scan_program.uniform(0, RADIX * group_count);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // stable scatter
+        scatter_program.use();
+        scatter_program.uniform(0, static_cast<unsigned int>(count));
+        scatter_program.uniform(1, shift);
+        glDispatchCompute(group_count, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+GLuint GpuRadixSort::get_keys() const
+{
+    return keys_buffer[PASS_COUNT % 2];
+}
+
+GLuint GpuRadixSort::get_values() const
+{
+    return values_buffer[PASS_COUNT % 2];
+}
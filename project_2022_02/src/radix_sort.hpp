@@ -0,0 +1,35 @@
+#pragma once
+
+#include "program.hpp"
+
+#include "../../common/program_cache.hpp"
+
+
+
+// gpu radix sort of (uint key, uint value) pairs
+// least significant digit first, 4 passes of 8 bits, each pass: histogram -> scan -> stable scatter
+// input pairs are expected in keys_buffer[0] / values_buffer[0], sorted pairs end there too (even number of passes)
+struct GpuRadixSort
+{
+    static const unsigned int LOCAL_SIZE = 256; // has to match radix_histogram.comp and radix_scatter.comp
+    static const unsigned int RADIX = 256;
+    static const unsigned int PASS_COUNT = 4;
+
+    size_t max_count;
+    size_t max_group_count;
+
+    GLuint keys_buffer[2];
+    GLuint values_buffer[2];
+    GLuint histogram_buffer; // digit-major (digit * group_count + group), scanned in place
+
+
+    GpuRadixSort();
+    GpuRadixSort(size_t max_count);
+
+    void destroy();
+
+    void sort(const Program& histogram_program, const Program& scan_program, const Program& scatter_program, size_t count) const;
+
+    GLuint get_keys() const;
+    GLuint get_values() const;
+};
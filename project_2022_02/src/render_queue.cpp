@@ -0,0 +1,169 @@
+#include "render_queue.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+
+
+//  ===============================================  RenderQueue  ===============================================
+
+RenderQueue::RenderQueue() : max_count(0), draw_buffer(0), eye_position(0.0f), max_depth(1.0f) {}
+
+RenderQueue::RenderQueue(size_t max_count) : max_count(max_count), eye_position(0.0f), max_depth(1.0f)
+{
+    glCreateBuffers(1, &draw_buffer);
+    glNamedBufferStorage(draw_buffer, sizeof(RenderQueueDrawData) * max_count, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    gpu_resources().add_buffer(draw_buffer, "render queue draws");
+
+    items.reserve(max_count);
+    draw_data.reserve(max_count);
+}
+
+void RenderQueue::destroy()
+{
+    gpu_resources().remove_buffer(draw_buffer);
+    glDeleteBuffers(1, &draw_buffer);
+
+    *this = RenderQueue();
+}
+
+void RenderQueue::begin(const glm::vec3& eye_position, float max_depth)
+{
+    this->eye_position = eye_position;
+    this->max_depth = max_depth;
+
+    items.clear();
+}
+
+void RenderQueue::add(const Program& program, const SceneObject& object, const glm::mat4& model, float uv_multiplier, bool apply_snow)
+{
+    if (items.size() >= max_count) {
+        return;
+    }
+
+    RenderQueueItem item{ 0, &program, &object, model, uv_multiplier, apply_snow };
+    item.key = make_key(item);
+    items.push_back(item);
+}
+
+void RenderQueue::submit(GlStateCache& state)
+{
+    statistics = Statistics();
+    statistics.items = items.size();
+    if (items.empty()) {
+        return;
+    }
+
+    if (sort_items) {
+        std::sort(items.begin(), items.end(), [](const RenderQueueItem& a, const RenderQueueItem& b) { return a.key < b.key; });
+    }
+
+    // draw buffer in draw order
+    draw_data.clear();
+    for (const RenderQueueItem& item : items) {
+        draw_data.push_back({ item.model, glm::transpose(glm::inverse(item.model)) });
+    }
+    glNamedBufferSubData(draw_buffer, 0, sizeof(RenderQueueDrawData) * draw_data.size(), draw_data.data());
+
+    state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, DRAW_BUFFER_BINDING, draw_buffer);
+
+    const RenderQueueItem* previous = nullptr;
+    size_t first = 0;
+    while (first < items.size()) {
+        size_t last = first + 1;
+        while (instancing && last < items.size() && is_same_batch(items[first], items[last])) {
+            last++;
+        }
+
+        const RenderQueueItem& item = items[first];
+        const Program& program = *item.program;
+        const SceneObject& object = *item.object;
+        GLuint texture = object.has_texture() ? object.get_texture() : 0;
+
+        // state of previous batch is kept, only differences are set
+        bool program_changed = !previous || previous->program != item.program;
+        if (program_changed) {
+            state.use_program(program);
+            statistics.program_changes++;
+        }
+        if (program_changed || previous->uv_multiplier != item.uv_multiplier) {
+            program.uniform(1, item.uv_multiplier);
+        }
+        if (program_changed || previous->apply_snow != item.apply_snow) {
+            program.uniform(2, item.apply_snow);
+        }
+        if (program_changed || previous->object->has_texture() != object.has_texture()) {
+            program.uniform(0, object.has_texture());
+        }
+        program.uniform(DRAW_OFFSET_LOCATION, static_cast<int>(first));
+
+        if (!previous || &previous->object->get_material() != &object.get_material()) {
+            state.bind_uniform_buffer(object.get_material(), PhongMaterialUBO::DEFAULT_MATERIAL_BINDING);
+            statistics.material_changes++;
+        }
+        if (!previous || (previous->object->has_texture() ? previous->object->get_texture() : 0) != texture) {
+            state.bind_texture_unit(0, texture);
+            statistics.texture_changes++;
+        }
+        if (!previous || &previous->object->get_geometry() != &object.get_geometry()) {
+            state.bind_geometry(object.get_geometry());
+            statistics.geometry_changes++;
+        }
+
+        GLsizei instance_count = static_cast<GLsizei>(last - first);
+        if (object.get_geometry().draw_elements_count > 0) {
+            glDrawElementsInstanced(GL_TRIANGLES, object.get_geometry().draw_elements_count, GL_UNSIGNED_INT, nullptr, instance_count);
+        } else {
+            glDrawArraysInstanced(GL_TRIANGLES, 0, object.get_geometry().draw_arrays_count, instance_count);
+        }
+        statistics.batches++;
+
+        previous = &item;
+        first = last;
+    }
+}
+
+template <typename T>
+uint32_t RenderQueue::get_id(std::map<T, uint32_t>& ids, T object, uint32_t first_id, int bits)
+{
+    uint32_t max_id = (1u << bits) - 1;
+
+    auto it = ids.find(object);
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    uint32_t id = first_id + static_cast<uint32_t>(ids.size());
+    assert(id <= max_id && "render queue: more distinct states than the sort key field holds");
+    if (id > max_id) {
+        return max_id;
+    }
+
+    ids.emplace(object, id);
+    return id;
+}
+
+uint64_t RenderQueue::make_key(const RenderQueueItem& item)
+{
+    const SceneObject& object = *item.object;
+
+    uint64_t program = get_id<const void*>(program_ids, item.program, 0, 8);
+    uint64_t material = get_id<const void*>(material_ids, &object.get_material(), 0, 12);
+    GLuint texture_name = object.has_texture() ? object.get_texture() : 0;
+    uint64_t texture = texture_name != 0 ? get_id<GLuint>(texture_ids, texture_name, 1, 12) : 0;
+    uint64_t geometry = get_id<const void*>(geometry_ids, &object.get_geometry(), 0, 12);
+
+    float distance = glm::length(glm::vec3(item.model[3]) - eye_position) / max_depth;
+    uint64_t depth = static_cast<uint64_t>(glm::clamp(distance, 0.0f, 1.0f) * 0xfffff);
+
+    return (program << 56) | (material << 44) | (texture << 32) | (geometry << 20) | depth;
+}
+
+bool RenderQueue::is_same_batch(const RenderQueueItem& a, const RenderQueueItem& b)
+{
+    return a.program == b.program && &a.object->get_material() == &b.object->get_material() && a.object->has_texture() == b.object->has_texture()
+           && (!a.object->has_texture() || a.object->get_texture() == b.object->get_texture()) && &a.object->get_geometry() == &b.object->get_geometry()
+           && a.uv_multiplier == b.uv_multiplier && a.apply_snow == b.apply_snow;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "program.hpp"
+#include "scene_object.hpp"
+
+#include "gl_state_cache.hpp"
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+
+
+// per draw data of draw buffer (std430, has to match object_queue.vert)
+struct RenderQueueDrawData
+{
+    glm::mat4 model;
+    glm::mat4 model_it; // normal matrix (mat4 avoids mat3 padding)
+};
+
+
+// one draw of render queue
+// object provides geometry, material and texture, its model ubo is not used (model comes from draw buffer)
+struct RenderQueueItem
+{
+    uint64_t key;
+
+    const Program* program;
+    const SceneObject* object;
+    glm::mat4 model;
+
+    float uv_multiplier;
+    bool apply_snow;
+};
+
+
+// opaque pass collected as draw items, sorted once per pass and submitted with minimal state changes
+// sort key (from most significant bits): program (8), material (12), texture (12), geometry (12), depth (20)
+// so items sharing state are adjacent and front to back within it (early depth test)
+// model matrices of all items are uploaded into one ssbo in sorted order, consecutive items with the same state
+// are drawn as one instanced draw, object_queue.vert reads draws[draw_offset + gl_InstanceID]
+struct RenderQueue
+{
+    static const GLuint DRAW_BUFFER_BINDING = 6; // has to match object_queue.vert
+    static const GLint DRAW_OFFSET_LOCATION = 10;
+
+    struct Statistics
+    {
+        size_t items = 0;
+        size_t batches = 0; // draw calls
+        size_t program_changes = 0;
+        size_t material_changes = 0;
+        size_t texture_changes = 0;
+        size_t geometry_changes = 0;
+    };
+
+    bool sort_items = true; // false = submission order (for comparison)
+    bool instancing = true; // false = one draw call per item
+
+    size_t max_count; // items over the capacity of draw buffer are dropped
+
+    GLuint draw_buffer;
+
+    Statistics statistics; // of last submitted pass
+
+
+    RenderQueue();
+    RenderQueue(size_t max_count);
+
+    void destroy();
+
+    // starts new pass, depth of items is distance from eye_position, normalized by max_depth
+    void begin(const glm::vec3& eye_position, float max_depth);
+
+    void add(const Program& program, const SceneObject& object, const glm::mat4& model, float uv_multiplier = 1.0f, bool apply_snow = true);
+
+    // camera, lights and other shared state are expected to be bound
+    void submit(GlStateCache& state);
+
+private:
+    glm::vec3 eye_position;
+    float max_depth;
+
+    std::vector<RenderQueueItem> items;
+    std::vector<RenderQueueDrawData> draw_data;
+
+    // small ids of programs, materials, geometries (by address) and textures for sort key, kept between passes
+    // one counter per key field, ids past the field width aren't stored and share the last id (sorting only,
+    // batches compare state directly)
+    std::map<const void*, uint32_t> program_ids;
+    std::map<const void*, uint32_t> material_ids;
+    std::map<const void*, uint32_t> geometry_ids;
+    std::map<GLuint, uint32_t> texture_ids; // 0 = no texture
+
+    template <typename T>
+    static uint32_t get_id(std::map<T, uint32_t>& ids, T object, uint32_t first_id, int bits);
+
+    uint64_t make_key(const RenderQueueItem& item);
+
+    // items a and b can be drawn by one instanced draw
+    static bool is_same_batch(const RenderQueueItem& a, const RenderQueueItem& b);
+};
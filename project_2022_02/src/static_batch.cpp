@@ -0,0 +1,126 @@
+#include "static_batch.hpp"
+
+#include "../../common/gpu_resources.hpp"
+
+#include <algorithm>
+
+
+
+//  ===============================================  StaticBatch  ===============================================
+
+StaticBatch::StaticBatch() : mesh_count(0), vertex_buffer(0), index_buffer(0), draw_id_buffer(0), model_buffer(0), command_buffer(0), vao(0) {}
+
+StaticBatch::StaticBatch(const std::vector<const Geometry*>& geometries, const std::vector<glm::mat4>& models) : mesh_count(geometries.size())
+{
+    const size_t vertex_size = 8; // floats: position (3), normal (3), tex coord (2)
+
+    std::vector<float> vertices;
+    std::vector<GLuint> indices;
+    std::vector<GLuint> draw_ids;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    for (size_t i = 0; i < mesh_count; i++) {
+        const Geometry& geometry = *geometries[i];
+        size_t vertex_count = geometry.positions.size() / 3;
+
+        DrawElementsIndirectCommand command;
+        command.count = 0;
+        command.instance_count = 1;
+        command.first_index = static_cast<GLuint>(indices.size());
+        command.base_vertex = static_cast<GLint>(vertices.size() / vertex_size);
+        command.base_instance = static_cast<GLuint>(i);
+
+        for (size_t v = 0; v < vertex_count; v++) {
+            for (size_t c = 0; c < 3; c++) {
+                vertices.push_back(geometry.positions[3 * v + c]);
+            }
+            for (size_t c = 0; c < 3; c++) {
+                vertices.push_back(3 * v + c < geometry.normals.size() ? geometry.normals[3 * v + c] : 0.0f);
+            }
+            for (size_t c = 0; c < 2; c++) {
+                vertices.push_back(2 * v + c < geometry.tex_coords.size() ? geometry.tex_coords[2 * v + c] : 0.0f);
+            }
+        }
+
+        if (geometry.indices.empty()) {
+            for (size_t v = 0; v < vertex_count; v++) {
+                indices.push_back(static_cast<GLuint>(v));
+            }
+        } else {
+            indices.insert(indices.end(), geometry.indices.begin(), geometry.indices.end());
+        }
+
+        command.count = static_cast<GLuint>(indices.size()) - command.first_index;
+        commands.push_back(command);
+        draw_ids.push_back(static_cast<GLuint>(i));
+    }
+
+    GLuint buffers[5];
+    glCreateBuffers(5, buffers);
+    vertex_buffer = buffers[0];
+    index_buffer = buffers[1];
+    draw_id_buffer = buffers[2];
+    model_buffer = buffers[3];
+    command_buffer = buffers[4];
+
+    glNamedBufferStorage(vertex_buffer, sizeof(float) * vertices.size(), vertices.data(), 0);
+    glNamedBufferStorage(index_buffer, sizeof(GLuint) * indices.size(), indices.data(), 0);
+    glNamedBufferStorage(draw_id_buffer, sizeof(GLuint) * draw_ids.size(), draw_ids.data(), 0);
+    glNamedBufferStorage(model_buffer, sizeof(glm::mat4) * models.size(), models.data(), 0);
+    glNamedBufferStorage(command_buffer, sizeof(DrawElementsIndirectCommand) * commands.size(), commands.data(), 0);
+
+    gpu_resources().add_buffer(vertex_buffer, "static batch vertices");
+    gpu_resources().add_buffer(index_buffer, "static batch indices");
+    gpu_resources().add_buffer(draw_id_buffer, "static batch draw ids");
+    gpu_resources().add_buffer(model_buffer, "static batch models");
+    gpu_resources().add_buffer(command_buffer, "static batch commands");
+
+    // vao - binding 0: vertices, binding 1: draw ids (per instance)
+    glCreateVertexArrays(1, &vao);
+    glVertexArrayVertexBuffer(vao, 0, vertex_buffer, 0, static_cast<GLsizei>(sizeof(float) * vertex_size));
+    glVertexArrayVertexBuffer(vao, 1, draw_id_buffer, 0, sizeof(GLuint));
+    glVertexArrayBindingDivisor(vao, 1, 1);
+    glVertexArrayElementBuffer(vao, index_buffer);
+
+    // locations 0, 1, 2 as in object shaders (position, normal, tex coord)
+    const GLint sizes[3] = { 3, 3, 2 };
+    GLuint offset = 0;
+    for (GLuint location = 0; location < 3; location++) {
+        glEnableVertexArrayAttrib(vao, location);
+        glVertexArrayAttribFormat(vao, location, sizes[location], GL_FLOAT, GL_FALSE, offset);
+        glVertexArrayAttribBinding(vao, location, 0);
+        offset += sizeof(float) * sizes[location];
+    }
+
+    glEnableVertexArrayAttrib(vao, DRAW_ID_LOCATION);
+    glVertexArrayAttribIFormat(vao, DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(vao, DRAW_ID_LOCATION, 1);
+}
+
+void StaticBatch::destroy()
+{
+    GLuint buffers[5] = { vertex_buffer, index_buffer, draw_id_buffer, model_buffer, command_buffer };
+    for (GLuint buffer : buffers) {
+        gpu_resources().remove_buffer(buffer);
+    }
+    glDeleteBuffers(5, buffers);
+    glDeleteVertexArrays(1, &vao);
+
+    *this = StaticBatch();
+}
+
+void StaticBatch::draw(GlStateCache& state, size_t first, size_t count) const
+{
+    if (first >= mesh_count) {
+        return;
+    }
+    count = std::min(count, mesh_count - first);
+
+    state.bind_vertex_array(vao);
+    state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, MODEL_BUFFER_BINDING, model_buffer);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(sizeof(DrawElementsIndirectCommand) * first),
+                                static_cast<GLsizei>(count), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
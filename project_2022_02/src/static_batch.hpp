@@ -0,0 +1,51 @@
+#pragma once
+
+#include "program.hpp"
+#include "scene_object.hpp"
+
+#include "gl_state_cache.hpp"
+
+#include <vector>
+
+
+
+// command of glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+
+// static meshes merged at load time into one vertex + index buffer (interleaved position, normal, tex coord),
+// any consecutive range of meshes is drawn by a single glMultiDrawElementsIndirect
+// each mesh is one command with base_instance = mesh index, per instance attribute draw_id (0, 1, ...) then gives
+// the vertex shader mesh index (without ARB_shader_draw_parameters), model matrices are in ssbo indexed by it
+struct StaticBatch
+{
+    static const GLuint DRAW_ID_LOCATION = 7; // has to match *_batch.vert
+    static const GLuint MODEL_BUFFER_BINDING = 7;
+
+    size_t mesh_count;
+
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    GLuint draw_id_buffer;
+    GLuint model_buffer; // mat4 per mesh
+    GLuint command_buffer;
+
+    GLuint vao;
+
+
+    StaticBatch();
+    // geometries are expected to be triangles, non-indexed ones get sequential indices
+    StaticBatch(const std::vector<const Geometry*>& geometries, const std::vector<glm::mat4>& models);
+
+    void destroy();
+
+    // draws meshes [first, first + count), program is expected to be used
+    void draw(GlStateCache& state, size_t first, size_t count) const;
+};
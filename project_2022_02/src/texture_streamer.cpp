@@ -0,0 +1,539 @@
+#include "texture_streamer.hpp"
+
+#include "../../common/gl_util.hpp"
+#include "../../common/gpu_resources.hpp"
+
+#include "imgui.h"
+#include "stb_image.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+
+namespace {
+    const uint32_t CACHE_MAGIC = 0x31585443; // "CTX1"
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t format;
+        int32_t width;
+        int32_t height;
+        int32_t level_count;
+        uint32_t padding;
+        uint64_t source_size;
+        int64_t source_time;
+    };
+
+    // ARB_bindless_texture, loaded through glfw (gl loader of the framework may not include extension functions)
+    typedef GLuint64(APIENTRY* GetTextureHandleFunction)(GLuint texture);
+    typedef void(APIENTRY* TextureHandleFunction)(GLuint64 handle);
+
+    GetTextureHandleFunction get_texture_handle = nullptr;
+    TextureHandleFunction make_handle_resident = nullptr;
+    TextureHandleFunction make_handle_non_resident = nullptr;
+
+    // sizes and write times of all sources folded together
+    bool get_source_stamp(const std::vector<std::filesystem::path>& sources, uint64_t& size, int64_t& time)
+    {
+        size = 0;
+        time = 0;
+        for (const std::filesystem::path& source : sources) {
+            std::error_code error;
+            uint64_t source_size = std::filesystem::file_size(source, error);
+            if (error) {
+                return false;
+            }
+            int64_t source_time = static_cast<int64_t>(std::filesystem::last_write_time(source, error).time_since_epoch().count());
+            if (error) {
+                return false;
+            }
+            size = size * 31 + source_size;
+            time = time * 31 + source_time;
+        }
+        return true;
+    }
+} // namespace
+
+
+//  ===============================================  TextureStreamer  ===============================================
+
+TextureStreamer::TextureStreamer(size_t thread_count, const std::filesystem::path& cache_folder) : cache_folder(cache_folder)
+{
+    s3tc_supported = has_gl_extension("GL_EXT_texture_compression_s3tc");
+
+    bindless_supported = false;
+    if (has_gl_extension("GL_ARB_bindless_texture")) {
+        get_texture_handle = reinterpret_cast<GetTextureHandleFunction>(glfwGetProcAddress("glGetTextureHandleARB"));
+        make_handle_resident = reinterpret_cast<TextureHandleFunction>(glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+        make_handle_non_resident = reinterpret_cast<TextureHandleFunction>(glfwGetProcAddress("glMakeTextureHandleNonResidentARB"));
+        bindless_supported = get_texture_handle != nullptr && make_handle_resident != nullptr && make_handle_non_resident != nullptr;
+    }
+
+    if (!cache_folder.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(cache_folder, error);
+    }
+
+    // same orientation as TextureUtils, set before workers start (the flag is global)
+    stbi_set_flip_vertically_on_load(true);
+
+    glCreateBuffers(1, &staging_buffer);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glNamedBufferStorage(staging_buffer, STAGING_SLOT_SIZE * STAGING_SLOT_COUNT, nullptr, flags);
+    staging_data = static_cast<uint8_t*>(glMapNamedBufferRange(staging_buffer, 0, STAGING_SLOT_SIZE * STAGING_SLOT_COUNT, flags));
+    gpu_resources().add_buffer(staging_buffer, "texture staging");
+
+    for (GLsync& fence : staging_fences) {
+        fence = nullptr;
+    }
+    staging_slot = 0;
+
+    stopping = false;
+    for (size_t i = 0; i < std::max(thread_count, size_t(1)); i++) {
+        workers.emplace_back(&TextureStreamer::run_worker, this);
+    }
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (GLsync fence : staging_fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+        }
+    }
+
+    gpu_resources().remove_buffer(staging_buffer);
+    glUnmapNamedBuffer(staging_buffer);
+    glDeleteBuffers(1, &staging_buffer);
+
+    for (const StreamedTexture& texture : textures) {
+        if (texture.handle != 0) {
+            make_handle_non_resident(texture.handle);
+        }
+        gpu_resources().remove_texture(texture.texture);
+        glDeleteTextures(1, &texture.texture);
+    }
+}
+
+GLuint TextureStreamer::load(const std::filesystem::path& path, TextureFormat format, glm::u8vec4 placeholder_color, GLenum wrap)
+{
+    return load_packed({ path }, format, placeholder_color, wrap);
+}
+
+GLuint TextureStreamer::load_packed(const std::vector<std::filesystem::path>& sources, TextureFormat format, glm::u8vec4 placeholder_color, GLenum wrap)
+{
+    if (format == TextureFormat::BC1 && !s3tc_supported) {
+        format = TextureFormat::RGBA8;
+    }
+    const TextureFormatInfo& info = get_texture_format_info(format);
+
+    // label "a.png + b.png", cache "a+b.bc5.tex"
+    std::string label;
+    std::string cache_name;
+    for (const std::filesystem::path& source : sources) {
+        label += (label.empty() ? "" : " + ") + source.filename().string();
+        cache_name += (cache_name.empty() ? "" : "+") + (sources.size() > 1 ? source.stem() : source.filename()).string();
+    }
+
+    StreamedTexture texture;
+    texture.label = label;
+    texture.format = format;
+
+    // header only (first source), decoding is done by workers
+    int components;
+    bool valid = !sources.empty() && stbi_info(sources[0].string().c_str(), &texture.width, &texture.height, &components) != 0;
+    if (!valid) {
+        std::cerr << "texture not found: " << label << "\n";
+        texture.width = 1;
+        texture.height = 1;
+    }
+    texture.level_count = get_mip_level_count(texture.width, texture.height);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture.texture);
+    glTextureStorage2D(texture.texture, texture.level_count, info.internal_format, texture.width, texture.height);
+    glTextureParameteri(texture.texture, GL_TEXTURE_WRAP_S, wrap);
+    glTextureParameteri(texture.texture, GL_TEXTURE_WRAP_T, wrap);
+    glTextureParameteri(texture.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // placeholder = coarsest level (1x1), base level is lowered as real levels arrive
+    const uint8_t placeholder[4] = { placeholder_color.r, placeholder_color.g, placeholder_color.b, placeholder_color.a };
+    CompressedImage placeholder_image = compress_image(placeholder, 1, 1, format);
+    const std::vector<uint8_t>& placeholder_data = placeholder_image.levels[0];
+
+    int coarsest = texture.level_count - 1;
+    if (format == TextureFormat::RGBA8) {
+        glTextureSubImage2D(texture.texture, coarsest, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, placeholder_data.data());
+    } else {
+        glCompressedTextureSubImage2D(texture.texture, coarsest, 0, 0, 1, 1, info.internal_format, static_cast<GLsizei>(placeholder_data.size()),
+                                      placeholder_data.data());
+    }
+    glTextureParameteri(texture.texture, GL_TEXTURE_BASE_LEVEL, coarsest);
+
+    gpu_resources().add_texture(texture.texture, texture.label);
+
+    texture.arrived = !valid;
+    texture.failed = !valid;
+    texture.resident_level = texture.level_count; // placeholder only
+    texture.upload_level = -1;
+    texture.upload_row = 0;
+    texture.handle = 0;
+
+    size_t index = textures.size();
+    GLuint name = texture.texture;
+    textures.push_back(std::move(texture));
+
+    statistics.requested++;
+    if (!valid) {
+        statistics.failed++;
+        return name;
+    }
+
+    std::filesystem::path cache;
+    if (!cache_folder.empty()) {
+        cache = cache_folder / (cache_name + "." + info.name + ".tex");
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({ index, sources, cache, format });
+    }
+    wake.notify_one();
+
+    return name;
+}
+
+void TextureStreamer::update()
+{
+    statistics.uploaded_bytes_frame = 0;
+
+    std::vector<Result> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.swap(results);
+    }
+
+    for (Result& result : finished) {
+        StreamedTexture& texture = textures[result.index];
+        texture.arrived = true;
+        statistics.worker_time_ms += result.time_ms;
+
+        // size is checked against storage allocated from the header (file could change in between)
+        const CompressedImage& image = result.image;
+        if (image.width != texture.width || image.height != texture.height || static_cast<int>(image.levels.size()) != texture.level_count) {
+            std::cerr << "texture loading failed: " << texture.label << "\n";
+            texture.failed = true;
+            statistics.failed++;
+            continue;
+        }
+
+        if (result.from_cache) {
+            statistics.cache_hits++;
+        } else {
+            statistics.compressed++;
+        }
+        texture.image = std::move(result.image);
+        texture.upload_level = texture.level_count - 1;
+        texture.upload_row = 0;
+    }
+
+    bool uploading = std::any_of(textures.begin(), textures.end(), [](const StreamedTexture& texture) { return texture.upload_level >= 0; });
+    if (!uploading) {
+        return;
+    }
+
+    // slot is reused only after gpu consumed it, otherwise uploads wait for next frame (no stall)
+    GLsync& fence = staging_fences[staging_slot];
+    if (fence != nullptr) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            return;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    size_t slot_begin = staging_slot * STAGING_SLOT_SIZE;
+    size_t budget = std::min(upload_budget, STAGING_SLOT_SIZE);
+    size_t offset = 0;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging_buffer);
+    for (StreamedTexture& texture : textures) {
+        while (texture.upload_level >= 0 && upload_rows(texture, offset, slot_begin, budget)) {
+        }
+        if (texture.upload_level >= 0) {
+            break; // budget is used up
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (offset > 0) {
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        staging_slot = (staging_slot + 1) % STAGING_SLOT_COUNT;
+    }
+}
+
+bool TextureStreamer::upload_rows(StreamedTexture& texture, size_t& offset, size_t slot_begin, size_t budget)
+{
+    const TextureFormatInfo& info = get_texture_format_info(texture.format);
+
+    int level = texture.upload_level;
+    int level_width = std::max(texture.width >> level, 1);
+    int level_height = std::max(texture.height >> level, 1);
+    int blocks_x = (level_width + info.block_size - 1) / info.block_size;
+    int blocks_y = (level_height + info.block_size - 1) / info.block_size;
+    size_t row_bytes = static_cast<size_t>(blocks_x) * info.block_bytes;
+
+    // large levels are split into strips of block rows over several frames
+    size_t row_count = offset < budget ? (budget - offset) / row_bytes : 0;
+    row_count = std::min(row_count, static_cast<size_t>(blocks_y - texture.upload_row));
+    if (row_count == 0) {
+        return false;
+    }
+
+    size_t size = row_count * row_bytes;
+    const uint8_t* source = texture.image.levels[level].data() + texture.upload_row * row_bytes;
+    std::memcpy(staging_data + slot_begin + offset, source, size);
+
+    // source is offset into bound GL_PIXEL_UNPACK_BUFFER
+    const void* pixels = reinterpret_cast<const void*>(slot_begin + offset);
+    int y = texture.upload_row * info.block_size;
+    int height = std::min(static_cast<int>(row_count) * info.block_size, level_height - y);
+    if (texture.format == TextureFormat::RGBA8) {
+        glTextureSubImage2D(texture.texture, level, 0, y, level_width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    } else {
+        glCompressedTextureSubImage2D(texture.texture, level, 0, y, level_width, height, info.internal_format, static_cast<GLsizei>(size), pixels);
+    }
+
+    offset += size;
+    statistics.uploaded_bytes += size;
+    statistics.uploaded_bytes_frame += size;
+
+    texture.upload_row += static_cast<int>(row_count);
+    if (texture.upload_row == blocks_y) {
+        texture.resident_level = level;
+        glTextureParameteri(texture.texture, GL_TEXTURE_BASE_LEVEL, level);
+
+        texture.upload_level--;
+        texture.upload_row = 0;
+        if (texture.upload_level < 0) {
+            texture.image = CompressedImage();
+            statistics.resident++;
+        }
+    }
+    return true;
+}
+
+bool TextureStreamer::is_done()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!jobs.empty() || !results.empty()) {
+            return false;
+        }
+    }
+    return std::all_of(textures.begin(), textures.end(), [](const StreamedTexture& texture) { return texture.arrived && texture.upload_level < 0; });
+}
+
+size_t TextureStreamer::get_thread_count() const
+{
+    return workers.size();
+}
+
+bool TextureStreamer::is_bindless_supported() const
+{
+    return bindless_supported;
+}
+
+GLuint64 TextureStreamer::get_handle(GLuint texture)
+{
+    if (!bindless_supported) {
+        return 0;
+    }
+
+    for (StreamedTexture& streamed : textures) {
+        if (streamed.texture != texture) {
+            continue;
+        }
+        if (streamed.handle == 0 && streamed.arrived && !streamed.failed && streamed.upload_level < 0) {
+            streamed.handle = get_texture_handle(streamed.texture);
+            make_handle_resident(streamed.handle);
+        }
+        return streamed.handle;
+    }
+    return 0;
+}
+
+void TextureStreamer::render_ui() const
+{
+    ImGui::Text("textures: %zu / %zu resident, %zu cached, %zu compressed, %zu failed (%zu threads)", statistics.resident, statistics.requested,
+                statistics.cache_hits, statistics.compressed, statistics.failed, workers.size());
+    ImGui::Text("uploaded: %.1f MB (%.1f KB last frame), worker time: %.0f ms", statistics.uploaded_bytes / (1024.0 * 1024.0),
+                statistics.uploaded_bytes_frame / 1024.0, statistics.worker_time_ms);
+
+    for (const StreamedTexture& texture : textures) {
+        const char* state = texture.failed ? "failed" : !texture.arrived ? "loading" : texture.upload_level >= 0 ? "uploading" : "resident";
+        int shown_level = std::min(texture.resident_level, texture.level_count - 1);
+        ImGui::Text("  %s: %s %dx%d, %s, level %d / %d", texture.label.c_str(), get_texture_format_info(texture.format).name, texture.width,
+                    texture.height, state, shown_level, texture.level_count - 1);
+    }
+}
+
+void TextureStreamer::clear_cache()
+{
+    if (cache_folder.empty() || !std::filesystem::exists(cache_folder)) {
+        return;
+    }
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(cache_folder, error)) {
+        if (entry.path().extension() == ".tex") {
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
+
+void TextureStreamer::run_worker()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        // decoded and compressed without lock, other workers process their textures in parallel
+        Result result = process(job);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+    }
+}
+
+TextureStreamer::Result TextureStreamer::process(const Job& job) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Result result{ job.index, CompressedImage{ job.format, 0, 0, {} }, false, 0.0 };
+    if (!job.cache.empty() && read_cache(job.cache, job.sources, job.format, result.image)) {
+        result.from_cache = true;
+    } else {
+        // rgba8 of single source, or red channels of packed sources (other channels 0, alpha 255)
+        std::vector<uint8_t> packed;
+        int width = 0;
+        int height = 0;
+        bool valid = true;
+        for (size_t i = 0; i < job.sources.size() && valid; i++) {
+            int source_width, source_height, components;
+            uint8_t* pixels = stbi_load(job.sources[i].string().c_str(), &source_width, &source_height, &components, 4);
+            if (pixels == nullptr) {
+                valid = false;
+                break;
+            }
+
+            if (i == 0) {
+                width = source_width;
+                height = source_height;
+                if (job.sources.size() == 1) {
+                    packed.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+                } else {
+                    packed.assign(static_cast<size_t>(width) * height * 4, 0);
+                    for (size_t p = 0; p < packed.size(); p += 4) {
+                        packed[p + 3] = 255;
+                    }
+                }
+            }
+
+            if (source_width != width || source_height != height) {
+                valid = false;
+            } else if (job.sources.size() > 1 && i < 4) {
+                for (size_t p = 0; p < packed.size(); p += 4) {
+                    packed[p + i] = pixels[p];
+                }
+            }
+            stbi_image_free(pixels);
+        }
+
+        if (valid && !packed.empty()) {
+            result.image = compress_image(packed.data(), width, height, job.format);
+
+            if (!job.cache.empty()) {
+                write_cache(job.cache, job.sources, result.image);
+            }
+        }
+    }
+
+    result.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+bool TextureStreamer::read_cache(const std::filesystem::path& cache, const std::vector<std::filesystem::path>& sources, TextureFormat format,
+                                 CompressedImage& image)
+{
+    uint64_t source_size;
+    int64_t source_time;
+    if (!get_source_stamp(sources, source_size, source_time)) {
+        return false;
+    }
+
+    std::ifstream file(cache, std::ios::binary);
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(CacheHeader))) {
+        return false;
+    }
+    if (header.magic != CACHE_MAGIC || header.format != static_cast<uint32_t>(format) || header.source_size != source_size
+        || header.source_time != source_time || header.level_count != get_mip_level_count(header.width, header.height)) {
+        return false;
+    }
+
+    image = CompressedImage{ format, header.width, header.height, {} };
+    image.levels.resize(header.level_count);
+    for (std::vector<uint8_t>& level : image.levels) {
+        uint64_t size = 0;
+        if (!file.read(reinterpret_cast<char*>(&size), sizeof(uint64_t))) {
+            return false;
+        }
+        level.resize(size);
+        if (!file.read(reinterpret_cast<char*>(level.data()), size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TextureStreamer::write_cache(const std::filesystem::path& cache, const std::vector<std::filesystem::path>& sources, const CompressedImage& image)
+{
+    CacheHeader header{ CACHE_MAGIC, static_cast<uint32_t>(image.format), image.width, image.height, static_cast<int32_t>(image.levels.size()), 0, 0, 0 };
+    if (!get_source_stamp(sources, header.source_size, header.source_time)) {
+        return;
+    }
+
+    std::ofstream file(cache, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+    for (const std::vector<uint8_t>& level : image.levels) {
+        uint64_t size = level.size();
+        file.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(level.data()), level.size());
+    }
+}
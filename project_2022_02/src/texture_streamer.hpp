@@ -0,0 +1,149 @@
+#pragma once
+
+#include "program.hpp"
+
+#include "block_compression.hpp"
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+
+// asynchronous loading of image textures (png, jpg)
+// load() returns the final texture name at once: immutable storage of the full mip chain is allocated from the image header,
+// only the coarsest level holds a placeholder color and base level points to it
+// worker threads decode the image and compress the mip chain (block_compression.hpp), compressed chains are stored
+// in cache folder (keyed by source size + write time), so later runs only read them
+// update() uploads finished chains through a persistently mapped pixel unpack buffer (ring of slots guarded by fences),
+// at most upload_budget bytes per frame, coarse levels first; base level is lowered whenever a level is complete
+// with ARB_bindless_texture, resident textures also provide handles (sampler state is frozen by the handle, so not earlier)
+class TextureStreamer
+{
+public:
+    static const size_t STAGING_SLOT_COUNT = 3;
+    static const size_t STAGING_SLOT_SIZE = 4 << 20; // bytes
+
+    struct Statistics
+    {
+        size_t requested = 0;
+        size_t resident = 0; // all levels uploaded
+        size_t cache_hits = 0;
+        size_t compressed = 0; // decoded + compressed by workers
+        size_t failed = 0;
+        size_t uploaded_bytes = 0;
+        size_t uploaded_bytes_frame = 0;
+        double worker_time_ms = 0.0; // sum over workers
+    };
+
+    size_t upload_budget = 2 << 20; // bytes per frame, at most STAGING_SLOT_SIZE
+
+    Statistics statistics;
+
+
+    TextureStreamer(size_t thread_count, const std::filesystem::path& cache_folder);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // bc1 falls back to rgba8 without EXT_texture_compression_s3tc (rgtc is core)
+    // placeholder_color is shown until the image arrives (rgba, 0-255)
+    GLuint load(const std::filesystem::path& path, TextureFormat format, glm::u8vec4 placeholder_color, GLenum wrap = GL_REPEAT);
+
+    // channel packing: red channel of sources[i] is stored in channel i (e.g. height + roughness into bc5), sources have the same size
+    GLuint load_packed(const std::vector<std::filesystem::path>& sources, TextureFormat format, glm::u8vec4 placeholder_color,
+                       GLenum wrap = GL_REPEAT);
+
+    // moves finished images to the gpu, call once per frame (binds and unbinds GL_PIXEL_UNPACK_BUFFER)
+    void update();
+
+    bool is_done();
+    size_t get_thread_count() const;
+
+    bool is_bindless_supported() const;
+
+    // resident bindless handle of texture returned by load, 0 until all levels are uploaded (or without bindless support)
+    GLuint64 get_handle(GLuint texture);
+
+    // per texture progress, call inside ImGui window
+    void render_ui() const;
+
+    // removes stored compressed images
+    void clear_cache();
+
+private:
+    struct Job
+    {
+        size_t index;
+        std::vector<std::filesystem::path> sources; // more than one = packed
+        std::filesystem::path cache;
+        TextureFormat format;
+    };
+
+    struct Result
+    {
+        size_t index;
+        CompressedImage image; // no levels when loading failed
+        bool from_cache;
+        double time_ms;
+    };
+
+    // render thread only
+    struct StreamedTexture
+    {
+        std::string label;
+        GLuint texture;
+        TextureFormat format;
+        int width;
+        int height;
+        int level_count;
+
+        CompressedImage image; // released after upload
+        bool arrived;
+        bool failed;
+
+        int resident_level; // finest uploaded level
+        int upload_level; // level being uploaded, -1 = done
+        int upload_row; // first block row of upload_level not uploaded yet
+
+        GLuint64 handle; // bindless, 0 = not created
+    };
+
+    std::filesystem::path cache_folder;
+    bool s3tc_supported;
+    bool bindless_supported;
+
+    std::vector<StreamedTexture> textures;
+
+    GLuint staging_buffer;
+    uint8_t* staging_data; // persistently mapped
+    GLsync staging_fences[STAGING_SLOT_COUNT];
+    size_t staging_slot;
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    // guarded by mutex
+    std::deque<Job> jobs;
+    std::vector<Result> results;
+    bool stopping;
+
+    void run_worker();
+    Result process(const Job& job) const;
+
+    static bool read_cache(const std::filesystem::path& cache, const std::vector<std::filesystem::path>& sources, TextureFormat format,
+                           CompressedImage& image);
+    static void write_cache(const std::filesystem::path& cache, const std::vector<std::filesystem::path>& sources, const CompressedImage& image);
+
+    // copies level rows into staging slot and issues upload, returns false when nothing fits
+    bool upload_rows(StreamedTexture& texture, size_t& offset, size_t slot_begin, size_t budget);
+};